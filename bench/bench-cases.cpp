@@ -0,0 +1,619 @@
+/* The benchmark cases, see bench.h
+
+   Naming: <area>/<operation>[/<shape>]. The document size is appended by the runner.
+*/
+
+#include "bench.h"
+#include "yaml-path/yaml-path.h"
+#include "yaml-path/yaml-path-internals.h"
+#include "yaml-path/yaml-path-static.h"
+#include "yaml-path/yaml-accumulate.h"
+#include <yaml-cpp/yaml.h>
+#include <sstream>
+#include <string>
+
+using namespace YamlPathBench;
+using YAML::Node;
+using YAML::PathArg;
+
+namespace
+{
+   std::string Mid(char const * prefix, size_t count) { return prefix + std::to_string(count / 2); }
+
+   // --- PathScanner tokenization and compilation
+
+   char const * const ScanPath = "config.servers{^role*=primary,!region~=eu}.hosts[12].{name,port}";
+
+   Register scanTokens("Scanner/tokens", {}, [](size_t)
+   {
+      return []
+      {
+         YAML::YamlPathDetail::PathScanner scan(ScanPath);
+         size_t count = 0;
+         while (scan.NextToken().id > YAML::YamlPathDetail::EToken::None)
+            ++count;
+         Consume(count);
+      };
+   });
+
+   Register scanSelectors("Scanner/selectors", {}, [](size_t)
+   {
+      return []
+      {
+         YAML::YamlPathDetail::PathScanner scan(ScanPath);
+         size_t count = 0;
+         while (scan.NextSelector() > YAML::YamlPathDetail::ESelector::None)
+            ++count;
+         Consume(count);
+      };
+   });
+
+   Register scanCompile("Scanner/CompilePath", {}, [](size_t)
+   {
+      return [] { Consume(YAML::CompilePath(ScanPath) ? 1 : 0); };
+   });
+
+   // --- Select
+
+   Register selectKeyWide("Select/key/wide-map", DocumentSizes(), [](size_t n)
+   {
+      return [root = WideMap(n), key = Mid("key-", n)] { Consume(YAML::Select(root, key)); };
+   });
+
+   Register selectKeyDeep("Select/key/deep-nest", DocumentSizes(), [](size_t n)
+   {
+      std::string path;
+      for (size_t i = 0; i < n; ++i)
+         path += "child.";
+      path += "depth";
+      return [root = DeepNest(n), cp = YAML::CompilePath(path)] { Consume(YAML::Select(root, cp)); };
+   });
+
+   Register selectKeyFanOut("Select/key-fan-out/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(YAML::Select(root, "name")); };
+   });
+
+   Register eachKeyFanOut("SelectEach/key-fan-out/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { size_t count = 0; YAML::SelectEach(root, "name", [&](Node const &) { ++count; }); Consume(count); };
+   });
+
+   Register selectIndex("Select/index/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n), index = n / 8] { Consume(YAML::Select(root, "[%].name", { index })); };
+   });
+
+   Register selectIndexAfterFanOut("Select/index-after-fan-out/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n), index = n / 8] { Consume(YAML::Select(root, "name[%]", { index })); };
+   });
+
+   // a page of 100 names: the whole fan-out copied into a page, vs. a slice reading only the page
+   Register selectPageCopy("Select/page-copy/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n), first = n / 8]
+      {
+         Node all = YAML::Select(root, "name");
+         Node page(YAML::NodeType::Sequence);
+         for (size_t i = first; i < first + 100 && i < all.size(); ++i)
+            page.push_back(all[i]);
+         Consume(page);
+      };
+   });
+
+   Register selectSlice("Select/slice/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n), first = n / 8] { Consume(YAML::Select(root, "[%-%].name", { first, first + 99 })); };
+   });
+
+   Register eachSlice("SelectEach/slice/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n), first = n / 8] { size_t count = 0; YAML::SelectEach(root, "[%-%].name", [&](Node const &) { ++count; }, { first, first + 99 }); Consume(count); };
+   });
+
+   Register selectFilter("Select/map-filter/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(YAML::Select(root, "{color=red}")); };
+   });
+
+   Register selectFilterConditions("Select/map-filter-3-conditions/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(YAML::Select(root, "{!color=red,!price=5,!name='name-5'}")); };
+   });
+
+   Register selectFilterScanFirst("Select/map-filter-scan-written-first/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      // the missing required key is checked first, see OrderConditions
+      return [root = LongSequence(n)] { Consume(YAML::Select(root, "{^COL*=green,color=red,!discount=}")); };
+   });
+
+   Register selectFilterKeys("Select/map-filter-select-keys/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(YAML::Select(root, "{color=red,id,name}")); };
+   });
+
+   Register selectFilterParallel("Select/map-filter-parallel/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      auto context = std::make_shared<YAML::PathContext>();
+      context->SetOptions({ 0, 1000 });     // all hardware threads
+      return [root = LongSequence(n), context] { Consume(YAML::Select(root, "{color=red}", {}, context.get())); };
+   });
+
+   Register selectFilterTraced("Select/map-filter-traced/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      auto stats = std::make_shared<YAML::PathStats>();
+      auto context = std::make_shared<YAML::PathContext>();
+      context->SetTracer(stats.get());
+      return [root = LongSequence(n), context, stats] { Consume(YAML::Select(root, "{color=red}", {}, context.get())); };
+   });
+
+   Register selectFilterNoCase("Select/map-filter-nocase-starry/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(YAML::Select(root, "{^col*=red}.price")); };
+   });
+
+   Register selectFilterExact("SelectFirst/map-filter-exact/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n), id = Mid("", n / 4)] { Consume(YAML::SelectFirst(root, "{id=%}", { PathArg(id) })); };
+   });
+
+   Register selectFilterIndexed("SelectFirst/map-filter-indexed/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      auto root = LongSequence(n);
+      auto context = std::make_shared<YAML::PathContext>();
+      context->AddIndex(root, "id");
+      return [root, context, id = Mid("", n / 4)] { Consume(YAML::SelectFirst(root, "{id=%}", { PathArg(id) }, context.get())); };
+   });
+
+   Register selectLiteral("Select/literal/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(YAML::Select(root, "[100].name")); };
+   });
+
+   Register selectStatic("Select/static-path/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(YAML::Select(root, YAML_STATIC_PATH("[100].name"))); };
+   });
+
+   Register selectStaticFilter("Select/static-path-map-filter/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(YAML::Select(root, YAML_STATIC_PATH("{color=red}"))); };
+   });
+
+   Register selectFilterIndexedRequired("Select/map-filter-indexed-2-conditions/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      auto root = LongSequence(n);
+      auto context = std::make_shared<YAML::PathContext>();
+      context->AddIndex(root, "id");
+      return [root, context, id = Mid("", n / 4)] { Consume(YAML::Select(root, "{!id=%,!color=red}", { PathArg(id) }, context.get())); };
+   });
+
+   // --- type predicates: the map values of a mixed-type sequence
+
+   Register selectTypeInCpp("Select+type-check-in-C++/mixed-sequence", DocumentSizes(), [](size_t n)
+   {
+      // filtering in C++ copies the result of Select into another sequence
+      return [root = MixedSequence(n)] 
+      { 
+         Node maps;
+         for (auto && value : YAML::Select(root, "value"))
+            if (value.IsMap())
+               maps.push_back(value);
+         Consume(maps);
+      };
+   });
+
+   Register selectTypeCheck("Select/type-check/mixed-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = MixedSequence(n)] { Consume(YAML::Select(root, "value!ismap")); };
+   });
+
+   Register eachTypeCheck("SelectEach/type-check/mixed-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = MixedSequence(n)] { size_t count = 0; YAML::SelectEach(root, "value!ismap", [&](Node const &) { ++count; }); Consume(count); };
+   });
+
+   Register eachTypeFilter("SelectEach/type-filter/mixed-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = MixedSequence(n)] { size_t count = 0; YAML::SelectEach(root, "[$ismap].id", [&](Node const &) { ++count; }); Consume(count); };
+   });
+
+   Register selectTypeKeys("Select/type-keys/mixed-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = MixedSequence(n)] { Consume(YAML::Select(root, "[0-99]{$isseq}")); };
+   });
+
+   Register streamTypeCheck("SelectStream/type-check/mixed-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [yaml = MixedSequenceYaml(n), cp = YAML::CompilePath("value!ismap")]
+      {
+         std::istringstream input(yaml);
+         size_t count = 0;
+         YAML::SelectStream(input, cp, [&](Node const &) { ++count; });
+         Consume(count);
+      };
+   });
+
+   // --- groups of conditions: red items at price 5 or blue items at price 7
+
+   Register selectFilterGroupsAsSelects("Select/map-filter-2-selects-concatenated/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      // without "&": one pass per group, and the results are not in sequence order
+      return [root = LongSequence(n)] 
+      { 
+         auto result = YAML::Select(root, "{!color=red,!price=5}");
+         for (auto && el : YAML::Select(root, "{!color=blue,!price=7}"))
+            result.push_back(el);
+         Consume(result);
+      };
+   });
+
+   Register selectFilterGroups("Select/map-filter-groups/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(YAML::Select(root, "{color=red&price=5,color=blue&price=7}")); };
+   });
+
+   Register selectFilterGroupsIndexed("Select/map-filter-groups-indexed/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      auto root = LongSequence(n);
+      auto context = std::make_shared<YAML::PathContext>();
+      context->AddIndex(root, "color");
+      context->AddIndex(root, "price");
+      return [root, context] { Consume(YAML::Select(root, "{color=red&price=5,color=blue&price=7}", {}, context.get())); };
+   });
+
+   // --- recursive key: a nested configuration of n/10 services, with a "timeout" at three depths
+
+   YAML::Node NestedConfig(size_t n)
+   {
+      std::string yaml = "defaults : { timeout : 30 }\nservices :\n";
+      for (size_t i = 0; i < std::max<size_t>(n / 10, 1); ++i)
+         yaml += "   s" + std::to_string(i) + " : { name : n" + std::to_string(i) + ", settings : { timeout : " + std::to_string(i % 60) 
+                 + ", retry : { count : 3, timeout : 5 } }, hosts : [ a, b ] }\n";
+      return YAML::Load(yaml);
+   }
+
+   Register recursiveWalk("Select/recursive-key/nested-config", DocumentSizes(), [](size_t n)
+   {
+      return [root = NestedConfig(n)] { Consume(YAML::Select(root, "..timeout")); };
+   });
+
+   Register recursiveIndexed("Select/recursive-key-indexed/nested-config", DocumentSizes(), [](size_t n)
+   {
+      auto root = NestedConfig(n);
+      auto context = std::make_shared<YAML::PathContext>();
+      context->AddDocumentIndex(root);
+      return [root, context] { Consume(YAML::Select(root, "..timeout", {}, context.get())); };
+   });
+
+   Register recursiveFanOutIndexed("Select/recursive-key-fan-out-indexed/nested-config", DocumentSizes(), [](size_t n)
+   {
+      auto root = NestedConfig(n);
+      auto context = std::make_shared<YAML::PathContext>();
+      context->AddDocumentIndex(root);
+      return [root, context] { Consume(YAML::Select(root, "..settings..count", {}, context.get())); };   // one lookup for each service
+   });
+
+   Register recursiveFirstIndexed("SelectFirst/recursive-key-indexed/nested-config", DocumentSizes(), [](size_t n)
+   {
+      auto root = NestedConfig(n);
+      auto context = std::make_shared<YAML::PathContext>();
+      context->AddDocumentIndex(root);
+      return [root, context] { Consume(YAML::SelectFirst(root, "..retry", {}, context.get())); };
+   });
+
+   Register documentIndexBuild("DocumentIndex/build/nested-config", DocumentSizes(), [](size_t n)
+   {
+      return [root = NestedConfig(n)] { Consume(YAML::DocumentIndex(root["services"]).Find("timeout").size()); };
+   });
+
+   Register documentIndexBuildParallel("DocumentIndex/build-parallel/nested-config", DocumentSizes(), [](size_t n)
+   {
+      return [root = NestedConfig(n)] { Consume(YAML::DocumentIndex(root["services"], 0).Find("timeout").size()); };    // the services are split into chunks
+   });
+
+   // --- SelectCache: the same filter evaluated repeatedly
+
+   Register selectUncached("Select/map-filter-by-id/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n), id = Mid("", n / 4)] { Consume(YAML::Select(root, "{id=%}.name", { PathArg(id) })); };
+   });
+
+   Register selectCache("SelectCache/map-filter-by-id/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      auto cache = std::make_shared<YAML::SelectCache>(LongSequence(n));
+      return [cache, id = Mid("", n / 4)] { Consume(cache->Select("{id=%}.name", { PathArg(id) })); };
+   });
+
+   // --- SelectStream: selecting while parsing, compared to loading the document first
+
+   Register loadSelectFilter("Load+SelectEach/map-filter/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [yaml = LongSequenceYaml(n)]
+      {
+         size_t count = 0;
+         YAML::SelectEach(YAML::Load(yaml), "{color=red}.name", [&](Node const &) { ++count; });
+         Consume(count);
+      };
+   });
+
+   Register streamFilter("SelectStream/map-filter/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [yaml = LongSequenceYaml(n), cp = YAML::CompilePath("{color=red}.name")]
+      {
+         std::istringstream input(yaml);
+         size_t count = 0;
+         YAML::SelectStream(input, cp, [&](Node const &) { ++count; });
+         Consume(count);
+      };
+   });
+
+   Register streamKey("SelectStream/key-fan-out/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [yaml = LongSequenceYaml(n), cp = YAML::CompilePath("price")]
+      {
+         std::istringstream input(yaml);
+         size_t count = 0;
+         YAML::SelectStream(input, cp, [&](Node const &) { ++count; });
+         Consume(count);
+      };
+   });
+
+   Register streamIndex("SelectStream/index/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [yaml = LongSequenceYaml(n), cp = YAML::CompilePath("[10].name")]
+      {
+         std::istringstream input(yaml);
+         YAML::SelectStream(input, cp, [&](Node const & name) { Consume(name); });
+      };
+   });
+
+   // --- SelectAll: a stream of n/4 documents, compared to LoadAll
+
+   std::string ManyDocuments(size_t n)
+   {
+      std::string yaml;
+      for (size_t i = 0; i < std::max<size_t>(n / 4, 1); ++i)
+         yaml += "---\n{ id: " + std::to_string(i) + ", name: name-" + std::to_string(i) + ", color: " + (i % 3 ? "red" : "blue") + ", price: " + std::to_string(i % 100) + " }\n";
+      return yaml;
+   }
+
+   Register loadAllSelect("LoadAll+SelectEach/documents", DocumentSizes(), [](size_t n)
+   {
+      return [yaml = ManyDocuments(n)]
+      {
+         size_t count = 0;
+         for (auto && doc : YAML::LoadAll(yaml))
+            YAML::SelectEach(doc, "{color=red}.name", [&](Node const &) { ++count; });
+         Consume(count);
+      };
+   });
+
+   Register selectAll("SelectAll/documents", DocumentSizes(), [](size_t n)
+   {
+      return [yaml = ManyDocuments(n), cp = YAML::CompilePath("{color=red}.name")]
+      {
+         size_t count = 0;
+         YAML::SelectAll(yaml, cp, [&](Node const &, size_t) { ++count; });
+         Consume(count);
+      };
+   });
+
+   Register selectAllParallel("SelectAll/parallel/documents", DocumentSizes(), [](size_t n)
+   {
+      auto context = std::make_shared<YAML::PathContext>();
+      context->SetOptions({ 0, 1 });     // all hardware threads
+      return [yaml = ManyDocuments(n), cp = YAML::CompilePath("{color=red}.name"), context]
+      {
+         size_t count = 0;
+         YAML::SelectAll(yaml, cp, [&](Node const &, size_t) { ++count; }, context.get());
+         Consume(count);
+      };
+   });
+
+   // --- many paths from one configuration: 30 sections of 10 keys, and a sequence of services
+
+   struct ManyPaths
+   {
+      Node root;
+      std::vector<std::string> storage;
+      std::vector<PathArg> paths;
+
+      explicit ManyPaths(size_t n)
+      {
+         std::string yaml;
+         for (size_t s = 0; s < 30; ++s)
+         {
+            yaml += "section" + std::to_string(s) + ":\n";
+            for (size_t k = 0; k < 10; ++k)
+            {
+               yaml += "   key" + std::to_string(k) + ": " + std::to_string(s * k) + "\n";
+               storage.push_back("section" + std::to_string(s) + ".key" + std::to_string(k));
+            }
+         }
+         yaml += "services:\n";
+         for (size_t i = 0; i < n / 4; ++i)
+            yaml += "   - { name: service" + std::to_string(i) + ", enabled: " + (i % 2 ? "true" : "false") + ", port: " + std::to_string(i) + " }\n";
+         root = YAML::Load(yaml);
+
+         for (auto field : { "name", "port", "name[0]", "port[1]" })
+            storage.push_back(std::string("services{enabled=true}.") + field);
+         for (auto && path : storage)
+            paths.push_back(path);
+      }
+   };
+
+   Register selectManyLoop("SelectMany/Select-loop/304-paths", { 1000, 10000 }, [](size_t n)
+   {
+      return [many = std::make_shared<ManyPaths>(n)] { for (auto path : many->paths) Consume(YAML::Select(many->root, path)); };
+   });
+
+   Register selectMany("SelectMany/trie/304-paths", { 1000, 10000 }, [](size_t n)
+   {
+      return [many = std::make_shared<ManyPaths>(n)] { Consume(YAML::SelectMany(many->root, many->paths.data(), many->paths.size()).size()); };
+   });
+
+   // --- README examples, Select vs. SelectEach (which does not create a result sequence)
+
+   char const * const ReadmePaths[] = { "name", "[1].name", "name[2]", "{color=red}", "{friends=}", "friends.Wladimir", "friends.Wladimir[0]", "[1].color" };
+
+   struct RegisterReadme
+   {
+      RegisterReadme()
+      {
+         for (char const * path : ReadmePaths)
+         {
+            Register(std::string("Select/readme/") + path, DocumentSizes(), [path](size_t n)
+            {
+               return [root = ReadmeSample(n), path] { Consume(YAML::Select(root, path)); };
+            });
+            Register(std::string("SelectEach/readme/") + path, DocumentSizes(), [path](size_t n)
+            {
+               return [root = ReadmeSample(n), path] { size_t count = 0; YAML::SelectEach(root, path, [&](Node const &) { ++count; }); Consume(count); };
+            });
+         }
+      }
+   } readme;
+
+   // --- Ensure / Create
+
+   Register create("Create/nested", {}, [](size_t)
+   {
+      return [] { Consume(YAML::Create("keyA.{X=11,Y}.keyB[2].keyC")); };
+   });
+
+   Register ensureExisting("Ensure/existing/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      auto root = LongSequence(n);
+      YAML::Ensure(root, "[%].tags", { n / 8 });
+      return [root, index = n / 8]() mutable { Consume(YAML::Ensure(root, "[%].tags", { index })); };
+   });
+
+   Register ensureNewKeys("Ensure/new-keys", { 1000 }, [](size_t n)
+   {
+      // builds a map of n keys through Ensure
+      return [n]
+      {
+         Node root;
+         for (size_t i = 0; i < n; ++i)
+            YAML::Ensure(root, "items.%", { PathArg(std::to_string(i)) });
+         Consume(root);
+      };
+   });
+
+   // n entries as paths and values: records[<i>].id and records[<i>].name for n/2 records
+   // The values are created for each run: an assigned node shares the memory of the document from then on.
+   struct ManyEntries
+   {
+      std::vector<std::string> paths;
+
+      explicit ManyEntries(size_t n)
+      {
+         for (size_t i = 0; i < n / 2; ++i)
+         {
+            paths.push_back("records[" + std::to_string(i) + "].id");
+            paths.push_back("records[" + std::to_string(i) + "].name");
+         }
+      }
+
+      static Node Value(size_t i) { return i % 2 ? Node("name-" + std::to_string(i / 2)) : Node(i / 2); }
+   };
+
+   Register ensureLoop("Ensure/loop/records", { 1000 }, [](size_t n)
+   {
+      return [many = std::make_shared<ManyEntries>(n)]
+      {
+         Node root;
+         for (size_t i = 0; i < many->paths.size(); ++i)
+         {
+            Node result = YAML::Ensure(root, many->paths[i]);
+            for (size_t r = 0; r < result.size(); ++r)
+               result[r] = ManyEntries::Value(i);
+         }
+         Consume(root);
+      };
+   });
+
+   Register assignLoop("Assign/loop/records", { 1000, 10000 }, [](size_t n)
+   {
+      return [many = std::make_shared<ManyEntries>(n)]
+      {
+         Node root;
+         for (size_t i = 0; i < many->paths.size(); ++i)
+            YAML::Assign(root, many->paths[i], ManyEntries::Value(i));
+         Consume(root);
+      };
+   });
+
+   Register assignNewKeys("Assign/new-keys", { 1000 }, [](size_t n)
+   {
+      return [n]
+      {
+         Node root;
+         for (size_t i = 0; i < n; ++i)
+            YAML::Assign(root, "items.%", i, { PathArg(std::to_string(i)) });
+         Consume(root);
+      };
+   });
+
+   Register ensureMany("EnsureMany/records", { 1000, 10000, 100000 }, [](size_t n)
+   {
+      return [many = std::make_shared<ManyEntries>(n)]
+      {
+         std::vector<std::pair<PathArg, Node>> items;
+         items.reserve(many->paths.size());
+         for (size_t i = 0; i < many->paths.size(); ++i)
+            items.emplace_back(many->paths[i], ManyEntries::Value(i));
+
+         Node root;
+         YAML::EnsureMany(root, items.data(), items.size());
+         Consume(root);
+      };
+   });
+
+   // --- Accumulate
+
+   Register accumulateSelect("Accumulate/Select/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(size_t(YAML::Accumulate<int>(YAML::Select(root, "price")))); };
+   });
+
+   Register accumulateEach("SelectAccumulate/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(size_t(YAML::SelectAccumulate<int>(root, "price"))); };
+   });
+
+   // the conversion yaml-cpp does for each element, compared to Accumulate
+   Register accumulateAsLoop("Accumulate/as-loop/decimals", DocumentSizes(), [](size_t n)
+   {
+      return [root = NumberSequence(n, true)] { double sum = 0; for (auto && el : root) sum += el.as<double>(); Consume(size_t(sum)); };
+   });
+
+   Register accumulateDouble("Accumulate/double/decimals", DocumentSizes(), [](size_t n)
+   {
+      return [root = NumberSequence(n, true)] { Consume(size_t(YAML::Accumulate<double>(root))); };
+   });
+
+   Register accumulateDoubleParallel("Accumulate/double-parallel/decimals", DocumentSizes(), [](size_t n)
+   {
+      auto context = std::make_shared<YAML::PathContext>();
+      context->SetOptions({ 0, 1000 });     // all hardware threads
+      return [root = NumberSequence(n, true), context] { Consume(size_t(YAML::Accumulate<double>(root, 0, context.get()))); };
+   });
+
+   Register accumulateInt64AsLoop("Accumulate/as-loop/integers", DocumentSizes(), [](size_t n)
+   {
+      return [root = NumberSequence(n, false)] { int64_t sum = 0; for (auto && el : root) sum += el.as<int64_t>(); Consume(size_t(sum)); };
+   });
+
+   Register accumulateInt64("Accumulate/int64/integers", DocumentSizes(), [](size_t n)
+   {
+      return [root = NumberSequence(n, false)] { Consume(size_t(YAML::Accumulate<int64_t>(root))); };
+   });
+
+   Register selectMean("SelectMean/long-sequence", DocumentSizes(), [](size_t n)
+   {
+      return [root = LongSequence(n)] { Consume(size_t(*YAML::SelectMean(root, "price"))); };
+   });
+}
@@ -0,0 +1,163 @@
+/* yaml-path benchmarks
+
+   usage: yaml-path-bench [--smoke] [--filter=<substring>] [--min-time=<seconds>]
+          yaml-path-bench <Google Benchmark options>         (if built with Google Benchmark)
+
+   Reports ns/op, heap allocations/op, and the peak heap growth while running the operation.
+   The document sizes are selected by the environment variable YAML_PATH_BENCH_MAX_NODES, see DocumentSizes().
+
+   --smoke runs each case once on the smallest document, to check that all cases run.
+
+   Note that yaml-cpp keeps every node created in a document's memory until the document is released: 
+   a result sequence built by Select stays allocated, and shows as peak growth proportional to the number of operations.
+*/
+
+#include "bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#ifdef YAML_PATH_HAVE_BENCHMARK
+#include <benchmark/benchmark.h>
+#endif
+
+using namespace YamlPathBench;
+
+namespace
+{
+   std::string CaseName(Case const & c, size_t n)
+   {
+      return c.sizes.empty() ? c.name : c.name + "/" + std::to_string(n);
+   }
+
+   std::vector<size_t> RunSizes(Case const & c)
+   {
+      return c.sizes.empty() ? std::vector<size_t>{ 0 } : c.sizes;
+   }
+
+   struct Result
+   {
+      size_t iterations = 0;
+      double nsPerOp = 0;
+      double allocsPerOp = 0;
+      size_t peakBytes = 0;
+   };
+
+   Result Run(Operation const & op, double minSeconds)
+   {
+      op();    // warm up path cache and lazy state
+
+      Result result;
+      size_t allocsBefore = Allocations();
+      size_t liveBefore = LiveBytes();
+      ResetPeak();
+
+      auto start = std::chrono::steady_clock::now();
+      std::chrono::duration<double> elapsed{};
+      for (size_t batch = 1; elapsed.count() < minSeconds; batch *= 2)
+      {
+         for (size_t i = 0; i < batch; ++i)
+            op();
+         result.iterations += batch;
+         elapsed = std::chrono::steady_clock::now() - start;
+      }
+
+      result.nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / result.iterations;
+      result.allocsPerOp = double(Allocations() - allocsBefore) / result.iterations;
+      result.peakBytes = PeakBytes() - liveBefore;
+      return result;
+   }
+
+   int RunStandalone(bool smoke, char const * filter, double minSeconds)
+   {
+      if (!smoke)
+         std::printf("%-56s %12s %14s %14s %12s\n", "case", "iterations", "ns/op", "allocs/op", "peak KiB");
+
+      for (auto const & c : Cases())
+      {
+         for (size_t n : RunSizes(c))
+         {
+            std::string name = CaseName(c, n);
+            if (filter && name.find(filter) == std::string::npos)
+               continue;
+
+            Operation op = c.setup(n);
+            if (smoke)
+            {
+               op();
+               break;
+            }
+
+            Result r = Run(op, minSeconds);
+            std::printf("%-56s %12zu %14.1f %14.1f %12.1f\n", name.c_str(), r.iterations, r.nsPerOp, r.allocsPerOp, r.peakBytes / 1024.0);
+         }
+      }
+      if (smoke)
+         std::printf("%zu cases ok\n", Cases().size());
+      return 0;
+   }
+
+#ifdef YAML_PATH_HAVE_BENCHMARK
+   void RegisterWithBenchmark()
+   {
+      for (auto const & c : Cases())
+      {
+         for (size_t n : RunSizes(c))
+         {
+            // the setup runs once, before the first measurement of the case
+            auto op = std::make_shared<Operation>();
+            benchmark::RegisterBenchmark(CaseName(c, n).c_str(), [&c, n, op](benchmark::State & state)
+            {
+               if (!*op)
+               {
+                  *op = c.setup(n);
+                  (*op)();
+               }
+
+               size_t allocsBefore = Allocations();
+               size_t liveBefore = LiveBytes();
+               ResetPeak();
+               for (auto _ : state)
+                  (*op)();
+
+               state.counters["allocs/op"] = benchmark::Counter(double(Allocations() - allocsBefore), benchmark::Counter::kAvgIterations);
+               state.counters["peak"] = benchmark::Counter(double(PeakBytes() - liveBefore), benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+            });
+         }
+      }
+   }
+#endif
+}
+
+int main(int argc, char ** argv)
+{
+   bool smoke = false;
+   bool standalone = false;      // own options select the own runner
+   char const * filter = nullptr;
+   double minSeconds = 0.2;
+   for (int i = 1; i < argc; ++i)
+   {
+      if (!std::strcmp(argv[i], "--smoke"))
+         smoke = standalone = true;
+      else if (!std::strncmp(argv[i], "--filter=", 9))
+         filter = argv[i] + 9, standalone = true;
+      else if (!std::strncmp(argv[i], "--min-time=", 11))
+         minSeconds = std::atof(argv[i] + 11), standalone = true;
+   }
+
+#ifdef YAML_PATH_HAVE_BENCHMARK
+   if (!standalone)
+   {
+      RegisterWithBenchmark();
+      benchmark::Initialize(&argc, argv);
+      benchmark::RunSpecifiedBenchmarks();
+      benchmark::Shutdown();
+      return 0;
+   }
+#endif
+
+   return RunStandalone(smoke, filter, minSeconds);
+}
@@ -0,0 +1,192 @@
+#include "bench.h"
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+// --- heap statistics
+// Each allocation is prefixed with its size, so delete can track the live bytes.
+
+namespace
+{
+   constexpr size_t HeaderSize = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+
+   std::atomic<size_t> g_allocations{ 0 };
+   std::atomic<size_t> g_liveBytes{ 0 };
+   std::atomic<size_t> g_peakBytes{ 0 };
+
+   void * Allocate(size_t size) noexcept
+   {
+      char * p = static_cast<char *>(std::malloc(HeaderSize + size));
+      if (!p)
+         return nullptr;
+
+      *reinterpret_cast<size_t *>(p) = size;
+      g_allocations.fetch_add(1, std::memory_order_relaxed);
+      size_t live = g_liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+      size_t peak = g_peakBytes.load(std::memory_order_relaxed);
+      while (live > peak && !g_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+         ;
+      return p + HeaderSize;
+   }
+
+   void Free(void * p) noexcept
+   {
+      if (!p)
+         return;
+      char * block = static_cast<char *>(p) - HeaderSize;
+      g_liveBytes.fetch_sub(*reinterpret_cast<size_t *>(block), std::memory_order_relaxed);
+      std::free(block);
+   }
+}
+
+void * operator new(size_t size)
+{
+   if (void * p = Allocate(size))
+      return p;
+   throw std::bad_alloc();
+}
+
+void * operator new(size_t size, std::nothrow_t const &) noexcept { return Allocate(size); }
+void operator delete(void * p) noexcept { Free(p); }
+void operator delete(void * p, size_t) noexcept { Free(p); }
+void operator delete(void * p, std::nothrow_t const &) noexcept { Free(p); }
+
+namespace YamlPathBench
+{
+   size_t Allocations() { return g_allocations.load(std::memory_order_relaxed); }
+   size_t LiveBytes()   { return g_liveBytes.load(std::memory_order_relaxed); }
+   size_t PeakBytes()   { return g_peakBytes.load(std::memory_order_relaxed); }
+   void ResetPeak()     { g_peakBytes.store(LiveBytes(), std::memory_order_relaxed); }
+
+   // --- generators
+
+   YAML::Node WideMap(size_t n)
+   {
+      std::stringstream yaml;
+      for (size_t i = 0; i < n; ++i)
+         yaml << "key-" << i << ": " << i << "\n";
+      return YAML::Load(yaml.str());
+   }
+
+   std::string LongSequenceYaml(size_t n)
+   {
+      char const * colors[] = { "red", "green", "blue" };
+      std::stringstream yaml;
+      for (size_t i = 0; i < std::max<size_t>(n / 4, 1); ++i)
+         yaml << "- { id: " << i << ", name: name-" << i << ", color: " << colors[i % 3] << ", price: " << i % 100 << " }\n";
+      return yaml.str();
+   }
+
+   YAML::Node LongSequence(size_t n)
+   {
+      return YAML::Load(LongSequenceYaml(n));
+   }
+
+   std::string MixedSequenceYaml(size_t n)
+   {
+      std::stringstream yaml;
+      for (size_t i = 0; i < std::max<size_t>(n / 4, 1); ++i)
+      {
+         if (i % 5 == 4)
+         {
+            yaml << "- s-" << i << "\n";
+            continue;
+         }
+         yaml << "- { id: " << i << ", value: ";
+         switch (i % 4)
+         {
+            case 0:  yaml << "{ a: " << i << " }"; break;
+            case 1:  yaml << i; break;
+            case 2:  yaml << "[ " << i << ", " << i << " ]"; break;
+            default: yaml << "~"; break;
+         }
+         yaml << " }\n";
+      }
+      return yaml.str();
+   }
+
+   YAML::Node MixedSequence(size_t n)
+   {
+      return YAML::Load(MixedSequenceYaml(n));
+   }
+
+   YAML::Node NumberSequence(size_t n, bool decimals)
+   {
+      std::stringstream yaml;
+      for (size_t i = 0; i < n; ++i)
+      {
+         if (decimals)
+            yaml << "- " << i % 1000 << "." << i % 100 << "\n";
+         else
+            yaml << "- " << i * 7 % 100000 << "\n";
+      }
+      return YAML::Load(yaml.str());
+   }
+
+   YAML::Node DeepNest(size_t n)
+   {
+      // built directly, the emitter and parser recurse per nesting level
+      YAML::Node root(YAML::NodeType::Map);
+      YAML::Node current = root;
+      for (size_t i = 0; i < n; ++i)
+      {
+         current["depth"] = i;
+         YAML::Node child(YAML::NodeType::Map);
+         current["child"] = child;
+         current.reset(child);
+      }
+      return root;
+   }
+
+   YAML::Node ReadmeSample(size_t n)
+   {
+      std::stringstream yaml;
+      for (size_t i = 0; i < std::max<size_t>(n / 7, 3); i += 3)
+      {
+         yaml << "- { name: Joe, color: red, friends: ~ }\n"
+                 "- { name: Sina, color: blue }\n"
+                 "- { name: Estragon, color: red, friends: { Wladimir: good, Godot: unreliable } }\n";
+      }
+      return YAML::Load(yaml.str());
+   }
+
+   // --- cases
+
+   std::vector<Case> & Cases()
+   {
+      static std::vector<Case> cases;
+      return cases;
+   }
+
+   Register::Register(std::string name, std::vector<size_t> sizes, std::function<Operation(size_t n)> setup)
+   {
+      Cases().push_back({ std::move(name), std::move(sizes), std::move(setup) });
+   }
+
+   std::vector<size_t> const & DocumentSizes()
+   {
+      static std::vector<size_t> sizes = []
+      {
+         size_t maxNodes = 100000;
+         if (char const * env = std::getenv("YAML_PATH_BENCH_MAX_NODES"))
+            maxNodes = std::min<size_t>(std::strtoul(env, nullptr, 10), 1000000);
+
+         std::vector<size_t> result;
+         for (size_t n = 1000; n <= maxNodes; n *= 10)
+            result.push_back(n);
+         return result;
+      }();
+      return sizes;
+   }
+
+   namespace
+   {
+      std::atomic<size_t> g_sink{ 0 };
+   }
+
+   void Consume(YAML::Node const & node) { g_sink.fetch_add(node ? 1 : 0, std::memory_order_relaxed); }
+   void Consume(size_t value)            { g_sink.fetch_add(value, std::memory_order_relaxed); }
+}
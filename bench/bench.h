@@ -0,0 +1,72 @@
+/* Support for the yaml-path benchmarks: allocation counters, document generators, and the list of benchmark cases.
+
+   A case is registered with a name, the document sizes it runs on, and a setup function.
+   The setup function builds the document (not measured) and returns the operation to measure.
+   bench-main.cpp runs the cases with Google Benchmark if available, or with its own runner.
+*/
+
+#pragma once
+
+#include "yaml-path/yaml-path.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace YamlPathBench
+{
+   // --- heap statistics, counted by the replacement operator new / delete in bench-support.cpp
+   size_t Allocations();         ///< number of allocations since start
+   size_t LiveBytes();           ///< bytes currently allocated
+   size_t PeakBytes();           ///< highest value of LiveBytes() since the last ResetPeak
+   void ResetPeak();             ///< sets PeakBytes() to LiveBytes()
+
+   // --- document generators. n is the approximate number of nodes.
+
+   /// a map with n scalar values, keys "key-0" .. "key-<n-1>"
+   YAML::Node WideMap(size_t n);
+
+   /// a sequence of n/4 maps { id: <i>, name: name-<i>, color: (red|green|blue), price: <i % 100> }
+   YAML::Node LongSequence(size_t n);
+   std::string LongSequenceYaml(size_t n);       ///< the document of LongSequence, as text
+
+   /** a sequence of about n/4 elements: every fifth is a scalar <tt>s-<i></tt>, the others are maps { id: <i>, value: <v> },
+       where the values cycle through a map { a: <i> }, a scalar <i>, a sequence [ <i>, <i> ], and null
+   */
+   YAML::Node MixedSequence(size_t n);
+   std::string MixedSequenceYaml(size_t n);      ///< the document of MixedSequence, as text
+
+   /// a sequence of n numbers: integers <i * 7 % 100000>, or with \c decimals <i % 1000>.<i % 100>
+   YAML::Node NumberSequence(size_t n, bool decimals);
+
+   /// n maps nested in each other under the key "child", each with a scalar "depth"
+   YAML::Node DeepNest(size_t n);
+
+   /// the README sample, repeated to n/7 sequence elements
+   YAML::Node ReadmeSample(size_t n);
+
+   // --- cases
+   using Operation = std::function<void()>;
+
+   struct Case
+   {
+      std::string name;
+      std::vector<size_t> sizes;                   ///< document sizes in nodes; empty if the case does not use a document
+      std::function<Operation(size_t n)> setup;
+   };
+
+   std::vector<Case> & Cases();
+
+   /// registers a case at static initialization
+   struct Register
+   {
+      Register(std::string name, std::vector<size_t> sizes, std::function<Operation(size_t n)> setup);
+   };
+
+   /// document sizes for the cases: 1e3 up to the value of the environment variable YAML_PATH_BENCH_MAX_NODES (default 1e5, at most 1e6)
+   std::vector<size_t> const & DocumentSizes();
+
+   /// prevents the optimizer from omitting a result
+   void Consume(YAML::Node const & node);
+   void Consume(size_t value);
+}
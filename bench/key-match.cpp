@@ -0,0 +1,110 @@
+/* Key matching for case insensitive and starry map filter tokens.
+
+   Matches every key of a wide map against a set of tokens, using the previous StrIsMatch
+   (string conversion per key, strncasecmp) and the current one (scalar read in place, precomputed folded token),
+   and selects from a sequence of such maps with the corresponding map filters.
+
+   usage: key-match [keys=5000] [repetitions=20]
+*/
+
+#include "yaml-path/yaml-path.h"
+#include "yaml-path/yaml-path-internals.h"
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <strings.h>
+
+namespace
+{
+   // StrIsMatch before the in-place match engine
+   bool LegacyStrIsMatch(YAML::KVToken const & tok, YAML::Node const & node)
+   {
+      if (!node.IsScalar())
+         return false;
+
+      if (tok.IsAllStar())
+         return true;
+
+      std::string snode = node.as<std::string>();
+      if (!tok.starry && snode.length() != tok.token.length())
+         return false;
+
+      if (tok.starry && snode.length() < tok.token.length())
+         return false;
+
+      size_t cmpLen = std::min(tok.token.length(), snode.length());
+      int result = tok.noCase ? strncasecmp(&tok.token[0], snode.c_str(), cmpLen) : strncmp(&tok.token[0], snode.c_str(), cmpLen);
+      return result == 0;
+   }
+
+   template <typename TFunc>
+   double MeasureUs(size_t repetitions, TFunc func)
+   {
+      func();
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < repetitions; ++i)
+         func();
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      return std::chrono::duration<double, std::micro>(elapsed).count() / repetitions;
+   }
+}
+
+int main(int argc, char ** argv)
+{
+   size_t keys = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000;
+   size_t repetitions = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+
+   // mixed-case keys with a shared prefix, some of them longer than 16 characters
+   char const * prefixes[] = { "HostName", "hostAddressPrimary", "Port", "ConfigurationEntry" };
+   std::stringstream yaml;
+   for (size_t i = 0; i < keys; ++i)
+      yaml << prefixes[i % 4] << i << ": value" << i << "\n";
+   YAML::Node wide = YAML::Load(yaml.str());
+
+   YAML::Node seq(YAML::NodeType::Sequence);
+   for (size_t i = 0; i < 8; ++i)
+      seq.push_back(YAML::Clone(wide));
+
+   struct Case { char const * text; YAML::KVToken token; char const * filter; };
+   Case cases[] =
+   {
+      { "^host*",                      { "host", false, true, true },                      "{^host*=nomatch}" },
+      { "host*",                       { "host", false, false, true },                     "{host*=nomatch}" },
+      { "^hostaddressprimary*",        { "hostaddressprimary", false, true, true },        "{^hostaddressprimary*=nomatch}" },
+      { "^configurationentry4999",     { "configurationentry4999", false, true, false },   "{^configurationentry4999=nomatch}" },
+   };
+
+   std::printf("%zu keys, %zu repetitions\n", wide.size(), repetitions);
+   std::printf("%-28s %10s %14s %14s %16s\n", "token", "matches", "legacy us/op", "new us/op", "filter us/op");
+   for (auto & c : cases)
+   {
+      std::string folded = YAML::YamlPathDetail::FoldCase(c.token.token);
+      YAML::PathArg foldedArg = c.token.noCase ? YAML::PathArg(folded) : YAML::PathArg();
+
+      size_t legacyMatches = 0, newMatches = 0;
+      double legacy = MeasureUs(repetitions, [&]
+      {
+         legacyMatches = 0;
+         for (auto && kv : wide)
+            legacyMatches += LegacyStrIsMatch(c.token, kv.first);
+      });
+      double current = MeasureUs(repetitions, [&]
+      {
+         newMatches = 0;
+         for (auto && kv : wide)
+            newMatches += YAML::YamlPathDetail::StrIsMatch(c.token, foldedArg, kv.first);
+      });
+      if (legacyMatches != newMatches)
+         std::printf("%s: legacy matches %zu, new matches %zu\n", c.text, legacyMatches, newMatches);
+
+      auto cp = YAML::CompilePath(c.filter);
+      double filter = MeasureUs(repetitions, [&] { YAML::SelectCount(seq, cp); }) / seq.size();
+
+      std::printf("%-28s %10zu %14.1f %14.1f %16.1f\n", c.text, newMatches, legacy, current, filter);
+   }
+   return 0;
+}
@@ -7,7 +7,20 @@
 #include <yaml-cpp/yaml.h>
 #include <yaml-path/yaml-path.h>
 #include <yaml-path/yaml-path-internals.h>
+#include <yaml-path/yaml-path-static.h>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
 #include <assert.h>
 
 struct YamlNodeForDocTest
@@ -29,7 +42,7 @@ namespace YAML
       if (p)
          return p;
 
-      return (std::stringstream() << "(" << (int)value << ")").str().c_str(); 
+      return ("(" + std::to_string((int)value) + ")").c_str();
    }
 
    doctest::String toString(EPathError value) { return DT2String(value, YamlPathDetail::MapEPathErrorName); }
@@ -41,7 +54,7 @@ namespace YAML
 
    }
 
-   doctest::String toString(YAML::Node const & n) { auto n2 = Clone(n); n2.SetStyle(EmitterStyle::Flow); return (Emitter() << n2).c_str(); }
+   doctest::String toString(YAML::Node const & n) { auto n2 = Clone(n); n2.SetStyle(EmitterStyle::Flow); return Dump(n2).c_str(); }
 }
 
 
@@ -168,6 +181,19 @@ TEST_CASE("SelectByKey")
       Node n = Load("abcd");
       CHECK(SelectByKey(n, "X") == EPathError::InvalidNodeType);
    }
+
+   {  // lookup does not modify the node: no key is added, non-map elements are skipped (and not converted to a map)
+      Node root = Load("[ { A : aa }, ~, [ 1, 2 ], xyz, { A : aaa } ]");
+      Node n = root;
+      CHECK(SelectByKey(n, "A") == EPathError::OK);
+      CHECK(n.size() == 2);
+      CHECK(root[1].IsNull());
+      CHECK(root[2].IsSequence());
+
+      Node m = root[0];
+      CHECK(SelectByKey(m, "X") == EPathError::NodeNotFound);
+      CHECK(root[0].size() == 1);
+   }
 }
 
 TEST_CASE("SelectByIndex")
@@ -255,6 +281,20 @@ TEST_CASE("Internal: Split")
    CheckSplit("1234", "1234", "");
 }
 
+TEST_CASE("Internal: EqualFolded")
+{
+   using namespace YAML::YamlPathDetail;
+   CHECK(FoldCase("AbC-xYz@[`{\xC4") == "abc-xyz@[`{\xC4");
+   CHECK(EqualFolded("", "", 0));
+   CHECK(EqualFolded("HELLO", "hello", 5));
+   CHECK(!EqualFolded("HELLO", "hellp", 5));
+   CHECK(!EqualFolded("@[`{", "`{@[", 4));                        // neighbours of the letter ranges don't fold
+   CHECK(EqualFolded("ThisIsALongerKeyName", "thisisalongerkeyname", 20));
+   CHECK(!EqualFolded("ThisIsALongerKeyName", "thisisalongerkeynamf", 20));
+   CHECK(EqualFolded("\xC4\xE4ThisIsALongerKey", "\xC4\xE4thisisalongerkey", 18)); // bytes >= 0x80 are compared as-is
+   CHECK(!EqualFolded("\xC4\xE4ThisIsALongerKey", "\xE4\xE4thisisalongerkey", 18));
+}
+
 // ---- parse level 1: TokenScanner
 TEST_CASE("Internal: TokenScanner")
 {
@@ -291,6 +331,23 @@ TEST_CASE("Internal: TokenScanner")
    }
 }
 
+TEST_CASE("Internal: CharClass")
+{
+   using namespace YamlPathDetail;
+   for (int i = 0; i < 256; ++i)
+   {
+      char c = char(i);
+      CHECK(CharClass(c).space == (isascii(c) && isspace(c)));
+      CHECK(CharClass(c).identifier == (!isascii(c) || !(isspace(c) || ispunct(c))));
+      if (CharClass(c).token != EToken::None)
+         CHECK(ispunct(c));
+   }
+   CHECK(CharClass('.').token == EToken::Period);
+   CHECK(CharClass(',').token == EToken::Comma);
+   CHECK(CharClass('"').token == EToken::None);       // quoted identifiers are scanned separately
+   CHECK(CharClass('\xC4').identifier);
+}
+
 // --- parse level 2: selector scanner
 namespace
 {
@@ -348,9 +405,9 @@ TEST_CASE("ScanSelector")
       // these tests go a little bit into implementation details, 
       // particularly "expectedRight" and "expectedErrorValue" are for diagnostic purposes only, and not exactly guaranteed by the API.
       // However, we check here that they make SOME sense, i.e. not be totally off
-      CheckSelectorError(".a", EPathError::InvalidToken, "", "a");
+      CheckSelectorError(".a", EPathError::InvalidToken, "", "");      // "." starts a recursive key selector, "a" is not the second period
       CheckSelectorError("a.", EPathError::UnexpectedEnd, "a", "");
-      CheckSelectorError("a..b", EPathError::InvalidToken, "a", "b");
+      CheckSelectorError("a...b", EPathError::InvalidToken, "a", "b");
       CheckSelectorError("a[.]", EPathError::InvalidIndex, "a", "]");
    }
 }
@@ -359,7 +416,8 @@ TEST_CASE("ScanSelector - bound arguments")
 {
    using namespace YamlPathDetail;
    {
-      PathScanner scan("node.%.[%].edon", { "param", 42 });
+      PathBoundArgs args = { "param", size_t(42) };   // the scanner refers to the argument list, which must outlive it
+      PathScanner scan("node.%.[%].edon", args);
 
       CHECK(scan.NextSelector() == ESelector::Key);
       CHECK(scan.SelectorData< ArgKey>().key == "node");
@@ -391,6 +449,57 @@ TEST_CASE("PathValidate")
    CHECK(PathValidate(".a.b") == EPathError::InvalidToken);
    CHECK(PathValidate("].a.b") == EPathError::InvalidToken);
    CHECK(PathValidate("a.") == EPathError::UnexpectedEnd);
+
+   size_t offs = 0;
+   std::string valid;
+   CHECK(PathValidate("a.b ", &valid, &offs) == EPathError::OK);
+   CHECK(offs == 3);
+   CHECK(PathValidate("a.[2[", &valid, &offs) == EPathError::InvalidToken);
+   CHECK(offs == 5);
+   CHECK(valid == "a");
+}
+
+TEST_CASE("Diagnostics collected on failure")
+{
+   // Select, Require and Ensure resolve without diagnostics, and collect them again when they throw
+   auto Thrown = [](auto && f)
+   {
+      PathException result;
+      bool thrown = false;
+      try { f(); }
+      catch (PathException const & x) { result = x; thrown = true; }
+      CHECK(thrown);
+      return result;
+   };
+
+   Node root = YAML::Load("[ { name : Joe }, { name : Sina } ]");
+   for (char const * path : { "[1].friends", "[1].~", "[1].{name=%}" })
+   {
+      Node node = root;
+      PathArg rpath = path;
+      PathException expected;
+      PathResolve(node, rpath, {}, &expected);
+
+      for (auto && x : { Thrown([&] { Require(root, path); }), Thrown([&] { Require(root, CompilePath(path)); }) })
+      {
+         CHECK(x.Error() == expected.Error());
+         CHECK(x.ErrorOffset() == expected.ErrorOffset());
+         CHECK(x.ResolvedPath() == expected.ResolvedPath());
+         CHECK(x.BoundArg() == expected.BoundArg());
+         CHECK(x.What() == expected.What());
+      }
+   }
+
+   auto x = Thrown([&] { Node node = YAML::Load("keyA : 12"); Ensure(node, "keyA.keyB"); });
+   CHECK(x.Error() != EPathError::OK);
+   CHECK(x.ResolvedPath() == "keyA");
+   CHECK(x.ErrorOffset() == 9);
+
+   x = Thrown([&] { Node node; Ensure(node, "keyA.%.~", { PathArg("keyB") }); });
+   CHECK(x.Error() != EPathError::OK);
+   CHECK(x.ResolvedPath() == "keyA.%");
+   CHECK(x.ErrorOffset() == 8);
+   CHECK(x.BoundArg() == 0);
 }
 
 YAML::Node CheckPathResolve(YAML::Node node, YAML::PathArg path, std::string expectedRemainder)
@@ -523,6 +632,23 @@ TEST_CASE("PathResolve - SeqMap")
       CHECK(node[0].IsMap());
    }
 
+   {  // multi-stage fan-out
+      auto node = YAML::Load(sroot);
+      PathArg path = "{color=}.name[1]";
+      CHECK(PathResolve(node, path) == EPathError::OK);
+      CHECK(node.as<S>("") == "Sina");
+   }
+
+   {  // a failing selector after a fan-out leaves the intermediate sequence
+      auto node = YAML::Load(sroot);
+      PathArg path = "{color=}.name[2]";
+      CHECK(PathResolve(node, path) == EPathError::NodeNotFound);
+      CHECK(path == "[2]");
+      CHECK(node.IsSequence());
+      CHECK(node.size() == 2);
+      CHECK(node[1].as<S>("") == "Sina");
+   }
+
 }
 
 
@@ -609,6 +735,1491 @@ TEST_CASE("PathResolve - MapFilter (adapted from initial syntax)")
 }
 
 
+TEST_CASE("PathResolve - MapFilter, case insensitive and starry tokens")
+{
+   char const * sroot =
+      R"(
+-  Host : alpha
+   HostNamePrimaryAddress : 10.0.0.1
+-  host : Beta
+   port : 80
+-  hostel : gamma
+   Port : 8080
+-  name : anger
+   PortForwardingEnabled : yes)";
+
+   auto root = YAML::Load(sroot);
+
+   auto Count = [&](char const * path) { return SelectCount(root, path); };
+
+   CHECK(Count("{host=}") == 1);
+   CHECK(Count("{^host=}") == 2);
+   CHECK(Count("{host*=}") == 2);
+   CHECK(Count("{^host*=}") == 3);
+   CHECK(Count("{^HOSTNAMEPRIMARY*=}") == 1);            // folded compare beyond 16 characters
+   CHECK(Count("{^hostnameprimaryaddresS='10.0.0.1'}") == 1);
+   CHECK(Count("{^hostnameprimaryaddresses=}") == 0);
+   CHECK(Count("{host=^beta}") == 1);
+   CHECK(Count("{host=beta}") == 0);
+   CHECK(Count("{^host=^B*}") == 1);
+   CHECK(Count("{^port=80*}") == 2);
+   CHECK(Count("{port*=}") == 1);
+   CHECK(Count("{^portforwardingenabled=^YES}") == 1);
+   CHECK(Count("{name=^ANGER}") == 1);
+
+   // deferred arguments are folded when matching
+   CHECK(SelectCount(root, "{^%*=}", { PathArg("HOST") }) == 3);
+   CHECK(SelectCount(root, "{%=^%}", { PathArg("host"), PathArg("BETA") }) == 1);
+   CHECK(SelectCount(root, CompilePath("{^%*=}", { PathArg("HOST") })) == 3);
+
+   // key selection
+   auto ports = Select(root, "[2]{^port*}");
+   CHECK(ports.IsMap());
+   CHECK(ports.size() == 1);
+   CHECK(ports["Port"].as<int>() == 8080);
+}
+
+
+TEST_CASE("PathResolve - MapFilter, condition order")
+{
+   // the conditions are reordered when the path is compiled, the result is the one of the conditions evaluated in path order
+   Node root;
+   for (char const * a : { "", "1", "2" })
+      for (char const * b : { "", "2", "3" })
+         for (char const * c : { "", "3", "4" })
+         {
+            Node map(NodeType::Map);
+            if (*a) map["a"] = a;
+            if (*b) map["b"] = b;
+            if (*c) map["c"] = c;
+            root.push_back(map);
+         }
+
+   Node map = Load("{ a: 1, b: 3 }");
+   CHECK(SelectExists(map, "{a=1,!b=2}"));      // a required key is present, and an earlier condition matched
+   CHECK(!SelectExists(map, "{!b=2,a=1}"));
+   CHECK(!SelectExists(map, "{a=1,!c=}"));
+   CHECK(SelectExists(map, "{c=,!a=1,!b=4}"));
+
+   struct Condition { char const * text; KVToken key; EKVOp op; KVToken value; };
+   Condition const conditions[] =
+   {
+      { "a=1",    { "a" },                    EKVOp::Equal,    { "1" } },
+      { "!a=1",   { "a", true },              EKVOp::Equal,    { "1" } },
+      { "!b=",    { "b", true },              EKVOp::Exists,   {} },
+      { "b=2",    { "b" },                    EKVOp::Equal,    { "2" } },
+      { "c~=3",   { "c" },                    EKVOp::NotEqual, { "3" } },
+      { "!c=3",   { "c", true },              EKVOp::Equal,    { "3" } },
+      { "^A=1",   { "A", false, true },       EKVOp::Equal,    { "1" } },
+      { "!^B*=2", { "B", true, true, true },  EKVOp::Equal,    { "2" } },
+      { "x*=",    { "x", false, false, true },EKVOp::Exists,   {} },
+   };
+
+   // a group of conditions joined by "&" matches if all of its conditions match
+   using Filter = std::vector<std::vector<Condition const *>>;
+   auto InPathOrder = [](Node const & map, Filter const & filter)
+   {
+      bool anyMatch = false;
+      for (auto && group : filter)
+      {
+         bool match = true, required = false;
+         for (auto c : group)
+         {
+            auto ValueIsMatch = [&](Node const & value) { return c->op == EKVOp::Exists || YamlPathDetail::StrIsMatch(c->value, {}, value) == (c->op == EKVOp::Equal); };
+            bool condMatch = false;
+            if (c->key.starry || c->key.noCase)
+            {
+               for (auto && kv : map)
+                  if (YamlPathDetail::StrIsMatch(c->key, {}, kv.first) && ValueIsMatch(kv.second))
+                  {
+                     condMatch = true;
+                     break;
+                  }
+            }
+            else
+            {
+               Node el = map[std::string(c->key.token)];
+               if (!el && c->key.required)
+                  return false;
+               condMatch = el && ValueIsMatch(el);
+            }
+            match = match && condMatch;
+            required = required || c->key.required;
+         }
+         anyMatch = anyMatch || match;
+         if (required && !anyMatch)
+            return false;
+      }
+      return anyMatch;
+   };
+
+   PathContext indexed;
+   indexed.AddIndex(root, "a");
+   indexed.AddIndex(root, "b");
+
+   // all filters of up to three conditions, separated by "," or "&"
+   size_t const n = std::size(conditions);
+   std::string mismatch;
+   for (size_t i = 0; i < n * n * n + n * n + n && mismatch.empty(); ++i)
+   {
+      for (unsigned joins = 0; joins < 4 && mismatch.empty(); ++joins)
+      {
+         Filter filter(1);
+         std::string path = "{";
+         unsigned separator = 0;
+         for (size_t k = i; ; k = k / n - 1)
+         {
+            if (path.size() > 1)
+            {
+               bool join = (joins >> separator++) & 1;
+               if (!join)
+                  filter.emplace_back();
+               path += join ? "&" : ",";
+            }
+            filter.back().push_back(&conditions[k % n]);
+            path += conditions[k % n].text;
+            if (k < n)
+               break;
+         }
+         path += "}";
+         if (joins >> separator)
+            continue;      // same path as with fewer joins
+
+         std::string expected, selected, selectedStatic;
+         for (Node el : root)
+         {
+            expected += InPathOrder(el, filter) ? '1' : '0';
+            selected += SelectExists(el, path) ? '1' : '0';
+            selectedStatic += PathResolve(el, StaticPath(path.c_str(), path.length())) == EPathError::OK ? '1' : '0';
+         }
+         if (selected != expected || selectedStatic != expected || !(T(Select(root, path, {}, &indexed)) == T(Select(root, path))) ||
+             SelectCount(root, path) != size_t(std::count(expected.begin(), expected.end(), '1')) ||
+             SelectCount(root, path, {}, &indexed) != SelectCount(root, path))
+            mismatch = path;
+      }
+   }
+   CHECK(mismatch == "");
+
+   // "&" joins two conditions
+   CHECK(SelectCount(root, "{a=1&b=2}") == 3);
+   CHECK(SelectCount(root, "{a=1&b=2,c=4}") == 11);
+   CHECK(PathValidate("{a=1&b=2}") == EPathError::OK);
+   CHECK(PathValidate("{a=1&!b=}") == EPathError::OK);
+   for (auto path : { "{a&b=1}", "{a=1&}", "{a=1&b}", "{&a=1}", "{a=1&&b=2}", "{a=1,b&}" })
+      CHECK(PathValidate(path) == EPathError::InvalidToken);
+}
+
+
+TEST_CASE("PathResolve - recursive key")
+{
+   Node root = Load(R"(
+timeout : 1
+services :
+   db : { host : x, timeout : 2, pool : { timeout : 3 } }
+   web :
+      - { name : a, timeout : 4 }
+      - { name : b, retry : { timeout : 5, timeout2 : 6 } }
+      - [ { timeout : 7 } ]
+nested : { a : { a : { a : 8 } } }
+'quoted key' : { 'quoted key' : 9 }
+)");
+
+   auto Values = [](Node const & n)
+   {
+      std::vector<std::string> result;
+      for (auto && v : n)
+         result.push_back(v.IsScalar() ? v.Scalar() : "{}");
+      return result;
+   };
+   using Strings = std::vector<std::string>;
+
+   // values in document order, a map's value before the values nested in its children
+   CHECK(Values(Select(root, "..timeout")) == Strings{ "1", "2", "3", "4", "5", "7" });
+   CHECK(Values(Select(root, "**.timeout")) == Strings{ "1", "2", "3", "4", "5", "7" });
+   CHECK(Values(Select(root, "services..timeout")) == Strings{ "2", "3", "4", "5", "7" });
+   CHECK(Values(Select(root, "services.**.timeout")) == Strings{ "2", "3", "4", "5", "7" });
+   CHECK(Values(Select(root, "services.web..timeout")) == Strings{ "4", "5", "7" });
+   CHECK(Values(Select(root, "services.web[1]..timeout")) == Strings{ "5" });
+   CHECK(Values(Select(root, "nested..a")) == Strings{ "{}", "{}", "8" });
+   CHECK(Values(Select(root, "..'quoted key'")) == Strings{ "{}", "9" });
+   CHECK(Values(Select(root, "..%", { PathArg("host") })) == Strings{ "x" });
+
+   // the result is a fan-out, following selectors apply to each value
+   CHECK(Select(root, "..timeout[2]").as<int>() == 3);
+   CHECK(Values(Select(root, "..pool.timeout")) == Strings{ "3" });
+   CHECK(Values(Select(root, "services.web..name")) == Strings{ "a", "b" });
+   CHECK(Values(Select(root, "services.web{name=b}..timeout")) == Strings{ "5" });
+   CHECK(Values(Select(root, "..retry..timeout")) == Strings{ "5" });
+   CHECK(!Select(root, "..web{name}"));      // the result holds the sequence, which is not a map
+   CHECK(Values(Select(root, "..web[0]{name=b}.retry.timeout")) == Strings{ "5" });
+   CHECK(!Select(root, "..xyz"));
+   CHECK(!Select(root, "timeout..timeout"));
+   CHECK(SelectCount(root, "..timeout") == 6);
+   CHECK(SelectFirst(root, "services..timeout").as<int>() == 2);
+   CHECK(SelectExists(root, "..timeout2"));
+
+   // depth-first resolution gives the same result as Select, and a static path the same as a string
+   std::pair<char const *, bool> paths[] = {     // path, fans out
+      { "..timeout", true }, { "..timeout[2]", false }, { "services.web..timeout", true }, { "..a", true }, { "..a.a", true }, 
+      { "..retry..timeout", true }, { "..web[0]{name=a}", true }, { "..name[1]", false }, { "nested..a[2]", false } };
+   for (auto && [path, fanOut] : paths)
+   {
+      Node expected = Select(root, path);
+      std::vector<Node> nodes;
+      SelectInto(root, path, nodes);
+      if (fanOut)
+      {
+         Node seq(NodeType::Sequence);
+         for (auto && n : nodes)
+            seq.push_back(n);
+         CHECK(T(seq) == T(expected));
+      }
+      else
+      {
+         CHECK(nodes.size() == 1);
+         CHECK(T(nodes[0]) == T(expected));
+      }
+      CHECK(T(Select(root, StaticPath(path, strlen(path)))) == T(expected));
+   }
+   CHECK(SelectEach(root, "..xyz", [](Node const &) {}) == 0);
+
+   // syntax
+   for (auto path : { "..a", "**.a", "a..b", "a.**.b", "a[0]..b", "{x}..b", "..a..b", ".. 'a b'" })
+      CHECK(PathValidate(path) == EPathError::OK);
+   CHECK(PathValidate("..") == EPathError::UnexpectedEnd);
+   CHECK(PathValidate("a..") == EPathError::UnexpectedEnd);
+   CHECK(PathValidate("**") == EPathError::UnexpectedEnd);
+   CHECK(PathValidate("a...b") == EPathError::InvalidToken);
+   CHECK(PathValidate("..[0]") == EPathError::InvalidToken);
+   CHECK(PathValidate("*.a") == EPathError::InvalidToken);
+   CHECK(PathValidate("**a") == EPathError::InvalidToken);
+
+   // not supported by Ensure
+   Node copy = Clone(root);
+   CHECK_THROWS_AS(Ensure(copy, "..timeout"), PathException);
+}
+
+TEST_CASE("PathResolve - slice")
+{
+   Node root = Load(R"(
+items : [ a, b, c, d, e, f, g ]
+users :
+   - { name : Joe, tags : [ x, y, z ] }
+   - { name : Sina, tags : [ y ] }
+   - { name : Estragon }
+   - { name : Godot, tags : [ z, x ] }
+map : { a : 1 }
+scalar : s
+empty : []
+nothing : ~
+)");
+
+   auto Values = [](Node const & n)
+   {
+      std::string result;
+      for (auto && v : n)
+         result += (v.IsScalar() ? v.Scalar() : "{}") + ";";
+      return result;
+   };
+
+   // positions first to last, less if they don't exist
+   CHECK(Values(Select(root, "items[1-3]")) == "b;c;d;");
+   CHECK(Values(Select(root, "items[0-0]")) == "a;");
+   CHECK(Values(Select(root, "items[5-9]")) == "f;g;");
+   CHECK(Values(Select(root, "items[0-100,3]")) == "a;d;g;");
+   CHECK(Values(Select(root, "items[1-5,2]")) == "b;d;f;");
+   CHECK(Values(Select(root, "items[1-6,2]")) == "b;d;f;");
+   CHECK(!Select(root, "items[7-9]"));
+   CHECK(!Select(root, "empty[0-1]"));
+
+   // [!first-last]: all positions must exist
+   CHECK(Values(Select(root, "items[!4-6]")) == "e;f;g;");
+   CHECK(!Select(root, "items[!4-7]"));
+   CHECK(Values(Select(root, "items[!0-8,3]")) == "a;d;g;");   // the last position selected is 6
+   CHECK(!Select(root, "items[!0-9,3]"));
+
+   // a map or scalar acts as a one-element sequence, like for [0]
+   CHECK(Values(Select(root, "map[0-3]")) == "{};");
+   CHECK(Values(Select(root, "scalar[0-3]")) == "s;");
+   CHECK(!Select(root, "scalar[1-3]"));
+   CHECK(!Select(root, "scalar[!0-1]"));
+   Node node = root["nothing"];
+   PathArg path = "[0-1]";
+   CHECK(PathResolve(node, path) == EPathError::InvalidNodeType);
+
+   // the result is a fan-out: following selectors apply to each element, positions apply to the fan-out
+   CHECK(Values(Select(root, "users[1-2].name")) == "Sina;Estragon;");
+   CHECK(Values(Select(root, "users.name[1-2]")) == "Sina;Estragon;");
+   CHECK(Values(Select(root, "users.tags[1-5]")) == "{};{};");
+   CHECK(Values(Select(root, "users[0-3,2].tags")) == "{};");
+   CHECK(Values(Select(root, "users.name[!2-3]")) == "Estragon;Godot;");
+   CHECK(!Select(root, "users.name[!2-4]"));
+   CHECK(Select(root, "users[1-3][1]")["name"].as<std::string>() == "Estragon");
+   CHECK(Values(Select(root, "users[1-3][1-1].name")) == "Estragon;");
+   CHECK(Values(Select(root, "users[0-3].name[1-2]")) == "Sina;Estragon;");
+   CHECK(Values(Select(root, "users{tags=}.name[1-9]")) == "Sina;Godot;");
+   CHECK(Values(Select(root, "..tags[1-2]")) == "{};{};");
+   CHECK(Values(Select(root, "users[1-3]..name")) == "Sina;Estragon;Godot;");
+
+   // bound arguments
+   CHECK(Values(Select(root, "items[%-%]", { size_t(2), size_t(3) })) == "c;d;");
+   CHECK(Values(Select(root, "items[!%-%,%]", { size_t(0), size_t(4), size_t(2) })) == "a;c;e;");
+   CHECK(Values(Select(root, CompilePath("items[1-%]", { size_t(2) }))) == "b;c;");
+   PathException x;
+   node.reset(root);
+   path = "items[%-%]";
+   CHECK(PathResolve(node, path, { size_t(3), size_t(2) }, &x) == EPathError::InvalidIndex);
+   CHECK(x.BoundArg() == 0);
+   node.reset(root);
+   path = "items[0-3,%]";
+   CHECK(PathResolve(node, path, { size_t(0) }, &x) == EPathError::InvalidIndex);
+   CHECK_THROWS_AS(Select(root, "items[0-%]", { PathArg("x") }), PathException);
+
+   // depth-first and event-based resolution, and a static path, give the same result as Select
+   char const * paths[] = { "items[1-3]", "items[5-9]", "items[!4-6]", "items[!4-7]", "items[0-100,3]", "users[1-2].name", "users.name[1-2]",
+      "users.name[!2-3]", "users.name[!2-4]", "users[1-3][1]", "users[0-3].name[1-2]", "users{tags=}.name[1-9]", "users.tags[1-5]", "..tags[1-2]", 
+      "map[0-3]", "scalar[0-0]", "users[1-3]..name", "users.tags[0-1][1-1]", "users.tags[!0-1][!1-1]", "users[0-2][!0-2,2].name", "users[9-10]" };
+   std::string yaml = Dump(root);
+   for (char const * path : paths)
+   {
+      Node expected = Select(root, path);
+      Node each(NodeType::Sequence);
+      size_t count = SelectEach(root, path, [&](Node const & n) { each.push_back(n); });
+      std::istringstream input(yaml);
+      Node streamed(NodeType::Sequence);
+      CHECK(SelectStream(input, path, [&](Node const & n) { streamed.push_back(n); }) == count);
+      if (!expected)
+         CHECK(count == 0);
+      else if (!expected.IsSequence())
+      {
+         CHECK(count == 1);
+         CHECK(T(each[0]) == T(expected));
+         CHECK(T(streamed[0]) == T(expected));
+      }
+      else
+      {
+         CHECK(count == expected.size());
+         CHECK(T(each) == T(expected));
+         CHECK(T(streamed) == T(expected));
+      }
+      CHECK(T(Select(root, StaticPath(path, strlen(path)))) == T(expected));
+   }
+
+   // syntax
+   for (auto path : { "[1-2]", "[!1-2]", "[1-2,3]", "[!1-2,3]", "[ 1 - 2 , 3 ]", "a[0-0].b" })
+      CHECK(PathValidate(path) == EPathError::OK);
+   CHECK(PathValidate("[!1]") == EPathError::InvalidToken);
+   CHECK(PathValidate("[1-2-3]") == EPathError::InvalidToken);
+   CHECK(PathValidate("[1-]") == EPathError::InvalidIndex);
+   CHECK(PathValidate("[-1]") == EPathError::InvalidIndex);
+   CHECK(PathValidate("[2-1]") == EPathError::InvalidIndex);
+   CHECK(PathValidate("[1-2,0]") == EPathError::InvalidIndex);
+   CHECK(PathValidate("[1-2,]") == EPathError::InvalidIndex);
+   CHECK(PathValidate("[1-2") == EPathError::UnexpectedEnd);
+   CHECK(PathValidate("a-b") == EPathError::InvalidToken);
+}
+
+TEST_CASE("PathResolve - type predicates")
+{
+   Node root = Load(R"(
+items :
+   - { name : a, tags : [ x, y ], size : 1 }
+   - b
+   - [ 1, 2 ]
+   - { name : c, tags : t }
+   - ~
+   - d
+config : { name : n, list : [ 1 ], sub : { k : v }, flag : true }
+)");
+
+   // "!ismap", "!isseq", "!isscalar": the node itself has the type
+   CHECK(Select(root, "items!isseq").is(root["items"]));
+   CHECK(!Select(root, "items!ismap"));
+   CHECK(Select(root, "config!ismap").is(root["config"]));
+   CHECK(Select(root, "config.name!isscalar").as<std::string>() == "n");
+   CHECK(Select(root, "config.sub.!ismap.k").as<std::string>() == "v");
+   CHECK(!Select(root, "items[4]!isscalar"));
+   CHECK(!Select(root, "missing!ismap"));
+
+   // "[$ismap]" etc.: the elements of a sequence with the type. A map or scalar acts like a type check.
+   CHECK(T(Select(root, "items[$ismap]")) == T(Load("[ { name : a, tags : [ x, y ], size : 1 }, { name : c, tags : t } ]")));
+   CHECK(T(Select(root, "items[$isscalar]")) == T(Load("[ b, d ]")));
+   CHECK(T(Select(root, "items[$isseq]")) == T(Load("[ [ 1, 2 ] ]")));
+   CHECK(T(Select(root, "items[$ismap].name")) == T(Load("[ a, c ]")));
+   CHECK(Select(root, "items[$ismap][1].name").as<std::string>() == "c");
+   CHECK(Select(root, "config[$ismap]").is(root["config"]));
+   CHECK(!Select(root, "config[$isseq]"));
+
+   // after a fan-out, both filter the elements of the fan-out
+   CHECK(T(Select(root, "items.tags!isseq")) == T(Load("[ [ x, y ] ]")));
+   CHECK(T(Select(root, "items.tags[$isscalar]")) == T(Load("[ t ]")));
+
+   // "{$isscalar}": the keys of a map with a value of the type
+   CHECK(T(Select(root, "config{$isscalar}")) == T(Load("{ name : n, flag : true }")));
+   CHECK(T(Select(root, "config{$ismap,list}")) == T(Load("{ sub : { k : v }, list : [ 1 ] }")));
+   CHECK(T(Select(root, "items{name=a,$isseq}")) == T(Load("[ { tags : [ x, y ] } ]")));
+   CHECK(T(Select(root, "items[$ismap]{$isscalar}")) == T(Load("[ { name : a, size : 1 }, { name : c, tags : t } ]")));
+   CHECK(!Select(root, "config.sub{$isseq}"));
+
+   // Ensure cannot create nodes of a type
+   Node ensured;
+   CHECK_THROWS_AS(Ensure(ensured, "a!ismap"), PathException);
+   CHECK_THROWS_AS(Ensure(ensured, "a{$ismap}"), PathException);
+
+   // depth-first and event-based resolution, and a static path, give the same result as Select
+   char const * paths[] = { "items[$ismap]", "items[$isscalar]", "items[$isseq]", "items[$ismap].name", "items[$ismap][1].name", "items.tags!isseq", 
+      "items.tags[$isscalar]", "items[$isseq][0][1]", "config{$isscalar}", "items{name=a,$isseq}", "items[$ismap]{$isscalar}", "items[$ismap].tags[$isscalar]",
+      "config!ismap", "config.sub!ismap.k", "config[$isscalar]", "items[1-5][$isscalar]", "..tags!isscalar", "items!ismap" };
+   std::string yaml = Dump(root);
+   for (char const * path : paths)
+   {
+      Node expected = Select(root, path);
+      Node each(NodeType::Sequence);
+      size_t count = SelectEach(root, path, [&](Node const & n) { each.push_back(n); });
+      std::istringstream input(yaml);
+      Node streamed(NodeType::Sequence);
+      CHECK(SelectStream(input, path, [&](Node const & n) { streamed.push_back(n); }) == count);
+      if (!expected)
+         CHECK(count == 0);
+      else if (!expected.IsSequence())
+      {
+         CHECK(count == 1);
+         CHECK(T(each[0]) == T(expected));
+         CHECK(T(streamed[0]) == T(expected));
+      }
+      else
+      {
+         CHECK(count == expected.size());
+         CHECK(T(each) == T(expected));
+         CHECK(T(streamed) == T(expected));
+      }
+      CHECK(T(Select(root, StaticPath(path, strlen(path)))) == T(expected));
+   }
+
+   // syntax
+   for (auto path : { "!ismap", "a!isseq.b", "a.!isscalar", "[$ismap]", "[ $ isseq ]", "{$isscalar}", "{a=1,$ismap,b}", "a[$ismap]!ismap" })
+      CHECK(PathValidate(path) == EPathError::OK);
+   for (auto path : { "!isnull", "a!map", "!'ismap'", "[$]", "[$ismap,1]", "{$ismap=1}", "{a=1&$ismap}", "{$ismap&a=1}", "a$ismap" })
+      CHECK(PathValidate(path) == EPathError::InvalidToken);
+   CHECK(PathValidate("a!") == EPathError::UnexpectedEnd);
+   CHECK(PathValidate("[$ismap") == EPathError::UnexpectedEnd);
+}
+
+TEST_CASE("CompiledPath")
+{
+   char const * sroot =
+      R"(
+-  name : Joe
+   color: red
+   friends : ~
+-  name : Sina
+   color: blue
+-  name : Estragon
+   color : red
+   friends :
+      Wladimir : good
+      Godot : unreliable)";
+
+   auto root = YAML::Load(sroot);
+
+   // same results as the string based API
+   for (auto path : { "", "name", "[1].name", "name[2]", "{color=red}", "{color=blue}.name", "friends.Wladimir", "[1].color" })
+   {
+      auto cp = CompilePath(path);
+      CHECK(cp);
+      CHECK(cp.Path() == path);
+      CHECK(T(Select(root, cp)) == T(Select(root, path)));
+   }
+
+   {  // compiled path owns path and bound arguments
+      std::string key = "color";
+      std::string path = "[%].%";
+      auto cp = CompilePath(path, { size_t(1), PathArg(key) });
+      key = "xxxxx";
+      path = "xxxxx";
+      CHECK(cp.Path() == "[%].%");
+      CHECK(Select(root, cp).as<std::string>() == "blue");
+   }
+
+   {  // node errors
+      auto cp = CompilePath("[1].friends");
+      CHECK(cp);
+      CHECK(!Select(root, cp));
+      CHECK_THROWS_AS(Require(root, cp), PathException);
+
+      Node node = root;
+      PathException x;
+      CHECK(PathResolve(node, cp, &x) == EPathError::NodeNotFound);
+      CHECK(x.ResolvedPath() == "[1]");
+      CHECK(x.FullPath() == "[1].friends");
+      CHECK(node["name"].as<std::string>() == "Sina");
+   }
+
+   {  // malformed path: valid selectors are applied until the error is reached
+      auto cp = CompilePath("[1].~");
+      CHECK(!cp);
+      CHECK(cp.Error() == EPathError::InvalidToken);
+      CHECK(cp.Diagnostics().ErrorOffset() == PathException(cp.Diagnostics()).ErrorOffset());
+
+      Node node = root;
+      PathException x;
+      PathArg path = "[1].~";
+      CHECK(PathResolve(node, path, {}, &x) == EPathError::InvalidToken);
+      CHECK(path == ".~");
+
+      Node cnode = root;
+      PathException cx;
+      CHECK(PathResolve(cnode, cp, &cx) == EPathError::InvalidToken);
+      CHECK(cx.ErrorOffset() == x.ErrorOffset());
+      CHECK(cx.ResolvedPath() == x.ResolvedPath());
+      CHECK(cnode["name"].as<std::string>() == "Sina");
+
+      CHECK_THROWS_AS(Select(root, cp), PathException);
+      CHECK(!Select(root, CompilePath("[7].~")));      // node error comes first
+   }
+
+   {  // default constructed: empty path
+      CompiledPath cp;
+      CHECK(cp);
+      CHECK(Select(root, cp) == root);
+   }
+}
+
+
+TEST_CASE("StaticPath")
+{
+   constexpr StaticPath filter("servers{^Role*=prim*,!port,name}.hosts[1]");
+   static_assert(filter.Size() == 4);
+   static_assert(filter.Selector(1).selector == YamlPathDetail::ESelector::MapFilter);
+   static_assert(filter.Selector(1).kvCount == 3);
+   static_assert(filter.KV(0).key.noCase && filter.KV(0).key.starry && filter.KV(0).value.token == "prim");
+   static_assert(filter.KV(1).op == EKVOp::Select && filter.KV(1).key.required);
+   static_assert(filter.Selector(3).index == 1);
+   static_assert("a . 'b.c'"_ypath.Size() == 2);
+   static_assert(" "_ypath.Size() == 0);
+   CHECK(YamlPathDetail::StaticScanner::ValidTokensAtStart == YamlPathDetail::PathScanner::ValidTokensAtStart);
+
+   // same grammar as PathScanner: malformed paths throw if not validated during compilation
+   for (char const * path : { "", "a", "a.b", "a.[2]", "a[2]", "[2]", "'x y'.z", "{a=b,c~=d,e=,f}", "{^a*=*,!b}", 
+                              "~", "[2[", "[2222222222222222222222]", ".a.b", "].a.b", "a.", "a.%", "{a~=}", "{a", "'open", "[x]", "a[1]b",
+                              "..a", "a..b", "**.a", "a.**.'b'", "..", "a...b", "**a", "..[0]", "..%",
+                              "[1-2]", "[!1-2,3]", "[!1]", "[1-]", "[2-1]", "[1-2,0]", "[1-2,]", "[1-2", "a-b",
+                              "a!ismap", "[$isseq].b", "{$isscalar,a=1}", "!isnull", "[$ismap", "{a=1&$ismap}" })
+   {
+      EPathError err = EPathError::OK;
+      try { StaticPath(path, strlen(path)); }
+      catch (PathException const & x) { err = x.Error(); }
+      CHECK(err == PathValidate(path));
+   }
+
+   Node root = Load(R"(
+servers:
+   - { name: a, role: Primary, port: 1, hosts: [ h1, h2 ] }
+   - { name: b, role: secondary, hosts: [ h3, h4 ] }
+   - { name: c, role: primary, port: 3, hosts: [ h5 ] }
+)");
+   for (char const * path : { "servers", "servers[1].name", "servers.name", "servers.name[2]", "servers{role=primary}", "servers{^role=primary}.port", 
+                              "servers{^role*=PRIM*,!port,name}", "servers{role~=primary,name}", "servers{port=}.hosts[0]", "servers[7]", "servers.x", "servers.name.x" })
+   {
+      CHECK(T(Select(root, StaticPath(path, strlen(path)))) == T(Select(root, path)));
+   }
+
+   CHECK(Select(root, "servers{role=primary}.name[0]"_ypath).as<std::string>() == "c");
+   CHECK(Select(root, YAML_STATIC_PATH("servers[0].hosts[1]")).as<std::string>() == "h2");
+
+   std::string expected, thrown;
+   try { Require(root, "servers[1].port"); } catch (PathException const & x) { expected = x.What(); }
+   try { Require(root, "servers[1].port"_ypath); } catch (PathException const & x) { thrown = x.What(); }
+   CHECK(!thrown.empty());
+   CHECK(thrown == expected);
+
+   Node node = root;
+   PathException x;
+   CHECK(PathResolve(node, "servers[1].port"_ypath, &x) == EPathError::NodeNotFound);
+   CHECK(x.ResolvedPath() == "servers[1]");
+   CHECK(node["name"].as<std::string>() == "b");
+}
+
+TEST_CASE("SelectEach")
+{
+   char const * sroot =
+      R"(
+-  name : Joe
+   color: red
+-  name : Sina
+   color: blue
+-  name : Estragon
+   color : red
+   friends :
+      Wladimir : good
+      Godot : unreliable)";
+
+   auto root = YAML::Load(sroot);
+
+   auto Names = [&](auto const & path)
+   {
+      std::string result;
+      size_t count = SelectEach(root, path, [&](Node const & n) { result += n.as<std::string>("?") + ";"; });
+      CHECK(count == size_t(std::count(result.begin(), result.end(), ';')));
+      return result;
+   };
+
+   // fan-out: visits the elements of the sequence Select would return
+   CHECK(Names("name") == "Joe;Sina;Estragon;");
+   CHECK(Names("{color=red}.name") == "Joe;Estragon;");
+   CHECK(Names(CompilePath("{color=red}.name")) == "Joe;Estragon;");
+
+   // single node
+   CHECK(Names("[1].name") == "Sina;");
+   CHECK(Names("{color=red}.name[1]") == "Estragon;");
+   CHECK(Names("[2].friends.Godot") == "unreliable;");
+   CHECK(SelectEach(root, "", [](Node const & n) { CHECK(n.IsSequence()); }) == 1);
+
+   // no match: callback is not called
+   CHECK(Names("xyz") == "");
+   CHECK(Names("[7].name") == "");
+   CHECK(Names("{color=green}") == "");
+
+   // malformed path throws before any node is visited
+   size_t visited = 0;
+   CHECK_THROWS_AS(SelectEach(root, "name.~", [&](Node const &) { ++visited; }), PathException);
+   CHECK(visited == 0);
+
+   // early termination
+   std::string first;
+   CHECK(SelectEach(root, "{color=red}.name", [&](Node const & n) { first = n.as<std::string>(); return false; }) == 1);
+   CHECK(first == "Joe");
+   CHECK(SelectEach(root, "name", [&](Node const & n) { return n.as<std::string>() != "Sina"; }) == 2);
+   CHECK(SelectEach(root, "friends.Godot[0]", [](Node const &) { return false; }) == 1);
+
+   // depth-first resolution gives the same result as Select
+   std::pair<char const *, bool> paths[] = {     // path, fans out
+      { "name", true }, { "{color=red}.name", true }, { "friends", true }, { "friends.Godot", true }, { "{color=}.friends", true },
+      { "name[1]", false }, { "{color=red}[1].friends.Wladimir", false }, { "[2].friends", false }, { "", false } };
+   for (auto && [path, fanOut] : paths)
+   {
+      Node expected = Select(root, path);
+      std::vector<Node> nodes;
+      SelectInto(root, path, nodes);
+      if (fanOut)
+      {
+         Node seq(NodeType::Sequence);
+         for (auto && n : nodes)
+            seq.push_back(n);
+         CHECK(T(seq) == T(expected));
+      }
+      else
+      {
+         CHECK(nodes.size() == 1);
+         CHECK(T(nodes[0]) == T(expected));
+      }
+   }
+
+   // SelectInto
+   std::vector<Node> nodes;
+   CHECK(SelectInto(root, "color", nodes) == 3);
+   CHECK(SelectInto(root, CompilePath("[%].name", { size_t(2) }), nodes) == 1);
+   CHECK(nodes.size() == 4);
+   CHECK(nodes[1].as<std::string>() == "blue");
+   CHECK(nodes[3].as<std::string>() == "Estragon");
+
+   // document is not modified
+   CHECK(root.size() == 3);
+   CHECK(root[0].size() == 2);
+}
+
+TEST_CASE("SelectFirst, SelectExists, SelectCount")
+{
+   auto root = Load("[ { name : a, enabled : true }, { name : b }, { name : c, enabled : true }, xyz ]");
+
+   CHECK(SelectFirst(root, "{enabled=true}.name").as<std::string>() == "a");
+   CHECK(SelectFirst(root, "{enabled=true}[1].name").as<std::string>() == "c");
+   CHECK(SelectFirst(root, CompilePath("name")).as<std::string>() == "a");
+   CHECK(SelectFirst(root, "[3]").as<std::string>() == "xyz");
+   CHECK(!SelectFirst(root, "{enabled=false}"));
+   CHECK(!SelectFirst(root, "[4]"));
+
+   CHECK(SelectExists(root, "{enabled=true}"));
+   CHECK(SelectExists(root, "{name=b}.name"));
+   CHECK(SelectExists(root, CompilePath("[%]", { size_t(3) })));
+   CHECK(!SelectExists(root, "{name=b}.enabled"));
+   CHECK(!SelectExists(root, "xyz"));
+   CHECK(!SelectExists(root, "[4].~"));    // node error before the path error
+   CHECK_THROWS_AS(SelectExists(root, "name.~"), PathException);
+
+   CHECK(SelectCount(root, "name") == 3);
+   CHECK(SelectCount(root, "{enabled=true}") == 2);
+   CHECK(SelectCount(root, "{enabled=true}.name[1]") == 1);
+   CHECK(SelectCount(root, CompilePath("enabled")) == 2);
+   CHECK(SelectCount(root, "[0]") == 1);
+   CHECK(SelectCount(root, "") == 1);
+   CHECK(SelectCount(root, "{enabled=true}[2]") == 0);
+   CHECK(SelectCount(root, "[%].%", { size_t(1), PathArg("name") }) == 1);
+   CHECK_THROWS_AS(SelectCount(root, "[%]", { PathArg("name") }), PathException);
+}
+
+TEST_CASE("SelectMany")
+{
+   auto root = YAML::Load(R"(
+db : { host : localhost, port : 5432 }
+services :
+   - { name : web, enabled : true, port : 80 }
+   - { name : worker, enabled : false }
+   - { name : cron, enabled : true })");
+
+   // same results as Select, including shared prefixes, fan-out, empty and duplicate paths, and node errors
+   std::vector<PathArg> paths = { "db.host", "db.port", "db", "", "services.name", "services{enabled=true}.name", "services{enabled=true}.port",
+                                  "services{enabled=true}.name[1]", "services[1].name", "services.name[2]", "services[1-2].name", "services[!1-3].name", "db!ismap", "db{$isscalar}", "services[$ismap].name", "services[$isseq]", "db.host", "db.user", "xyz.abc", "db.host.x", "db.user[.]" };
+   auto results = SelectMany(root, paths.data(), paths.size());
+   REQUIRE(results.size() == paths.size());
+   for (size_t i = 0; i < paths.size(); ++i)
+   {
+      CHECK(T(results[i]) == T(Select(root, paths[i])));
+      CHECK(bool(results[i]) == bool(Select(root, paths[i])));
+   }
+
+   CHECK(results[0].as<std::string>() == "localhost");
+   CHECK(results[0].is(root["db"]["host"]));
+   CHECK(results[5].size() == 2);
+   CHECK(results[7].as<std::string>() == "cron");
+   CHECK(SelectMany(root, {}).empty());
+
+   // the first malformed path throws, like Select
+   CHECK_THROWS_AS(SelectMany(root, { "db.host", "db...port", "db.[x]" }), PathException);
+   try
+   {
+      SelectMany(root, { "db.host", "xyz.~", "db...port", "db.[x]" });
+      CHECK(false);
+   }
+   catch (PathException const & x)
+   {
+      CHECK(x.FullPath() == "db...port");
+   }
+   CHECK_THROWS_AS(SelectMany(root, { "db.%" }), PathException);    // no bound arguments
+}
+
+
+TEST_CASE("SelectStream")
+{
+   char const * yaml = R"(
+config :
+   name : server
+   ports : [ 80, 443 ]
+   limits : &limits { cpu : 2, memory : 4G }
+   &key aliased : value
+users :
+   - { name : Joe, color : red, tags : [ a, b ] }
+   - { name : Sina, color : blue, friends : ~ }
+   - [ nested, sequence ]
+   - plain
+   - { name : Estragon, color : red, friends : { Wladimir : good, Godot : unreliable }, limits : *limits }
+   - { name : Godot, color : green, ? [complex, key] : x, 'name' : duplicate }
+   - { *key : alias-key, color : red, name : Lucky }
+tail : [ { a : 1 }, { a : 2, b : [ { a : 3 } ] } ]
+)";
+   auto root = Load(yaml);
+
+   auto Visit = [](auto && select)
+   {
+      std::string result;
+      size_t count = select([&](Node const & n) { result += Dump(n) + "\n;"; });
+      CHECK(count == size_t(std::count(result.begin(), result.end(), ';')));
+      return result;
+   };
+
+   // same nodes as SelectEach on the loaded document
+   char const * paths[] = { "", "config", "config.name", "config.ports", "config.ports[1]", "config.ports[2]", "config.limits", "config.limits.cpu",
+      "config[0].name", "config[1]", "config.aliased", "config.xyz", "users", "users.name", "users[1]", "users[1].name", "users[7]", "users[3]",
+      "users{color=red}", "users{color=red}.name", "users{color=red}[1].name", "users{color=red,name}", "users{!friends=}.friends.Godot",
+      "users.name[2]", "users.limits", "users.limits.memory", "users.tags", "users.tags[1]", "users.aliased", "users[2][1]", "users{^COL*=R*}.name",
+      "tail.a", "tail.b", "tail.b.a", "tail{a=2}.b{a=3}", "tail.a[1]", "tail.a[5]", "users.friends{Godot}", "users{friends}", "config{name=server}.ports",
+      "..name", "users..name", "..a", "tail..a[1]", "tail.b..a", "..friends.Godot", "**.cpu", "..limits", "users{color=red}..name", "..xyz",
+      "users[1-3]", "users[0-9,2].name", "users[!5-6].name", "users[!5-7].name", "users.name[1-2]", "users.name[!3-4]", "config.ports[0-5]", "tail[0-1].b[0-0].a" };
+   for (char const * path : paths)
+   {
+      std::istringstream input(yaml);
+      std::string expected = Visit([&](auto && fn) { return SelectEach(root, path, fn); });
+      std::string actual = Visit([&](auto && fn) { return SelectStream(input, path, fn); });
+      CHECK(actual == expected);
+   }
+
+   // bound arguments and compiled paths
+   {
+      std::istringstream input(yaml);
+      CHECK(SelectStream(input, "users[%].%", [](Node const & n) { CHECK(n.as<std::string>() == "Estragon"); }, { size_t(4), PathArg("name") }) == 1);
+      std::istringstream input2(yaml);
+      auto cp = CompilePath("users{color=%}.name", { PathArg("red") });
+      std::vector<std::string> names;
+      CHECK(SelectStream(input2, cp, [&](Node const & n) { names.push_back(n.as<std::string>()); }) == 3);
+      CHECK(names == std::vector<std::string>{ "Joe", "Estragon", "Lucky" });
+   }
+
+   // early termination by the callback, and by a selector that cannot select anything else
+   {
+      std::istringstream input(yaml);
+      CHECK(SelectStream(input, "users.name", [](Node const &) { return false; }) == 1);
+      std::istringstream stopsEarly(std::string(yaml) + "broken : [ x");     // not read: nothing after config.name can be selected
+      CHECK(SelectStream(stopsEarly, "config.name", [](Node const & n) { CHECK(n.as<std::string>() == "server"); }) == 1);
+      std::istringstream fanOut(std::string(yaml) + "broken : [ x");
+      CHECK(SelectStream(fanOut, "users.name", [](Node const &) {}) == 5);
+      std::istringstream index(std::string(yaml) + "broken : [ x");
+      CHECK(SelectStream(index, "users.name[1]", [](Node const & n) { CHECK(n.as<std::string>() == "Sina"); }) == 1);
+      std::istringstream slice(std::string(yaml) + "broken : [ x");
+      CHECK(SelectStream(slice, "users[0-4,4].name", [](Node const &) {}) == 2);
+      std::istringstream readsAll(std::string(yaml) + "broken : [ x");
+      CHECK_THROWS_AS(SelectStream(readsAll, "xyz", [](Node const &) {}), ParserException);
+   }
+
+   // only the first document is read
+   {
+      std::istringstream input("a : 1\n---\na : 2\n");
+      CHECK(SelectStream(input, "a", [](Node const & n) { CHECK(n.as<int>() == 1); }) == 1);
+      std::istringstream empty("");
+      CHECK(SelectStream(empty, "a", [](Node const &) {}) == 0);
+   }
+
+   // malformed path throws before reading
+   {
+      std::istringstream input(yaml);
+      CHECK_THROWS_AS(SelectStream(input, "users.~", [](Node const &) {}), PathException);
+      CHECK(input.tellg() == 0);
+   }
+}
+
+TEST_CASE("Internal: DocumentEnd")
+{
+   auto Split = [](std::string_view yaml)
+   {
+      std::vector<std::string> docs;
+      for (size_t begin = 0; begin < yaml.size(); )
+      {
+         size_t end = YamlPathDetail::DocumentEnd(yaml, begin);
+         docs.emplace_back(yaml.substr(begin, end - begin));
+         begin = end;
+      }
+      return docs;
+   };
+
+   using Docs = std::vector<std::string>;
+   CHECK(Split("a : 1") == Docs{ "a : 1" });
+   CHECK(Split("a\n---\nb\n--- c\n---") == Docs{ "a\n", "---\nb\n", "--- c\n", "---" });
+   CHECK(Split("---\na\n...\n%YAML 1.2\n---\nb\n") == Docs{ "---\na\n...\n", "%YAML 1.2\n---\nb\n" });
+   CHECK(Split("# c\n\n---\na\n---\nb") == Docs{ "# c\n\n---\na\n", "---\nb" });
+   CHECK(Split("a\r\n---\r\nb\r\n...") == Docs{ "a\r\n", "---\r\nb\r\n..." });
+   CHECK(Split("a: |\n  ---\n  ...\nb: ---x\n----\n --- \n") == Docs{ "a: |\n  ---\n  ...\nb: ---x\n----\n --- \n" });    // not at the start of a line, or not a marker
+}
+
+TEST_CASE("SelectAll")
+{
+   std::string yaml = "%YAML 1.2\n---\n";
+   for (int i = 0; i < 200; ++i)
+   {
+      yaml += "{ id : " + std::to_string(i) + ", color : " + (i % 3 ? "red" : "blue") + ", tags : [ t" + std::to_string(i % 5) + " ] }\n";
+      yaml += i % 7 ? "---\n" : "...\n# comment\n--- \n";
+   }
+   yaml += "last : ~\n";
+   auto docs = LoadAll(yaml);
+   REQUIRE(docs.size() == 201);
+
+   PathContext parallel;
+   parallel.SetOptions({ 4, 1 });
+   PathContext const * contexts[] = { nullptr, &parallel };
+   for (char const * path : { "", "id", "{color=red}.id", "tags[0]", "last", "xyz" })
+   {
+      std::string expected;
+      for (size_t d = 0; d < docs.size(); ++d)
+         SelectEach(docs[d], path, [&](Node const & n) { expected += std::to_string(d) + ":" + Dump(n) + ";"; });
+
+      for (PathContext const * context : contexts)
+      {
+         std::string actual;
+         size_t count = SelectAll(yaml, CompilePath(path), [&](Node const & n, size_t document) { actual += std::to_string(document) + ":" + Dump(n) + ";"; }, context);
+         CHECK(actual == expected);
+         CHECK(count == size_t(std::count(actual.begin(), actual.end(), ';')));
+      }
+   }
+
+   // early termination, in document order
+   for (PathContext const * context : contexts)
+   {
+      std::vector<size_t> seen;
+      CHECK(SelectAll(yaml, CompilePath("{color=blue}.id"), [&](Node const & n, size_t document) { seen.push_back(document); return n.as<int>() < 9; }, context) == 4);
+      CHECK(seen == std::vector<size_t>{ 0, 3, 6, 9 });
+   }
+
+   // a malformed document throws after the documents before it are visited
+   for (PathContext const * context : contexts)
+   {
+      size_t visited = 0;
+      CHECK_THROWS_AS(SelectAll(yaml + "---\n[ x\n---\nid : 1\n", CompilePath("id"), [&](Node const &, size_t) { ++visited; }, context), ParserException);
+      CHECK(visited == 200);
+   }
+   CHECK_THROWS_AS(SelectAll(yaml, CompilePath("id.~"), [](Node const &, size_t) {}), PathException);
+   CHECK(SelectAll("", CompilePath("id"), [](Node const &, size_t) {}, &parallel) == 0);
+
+   // from a file
+   auto fileName = (std::filesystem::temp_directory_path() / "yaml-path-tests-select-all.yaml").string();
+   {
+      std::ofstream file(fileName, std::ios::binary);
+      file << yaml;
+   }
+   size_t sum = 0;
+   CHECK(SelectAllFromFile(fileName, CompilePath("id"), [&](Node const & n, size_t) { sum += n.as<size_t>(); }, &parallel) == 200);
+   CHECK(sum == 199 * 200 / 2);
+   std::filesystem::remove(fileName);
+   CHECK_THROWS_AS(SelectAllFromFile(fileName, CompilePath("id"), [](Node const &, size_t) {}), std::system_error);
+   {
+      std::ofstream empty(fileName, std::ios::binary);
+   }
+   CHECK(SelectAllFromFile(fileName, CompilePath("id"), [](Node const &, size_t) {}) == 0);
+   std::filesystem::remove(fileName);
+}
+
+TEST_CASE("PathIndex")
+{
+   auto root = Load(R"(
+users:
+   - { id : a, name : Joe, role : admin }
+   - { id : b, name : Sina }
+   - { id : c, name : Estragon, role : admin }
+   - xyz
+   - { id : b, name : Wladimir }
+   - { id : [ 1, 2 ], name : Godot }
+)");
+
+   PathContext context;
+   auto index = context.AddIndex(Select(root, "users"), "id");
+   CHECK(index.Key() == "id");
+   CHECK(index.Sequence().is(root["users"]));
+   CHECK(index.Find("b") == std::vector<size_t>{ 1, 4 });
+   CHECK(index.Find("x").empty());
+   CHECK(context.FindIndex(root["users"], "id") != nullptr);
+   CHECK(context.FindIndex(root["users"], "name") == nullptr);
+   CHECK(context.AddIndex(root["users"], "id").Find("a") == std::vector<size_t>{ 0 });
+
+   // same results as without index
+   for (auto path : { "users{id=b}", "users{id=b}.name", "users{id=%}", "users{id=a,role=admin}", "users{id=c}[0].name", 
+                      "users{id=x}", "users{id=b,name}", "users{ID~=A}", "users{role=admin}", "users{id=}",
+                      "users{!id=b,name=Sina}", "users{!id=a,role=admin,name}", "users{!id=b,!name=Joe}", "users{!id=%,role}", "users{!id=b,!role}",
+                      "users{id=a,id=b}", "users{id=b,id=c,id=x}", "users{id=b&name=Sina}", "users{id=c,id=b&name=Wladimir}",
+                      "users{id=x&name=Joe,id=a}", "users{name=Joe&id=a,role=admin}" })
+   {
+      CHECK(T(Select(root, path, { PathArg("c") }, &context)) == T(Select(root, path, { PathArg("c") })));
+      CHECK(SelectCount(root, path, { PathArg("c") }, &context) == SelectCount(root, path, { PathArg("c") }));
+   }
+
+   // the hits of several indexes are intersected and combined, in sequence order
+   context.AddIndex(root["users"], "name");
+   CHECK(SelectCount(root, "users{id=b&name=Wladimir,name=Joe,id=c}", {}, &context) == 3);
+   CHECK(T(Select(root, "users{name=Wladimir,id=c&role=admin,name=Joe}.name", {}, &context)) == T(Load("[ Joe, Estragon, Wladimir ]")));
+   CHECK(!Select(root, "users{id=a&name=Sina}", {}, &context));
+
+   // the index is used: changes through yaml-cpp are not detected
+   Node sina = root["users"][1];
+   sina["id"] = "s";
+   CHECK(!Select(root, "users{id=s}", {}, &context));
+   CHECK(!Select(root, "users{!id=s,name=Sina}", {}, &context));
+   CHECK(SelectCount(root, "users{id=s&name=Sina,id=a}", {}, &context) == 1);
+   CHECK(SelectCount(root, "users{id=s&name=Sina,id=a}") == 2);
+   CHECK(SelectFirst(root, "users{id=s}.name").as<std::string>() == "Sina");
+   CHECK(SelectCount(root, "users{id=b}", {}, &context) == 1);      // the candidate is checked
+
+   // modifying another document does not rebuild the index
+   Node other;
+   Ensure(other, "users[0].id");
+   CHECK(!Select(root, "users{id=s}", {}, &context));
+
+   index.Rebuild();
+   CHECK(SelectFirst(root, "users{id=s}.name", {}, &context).as<std::string>() == "Sina");
+
+   // modification through Ensure rebuilds the index when it is used next
+   Ensure(root, "users[6].id");
+   root["users"][6]["id"] = "g";
+   CHECK(SelectCount(root, "users{id=g}", {}, &context) == 1);
+   CHECK(index.Find("g") == std::vector<size_t>{ 6 });
+
+   // also when Ensure starts below the sequence
+   Node last = root["users"][6];
+   Assign(last, "id", "h");
+   CHECK(SelectCount(root, "users{id=h}", {}, &context) == 1);
+   CHECK(index.Find("g").empty());
+}
+
+TEST_CASE("DocumentIndex")
+{
+   std::string yaml = "settings : { timeout : 1, log : { level : debug } }\nservices :\n";
+   for (int i = 0; i < 50; ++i)
+      yaml += "   - { name : s" + std::to_string(i) + ", timeout : " + std::to_string(i) + ", log : { level : " + (i % 2 ? "info" : "warn") + " }, ports : [ { port : " + std::to_string(i) + " } ] }\n";
+   auto root = Load(yaml);
+
+   PathContext context;
+   auto index = context.AddDocumentIndex(root);
+   CHECK(index.Root().is(root));
+   CHECK(index.Find("timeout").size() == 51);
+   CHECK(index.Find("level")[1].as<std::string>() == "warn");
+   CHECK(index.Find("xyz").empty());
+   CHECK(context.FindDocumentIndex(root) != nullptr);
+   CHECK(context.FindDocumentIndex(root["settings"]) == nullptr);
+   CHECK(context.AddDocumentIndex(root).Find("port").size() == 50);
+
+   // same results as without index, also below the root, and when built in parallel
+   PathContext parallel;
+   parallel.AddDocumentIndex(root, 4);
+   for (auto path : { "..timeout", "..timeout[7]", "..log.level", "services..port", "services[3]..port", "services{name=s5}..level", 
+                      "settings..level", "..ports..port", "..xyz", "services.ports..port", "..%", "services[2].ports..port" })
+   {
+      CHECK(T(Select(root, path, { PathArg("name") }, &context)) == T(Select(root, path, { PathArg("name") })));
+      CHECK(T(Select(root, path, { PathArg("name") }, &parallel)) == T(Select(root, path, { PathArg("name") })));
+      CHECK(SelectCount(root, path, { PathArg("name") }, &context) == SelectCount(root, path, { PathArg("name") }));
+   }
+   CHECK(T(Node(parallel.FindDocumentIndex(root)->Find("level"))) == T(Node(index.Find("level"))));
+
+   // nodes of another document are walked
+   Node other = Load("{ a : { timeout : x } }");
+   CHECK(Select(other, "..timeout", {}, &context)[0].as<std::string>() == "x");
+
+   // the index is used: changes through yaml-cpp are not detected
+   root["settings"]["log"]["timeout"] = 99;
+   CHECK(SelectCount(root, "..timeout", {}, &context) == 51);
+   CHECK(SelectCount(root, "..timeout") == 52);
+   Node unrelated;
+   Ensure(unrelated, "a.timeout");     // modifying another document does not rebuild the index
+   CHECK(SelectCount(root, "..timeout", {}, &context) == 51);
+   index.Rebuild();
+   CHECK(SelectCount(root, "..timeout", {}, &context) == 52);
+
+   // modification through Ensure rebuilds the index when it is used next
+   Ensure(root, "extra.timeout");
+   CHECK(SelectCount(root, "..timeout", {}, &context) == 53);
+   context.Clear();
+   CHECK(context.FindDocumentIndex(root) == nullptr);
+}
+
+TEST_CASE("SelectCache")
+{
+   auto root = Load(R"(
+limits:
+   - { name : cpu, value : 2 }
+   - { name : memory, value : 4G }
+   - { name : cpu, value : 3 }
+owner : Joe
+)");
+
+   SelectCache cache(root, 4);
+   CHECK(cache.Root().is(root));
+   CHECK(cache.Stats().capacity == 4);
+
+   // same results as Select, repeated calls are hits
+   for (int pass = 0; pass < 2; ++pass)
+   {
+      for (auto path : { "owner", "limits{name=%}.value", "limits.name", "xyz" })
+         CHECK(T(cache.Select(path, { PathArg("cpu") })) == T(Select(root, path, { PathArg("cpu") })));
+   }
+   auto stats = cache.Stats();
+   CHECK(stats.misses == 4);
+   CHECK(stats.hits == 4);
+   CHECK(stats.HitRatio() == 0.5);
+   CHECK(stats.size == 4);
+   CHECK(stats.memory > 0);
+   CHECK(!cache.Select("xyz", { PathArg("cpu") }));      // a failed selection is cached, too
+   CHECK(!cache.Select("limits.name").is(cache.Select("limits.name")));
+   CHECK(cache.Select("limits").is(root["limits"]));
+
+   // a result sequence is a copy, its elements are the document nodes
+   Node names = cache.Select("limits.name");
+   names.push_back("junk");
+   CHECK(T(cache.Select("limits.name")) == T(Load("[ cpu, memory, cpu ]")));
+   CHECK(cache.Select("limits.name")[0].is(root["limits"][0]["name"]));
+
+   // bound arguments are part of the key, a compiled path shares the entry of the string path
+   CHECK(cache.Select("limits{name=%}[0].value", { PathArg("memory") }).as<std::string>() == "4G");
+   auto hits = cache.Stats().hits;
+   CHECK(cache.Select(CompilePath("limits{name=%}[0].value", { PathArg("memory") })).as<std::string>() == "4G");
+   CHECK(cache.Stats().hits == hits + 1);
+   CHECK(T(cache.Select(CompiledPath())) == T(root));
+
+   // LRU eviction
+   CHECK(cache.Stats().size == 4);
+   CHECK(cache.Stats().evictions > 0);
+   cache.SetCapacity(1);
+   CHECK(cache.Stats().size == 1);
+   hits = cache.Stats().hits;
+   cache.Select("owner");
+   cache.Select("limits[0]");
+   cache.Select("limits[0]");
+   cache.Select("owner");
+   CHECK(cache.Stats().hits == hits + 1);
+
+   // a malformed path throws on every call
+   CHECK_THROWS_AS(cache.Select("limits.~"), PathException);
+   CHECK_THROWS_AS(cache.Select("limits.~"), PathException);
+
+   // modifications through Ensure discard the results, others need Invalidate
+   cache.SetCapacity(16);
+   CHECK(cache.Select("limits.name").size() == 3);
+   root["limits"].push_back(Load("{ name : disk, value : 1T }"));
+   CHECK(cache.Select("limits.name").size() == 3);
+   cache.Invalidate();
+   CHECK(cache.Stats().size == 0);
+   CHECK(cache.Stats().memory == 0);
+   CHECK(cache.Select("limits.name").size() == 4);
+   CHECK(!cache.Select("team"));
+   auto invalidations = cache.Stats().invalidations;
+   Ensure(root, "team");
+   root["team"] = "Core";
+   CHECK(cache.Select("team").as<std::string>() == "Core");
+   CHECK(cache.Stats().invalidations == invalidations + 1);
+
+   // modifying another document keeps the results
+   Node other = Load("{ a : 1 }");
+   Ensure(other, "q");
+   CHECK(cache.Select("team").as<std::string>() == "Core");
+   CHECK(cache.Stats().invalidations == invalidations + 1);
+
+   // as does an Ensure that adds nothing, or fails before adding anything, and Create
+   Ensure(root, "limits[1].value");
+   Ensure(root, "limits[0]{name}");
+   CHECK_THROWS_AS(Ensure(root, "limits.~"), PathException);
+   CHECK_THROWS_AS(Ensure(root, "owner.name"), PathException);
+   Create("limits[0].unit");
+   CHECK(!cache.Select("limits[0].unit"));
+   CHECK(cache.Stats().invalidations == invalidations + 1);
+   Ensure(root, "limits[0].unit");
+   CHECK(cache.Select("limits[0].unit").IsNull());
+   CHECK(cache.Stats().invalidations == invalidations + 2);
+
+   // shared between threads
+   {
+      SelectCache shared(root, 2);
+      std::vector<std::thread> threads;
+      std::atomic<size_t> found = 0;
+      for (int t = 0; t < 4; ++t)
+         threads.emplace_back([&] { for (int i = 0; i < 200; ++i) found += bool(shared.Select(i % 3 ? "limits{name=cpu}" : "owner")); });
+      for (auto && t : threads)
+         t.join();
+      CHECK(found == 800);
+      CHECK(shared.Stats().hits + shared.Stats().misses == 800);
+   }
+
+   // capacity 0: no caching
+   SelectCache off(root, 0);
+   CHECK(off.Select("owner").as<std::string>() == "Joe");
+   CHECK(off.Stats().misses == 0);
+   CHECK(off.Stats().size == 0);
+}
+
+TEST_CASE("PathTracer, PathStats")
+{
+   auto root = Load(R"(
+users:
+   - { id : 1, name : Joe, tags : [ a ] }
+   - { id : 2, name : Sina }
+   - { id : 3, Name : Estragon }
+)");
+
+   struct Recorder : PathTracer
+   {
+      std::vector<PathSelectorTrace> selectors;
+      std::vector<PathTrace> paths;
+      std::vector<std::string> pathTexts;
+      void OnSelector(PathArg, PathSelectorTrace const & trace) override { selectors.push_back(trace); }
+      void OnPath(PathTrace const & trace) override { paths.push_back(trace); pathTexts.emplace_back(trace.path); }
+      void Clear() { selectors.clear(); paths.clear(); pathTexts.clear(); }
+   } recorder;
+
+   PathContext context;
+   context.SetTracer(&recorder);
+   CHECK(context.Tracer() == &recorder);
+
+   // each selector, then the path
+   CHECK(T(Select(root, "users{!id=%}.name", { PathArg("2") }, &context)) == T(Select(root, "users{!id=2}.name")));
+   REQUIRE(recorder.selectors.size() == 3);
+   CHECK(std::string(PathSelectorName(recorder.selectors[0].selector)) == "key");
+   CHECK(std::string(PathSelectorName(recorder.selectors[1].selector)) == "map filter");
+   CHECK(recorder.selectors[1].position == 1);
+   CHECK(recorder.selectors[1].input == 1);
+   CHECK(recorder.selectors[1].output == 1);
+   CHECK(recorder.selectors[1].keysScanned == 3);        // one lookup of the required key per map
+   REQUIRE(recorder.paths.size() == 1);
+   CHECK(recorder.pathTexts[0] == "users{!id=%}.name");
+   CHECK(recorder.paths[0].error == EPathError::OK);
+   CHECK(recorder.paths[0].selectors == 3);
+   CHECK(recorder.paths[0].output == 1);
+   CHECK(recorder.paths[0].keysScanned == 3);
+   CHECK(recorder.paths[0].nanoseconds >= recorder.selectors[1].nanoseconds);
+
+   recorder.Clear();
+   CHECK(SelectCount(root, "users{^name=^JOE}", {}, &context) == 1);
+   CHECK(Select(root, "users{^name=^JOE}", {}, &context).size() == 1);
+   REQUIRE(recorder.paths.size() == 2);
+   CHECK(recorder.paths[0].selectors == 0);             // SelectEach reports the path only
+   CHECK(recorder.paths[0].output == 1);
+   CHECK(recorder.paths[1].keysScanned == 6);           // each map scans its keys up to "name" / "Name"
+   CHECK(recorder.selectors.size() == 2);
+
+   // a selector not matching
+   recorder.Clear();
+   CHECK(!Select(root, "users[7].name", {}, &context));
+   REQUIRE(recorder.selectors.size() == 2);
+   CHECK(recorder.selectors[1].input == 1);
+   CHECK(recorder.selectors[1].output == 0);
+   CHECK(recorder.paths.back().error == EPathError::NodeNotFound);
+   CHECK(recorder.paths.back().output == 0);
+
+   // static paths, and parallel filters count the same keys
+   recorder.Clear();
+   CHECK(Select(root, "users{id=3}[0].Name"_ypath, &context).as<std::string>() == "Estragon");
+   CHECK(recorder.pathTexts == std::vector<std::string>{ "users{id=3}[0].Name" });
+   CHECK(recorder.selectors.size() == 4);
+   uint64_t keys = recorder.paths[0].keysScanned;
+   context.SetOptions({ 4, 2 });
+   Select(root, "users{id=3}[0].Name", {}, &context);
+   CHECK(recorder.paths.back().keysScanned == keys);
+   context.SetOptions({});
+
+   // statistics by path
+   PathStats stats;
+   context.SetTracer(&stats);
+   for (auto id : { "1", "2", "3" })
+      Select(root, "users{id=%}.name", { PathArg(id) }, &context);
+   Select(root, "users.tags", {}, &context);
+   SelectCount(root, "xyz", {}, &context);
+
+   auto slowest = stats.Slowest(10);
+   REQUIRE(slowest.size() == 3);
+   CHECK(slowest[0].nanoseconds >= slowest[1].nanoseconds);
+   CHECK(slowest[1].nanoseconds >= slowest[2].nanoseconds);
+   CHECK(stats.Slowest(1).size() == 1);
+   auto byId = std::find_if(slowest.begin(), slowest.end(), [](PathStatsEntry const & e) { return e.path == "users{id=%}.name"; });
+   REQUIRE(byId != slowest.end());
+   CHECK(byId->calls == 3);
+   CHECK(byId->errors == 1);                             // the third user has no "name"
+   CHECK(byId->output == 2);
+   CHECK(byId->maxNanoseconds * 3 >= byId->nanoseconds);
+   REQUIRE(byId->selectors.size() == 3);
+   CHECK(byId->selectors[1].input == 3);
+   CHECK(byId->selectors[1].output == 3);
+   CHECK(byId->selectors[2].output == 2);
+
+   std::ostringstream dump;
+   stats.Dump(dump, 2);
+   std::string text = dump.str();
+   CHECK(text.find(slowest[0].path) != std::string::npos);
+   CHECK(text.find(slowest[2].path) == std::string::npos);
+   CHECK(size_t(std::count(text.begin(), text.end(), '\n')) == 1 + 2 + slowest[0].selectors.size() + slowest[1].selectors.size());
+
+   // shared between threads
+   stats.Clear();
+   CHECK(stats.Slowest(10).empty());
+   std::vector<std::thread> threads;
+   for (int t = 0; t < 4; ++t)
+      threads.emplace_back([&] { for (int i = 0; i < 100; ++i) Select(root, "users.name", {}, &context); });
+   for (auto && t : threads)
+      t.join();
+   CHECK(stats.Slowest(1).at(0).calls == 400);
+}
+
+TEST_CASE("SelectOptions - parallel fan-out")
+{
+   std::string yaml;
+   char const * colors[] = { "red", "green", "blue" };
+   for (int i = 0; i < 1000; ++i)
+      yaml += "- { name: n" + std::to_string(i) + ", color: " + colors[i % 3] + (i % 7 ? "" : ", tag: x") + " }\n";
+   yaml += "- just a scalar\n";
+   auto root = YAML::Load(yaml);
+
+   PathContext serial;
+   PathContext parallel;
+   parallel.SetOptions({ 4, 10 });
+   PathContext allThreads;
+   allThreads.SetOptions({ 0, 2 });
+
+   for (auto path : { "name", "tag", "{color=red}", "{color=red}.name", "{^COL*=blue,name}", "{tag=,color~=red}.name", "name[7]", "{color=red}[3]", "{nomatch=1}", "xyz", "tag.xyz" })
+   {
+      auto expected = Select(root, path, {}, &serial);
+      CHECK(T(Select(root, path, {}, &parallel)) == T(expected));
+      CHECK(T(Select(root, path, {}, &allThreads)) == T(expected));
+   }
+
+   auto names = Select(root, "{color=green}.name", {}, &parallel);
+   REQUIRE(names.size() == 333);
+   CHECK(names[0].as<std::string>() == "n1");
+   CHECK(names[332].as<std::string>() == "n997");
+
+   CHECK_THROWS_AS(Select(root, "{color=red}.~", {}, &parallel), PathException);
+}
+
+
+TEST_CASE("Concurrent Select on a shared document")
+{
+   std::string yaml = "config: { db: { host: localhost, port: 5432 } }\nitems:\n";
+   for (int i = 0; i < 200; ++i)
+      yaml += "- { id: " + std::to_string(i) + ", name: n" + std::to_string(i) + ", Color: " + (i % 2 ? "red" : "blue") + " }\n";
+   auto root = YAML::Load(yaml);
+
+   PathContext context;
+   context.AddIndex(root["items"], "id");
+   context.SetOptions({ 2, 50 });
+
+   char const * paths[] = { "config.db.host", "items.name", "items{Color=red}.name", "items{Color=blue,id,name}", "items{^color*=RED}[3]", "items{id=42}.name", "items[7].xyz", "items.name[150]" };
+   auto Str = [](Node const & n) { return n ? YAML::Dump(n) : std::string("(undefined)"); };
+   std::vector<std::string> expected;
+   for (auto path : paths)
+      expected.push_back(Str(Select(root, path)));
+
+   std::atomic<size_t> mismatches = 0;
+   std::vector<std::thread> threads;
+   for (int t = 0; t < 8; ++t)
+   {
+      threads.emplace_back([&, t]
+      {
+         for (int rep = 0; rep < 20; ++rep)
+         {
+            for (size_t i = 0; i < std::size(paths); ++i)
+            {
+               if (Str(Select(root, paths[i], {}, t % 2 ? &context : nullptr)) != expected[i])
+                  ++mismatches;
+            }
+            if (SelectCount(root, "items{Color=red}") != 100 || Str(SelectMany(root, { "config.db.port", "items.name[150]" })[1]) != expected.back())
+               ++mismatches;
+         }
+      });
+   }
+   for (auto && thread : threads)
+      thread.join();
+   CHECK(mismatches == 0);
+   CHECK(root["items"].size() == 200);
+}
+
+TEST_CASE("PathArena")
+{
+   using namespace YamlPathDetail;
+
+   PathArena arena;
+   CHECK(arena.Capacity() == 0);
+   {
+      ScratchScope outer(nullptr);
+      CHECK(Scratch() != std::pmr::new_delete_resource());
+   }
+   CHECK(Scratch() == std::pmr::new_delete_resource());
+
+   // scratch memory is reused when the scope ends, also for nested scopes
+   PathContext context;
+   context.SetArena(&arena);
+   {
+      ScratchScope outer(&context);
+      CHECK(Scratch() == &arena);
+      void * p = Scratch()->allocate(96, 8);
+      CHECK(arena.Used() == 96);
+      {
+         ScratchScope inner(&context);
+         void * q = Scratch()->allocate(10000, 64);
+         CHECK(reinterpret_cast<std::uintptr_t>(q) % 64 == 0);
+         CHECK(arena.Used() > 10096);
+      }
+      CHECK(arena.Used() == 96);
+      CHECK(Scratch()->allocate(8, 8) == static_cast<char *>(p) + 96);
+
+      size_t capacity = arena.Capacity();
+      void * large = Scratch()->allocate(PathArena::LargeAllocation + 1, 8);    // from the heap
+      CHECK(arena.Capacity() == capacity);
+      Scratch()->deallocate(large, PathArena::LargeAllocation + 1, 8);
+   }
+   CHECK(arena.Used() == 0);
+   size_t capacity = arena.Capacity();
+   CHECK(capacity > 10096);
+
+   // resolving paths with the arena of a context gives the same results, and releases the memory when done
+   auto root = Load("{ items : [ { name : a, color : red }, { name : b, color : blue }, { name : c, color : red } ] }");
+   for (auto path : { "items.name", "items{color=red}.name", "items.name[2]" })
+      CHECK(T(Select(root, path, {}, &context)) == T(Select(root, path)));
+   CHECK(T(Select(root, "items{color=%}.name", { PathArg("red") }, &context)) == T(Select(root, "items{color=red}.name")));
+   CHECK(SelectFirst(root, "items{color=%}.name", { PathArg("blue") }, &context).as<std::string>() == "b");
+
+   size_t count = 0;
+   SelectEach(root, "items{color=red}", [&](Node const & item) 
+   { 
+      count += Select(item, "name", {}, &context).as<std::string>().size();
+   }, {}, &context);
+   CHECK(count == 2);
+   CHECK(arena.Used() == 0);
+   CHECK(arena.Capacity() == capacity);
+
+   arena.Trim();
+   CHECK(arena.Capacity() == 0);
+   CHECK(Select(root, "items.name[1]", {}, &context).as<std::string>() == "b");
+
+   // the thread arena releases the blocks of a large call when the outermost scope ends
+   std::thread([]
+   {
+      {
+         ScratchScope outer(nullptr);
+         for (int i = 0; i < 4; ++i)
+            (void)Scratch()->allocate(PathArena::LargeAllocation / 2, 8);
+         {
+            ScratchScope inner(nullptr);
+         }
+         CHECK(ThreadArena().Capacity() > 2 * ThreadArenaRetained);
+      }
+      CHECK(ThreadArena().Capacity() <= ThreadArenaRetained);
+      CHECK(ThreadArena().Used() == 0);
+   }).join();
+}
+
+
+TEST_CASE("PathCache")
+{
+   auto root = YAML::Load("[ { name : Joe, color : red }, { name : Sina, color : blue } ]");
+
+   PathCacheClear();
+   CHECK(Select(root, "[%].name", { size_t(0) }).as<std::string>() == "Joe");
+   CHECK(Select(root, "[%].name", { size_t(1) }).as<std::string>() == "Sina");     // same template, different argument
+   CHECK(Select(root, "{color=%}.name", { "blue" })[0].as<std::string>() == "Sina");
+   CHECK(Select(root, "{%=%}.%", { "color", "red", "name" })[0].as<std::string>() == "Joe");
+
+   auto stats = PathCacheGetStats();
+   CHECK(stats.misses == 3);
+   CHECK(stats.hits == 1);
+   CHECK(stats.size == 3);
+
+   // argument errors are reported like without cache
+   auto Diags = [&](PathArg path, PathBoundArgs args)
+   {
+      Node node = root;
+      PathException x;
+      auto err = PathResolve(node, path, args, &x);
+      return std::make_tuple(err, x.ErrorOffset(), x.ResolvedPath(), x.BoundArg(), std::string(path));
+   };
+
+   for (int pass = 0; pass < 2; ++pass)
+   {
+      auto expect = [&](PathArg path, PathBoundArgs args, EPathError error)
+      {
+         PathCacheSetCapacity(0);
+         auto uncached = Diags(path, args);
+         PathCacheSetCapacity(100);
+         auto cached = Diags(path, args);
+         CHECK(std::get<0>(uncached) == error);
+         CHECK(cached == uncached);
+      };
+
+      expect("[%].name", { "x" }, EPathError::InvalidIndex);
+      expect("[1].%", { size_t(1) }, EPathError::InvalidToken);
+      expect("{color=%}", { size_t(1) }, EPathError::InvalidToken);
+      expect("[1].%", {}, EPathError::MissingArg);
+      expect("[7].%", {}, EPathError::NodeNotFound);
+   }
+
+   PathCacheSetCapacity(0);
+   CHECK(PathCacheGetStats().size == 0);
+   CHECK(Select(root, "[1].name").as<std::string>() == "Sina");
+   CHECK(PathCacheGetStats().size == 0);
+
+   PathCacheSetCapacity(1024);    // default
+   PathCacheClear();
+}
+
+
 TEST_CASE("Accumulate (simple, tests AccumulateRefOp)")
 {
    {
@@ -638,12 +2249,133 @@ TEST_CASE("Accumulate with custom op")
    CHECK(result == 120);
 }
 
+TEST_CASE("SelectAccumulate")
+{
+   auto n = Load("{ items : [ { price : 2 }, { price : 3, tax : 1 }, { name : x }, { price : 5, tax : 2 } ], total : [ 7, 8 ] }");
+
+   CHECK(SelectAccumulate<int>(n, "items.price") == 10);
+   CHECK(SelectAccumulate<int>(n, "items.price", 1) == 11);
+   CHECK(SelectAccumulate<int>(n, "items.price", 1, [](int a, int b) { return a * b; }) == 30);
+   CHECK(SelectAccumulate<int>(n, "items.%", 0, { PathArg("tax") }) == 3);
+   CHECK(SelectAccumulate<int>(n, CompilePath("items{tax=}.price")) == 8);
+   CHECK(SelectAccumulate<int>(n, "total") == Accumulate<int>(Select(n, "total")));    // single node result: same as Accumulate
+   CHECK(SelectAccumulate<int>(n, "items.xyz", 42) == 42);
+   CHECK_THROWS_AS(SelectAccumulate<int>(n, "items.~"), PathException);
+}
+
+namespace
+{
+   // the fast number conversion of Accumulate gives the same value as yaml-cpp, or throws the same way
+   template <typename TValue>
+   bool SameAsYamlCpp(Node const & n)
+   {
+      bool yamlThrows = false, fastThrows = false;
+      TValue expected{}, actual{};
+      try { expected = n.as<TValue>(); } catch (BadConversion const &) { yamlThrows = true; }
+      try { actual = YamlPathDetail::ValueAs<TValue>(n); } catch (BadConversion const &) { fastThrows = true; }
+      if (yamlThrows || fastThrows)
+         return yamlThrows == fastThrows;
+      if constexpr (std::is_floating_point_v<TValue>)
+         if (expected != expected)
+            return actual != actual;      // NaN
+      return expected == actual;
+   }
+}
+
+TEST_CASE("Accumulate numbers")
+{
+   char const * scalars[] = { "0", "-0", "7", "-7", "42", "010", "-010", "0x1F", "+5", " 5", "5 ", "1.5", "-1.5", ".5", "-.5", "1.", "1e3", "1E-3", "-2.5e+2",
+                              "inf", "nan", ".inf", "-.inf", ".nan", ".NaN", "1e400", "abc", "", "-", ".", "5x", "127", "128", "-129", "255", "256", "65536",
+                              "2147483647", "2147483648", "-2147483648", "-2147483649", "9223372036854775807", "9223372036854775808", "18446744073709551616", "true" };
+   for (char const * text : scalars)
+   {
+      Node n(text);
+      CHECK(SameAsYamlCpp<int>(n));
+      CHECK(SameAsYamlCpp<short>(n));
+      CHECK(SameAsYamlCpp<unsigned>(n));
+      CHECK(SameAsYamlCpp<std::int64_t>(n));
+      CHECK(SameAsYamlCpp<std::uint64_t>(n));
+      CHECK(SameAsYamlCpp<float>(n));
+      CHECK(SameAsYamlCpp<double>(n));
+      CHECK(SameAsYamlCpp<signed char>(n));
+      CHECK(SameAsYamlCpp<bool>(n));
+   }
+   CHECK(!YamlPathDetail::IsFastNumber<bool>);
+   CHECK(!YamlPathDetail::IsFastNumber<char>);
+   CHECK(YamlPathDetail::IsFastNumber<std::int64_t>);
+   CHECK_THROWS_AS(Accumulate<int>(Load("[1, [2], 3]")), BadConversion);
+   CHECK_THROWS_AS(Accumulate<int>(Load("[1, ~, 3]")), BadConversion);
+
+   CHECK(Accumulate<double>(Load("[2, 3.5, -4, .inf]")) == std::numeric_limits<double>::infinity());
+   CHECK(Accumulate<double>(Load("[2, 3.5, -4, 010, 1e1]")) == 21.5);
+   CHECK(Accumulate<int>(Load("[2, -4, 0x10, 010]")) == 22);
+   CHECK(Accumulate<std::int64_t>(Load("{ a : 4000000000, b : -1, c : 010 }")) == 4000000007);
+   CHECK(Accumulate<std::string>(Load("[a, b, c]")) == "abc");
+}
+
+TEST_CASE("Accumulate in parallel")
+{
+   std::string yaml = "[";
+   for (int i = 0; i < 1000; ++i)
+      yaml += std::to_string(i) + ",";
+   yaml += "1000]";
+   auto n = Load(yaml);
+
+   PathContext parallel;
+   parallel.SetOptions({ 4, 10 });
+   auto plus = [](std::int64_t a, std::int64_t b) { return a + b; };
+   CHECK(Accumulate<std::int64_t>(n, 7, plus, &parallel) == 500507);
+   CHECK(AccumulateRefOp<std::int64_t>(n, 7, [](std::int64_t & a, std::int64_t b) { a += b; }, &parallel) == 500507);
+   CHECK(Accumulate<std::string>(n, "", [](std::string a, std::string b) { return a + b; }, &parallel) == Accumulate<std::string>(n));   // combined in order
+   CHECK(SelectAccumulate<std::int64_t>(Load("{ values : " + yaml + " }"), "values", 0, plus, {}, &parallel) == 500500);
+   CHECK(SelectAccumulate<std::int64_t>(Load("{ values : " + yaml + " }"), CompilePath("values"), 0, &parallel) == 500500);
+
+   Node withError = Load(yaml);
+   withError[900] = "x";
+   CHECK_THROWS_AS(Accumulate<std::int64_t>(withError, 0, plus, &parallel), BadConversion);
+}
+
+TEST_CASE("SelectMin / SelectMax / SelectMean / SelectValueCount")
+{
+   auto n = Load("{ items : [ { price : 2 }, { price : 7, tax : 1 }, { name : x }, { price : -3, tax : 2 } ], total : [ 7, 8, 1.5 ], none : ~ }");
+
+   CHECK(SelectMin<int>(n, "items.price") == -3);
+   CHECK(SelectMax<int>(n, "items.price") == 7);
+   CHECK(SelectMean(n, "items.price") == 2.0);
+   CHECK(SelectMean<int>(n, "items.%", { PathArg("tax") }) == 1);
+   CHECK(SelectValueCount(n, "items.price") == 3);
+   CHECK(SelectCount(n, "total") == 1);
+   CHECK(SelectValueCount(n, "total") == 3);
+   CHECK(SelectValueCount(n, CompilePath("items")) == 4);
+   CHECK(SelectMin<double>(n, CompilePath("total")) == 1.5);
+   CHECK(SelectMax<double>(n, CompilePath("total")) == 8);
+   CHECK(SelectMean<double>(n, CompilePath("total")) == 5.5);
+
+   CHECK(!SelectMin<int>(n, "items.xyz"));
+   CHECK(!SelectMax<int>(n, "none"));
+   CHECK(!SelectMean(n, "none"));
+   CHECK(SelectValueCount(n, "none") == 0);
+   CHECK_THROWS_AS(SelectMin<int>(n, "items.~"), PathException);
+
+   std::string yaml = "[";
+   for (int i = 0; i < 1000; ++i)
+      yaml += std::to_string((i * 37) % 1001) + ",";
+   yaml += "1000]";
+   auto seq = Load(yaml);
+   PathContext parallel;
+   parallel.SetOptions({ 4, 10 });
+   CHECK(SelectMin<int>(seq, "[0]") == 0);
+   CHECK(SelectMin<int>(Load("{ v : " + yaml + " }"), "v", {}, &parallel) == 0);
+   CHECK(SelectMax<int>(Load("{ v : " + yaml + " }"), "v", {}, &parallel) == 1000);
+   CHECK(SelectMean(Load("{ v : " + yaml + " }"), "v", {}, &parallel) == SelectMean(Load("{ v : " + yaml + " }"), "v"));
+}
+
 
 
 void CheckCreate(char const * path, char const * expectedNode)
 {
    auto n = YAML::Create(path);
-   std::string forDbg = (YAML::Emitter() << n).c_str();
+   std::string forDbg = YAML::Dump(n);
    auto expectedN = YAML::Load(expectedNode);
    CHECK(T(n) == T(expectedN));
 }
@@ -687,7 +2419,7 @@ void CheckEnsure(char const * initial, char const * path, size_t expectedEndNode
    YAML::Node expectedRootY = YAML::Load(expectedRoot);
    YAML::Node expectedAfterAssignmentY = YAML::Load(expectedAfterAssignment);
 
-   std::string rootS = (YAML::Emitter() << root).c_str();
+   std::string rootS = YAML::Dump(root);
    CHECK(T(root) == T(expectedRootY));
 
    for (size_t i=0; i<result.size(); ++i)
@@ -695,7 +2427,7 @@ void CheckEnsure(char const * initial, char const * path, size_t expectedEndNode
       if (result[i].IsNull())
          result[i] = YAML::Node("111");
    }
-   std::string afterAssignmentS = (YAML::Emitter() << root).c_str();
+   std::string afterAssignmentS = YAML::Dump(root);
    CHECK(T(root) == T(expectedAfterAssignmentY));
 }
 
@@ -717,13 +2449,139 @@ TEST_CASE("Ensure")
       "{ keyA : 12, keyB : { keyC : 33, keyD : ~, keyE : ~ } }",
       "{ keyA : 12, keyB : { keyC : 33, keyD : 111, keyE : 111 } }");
 
+   // a slice grows the sequence to its last position
+   CheckEnsure(nullptr, "items[1-4,2].x", 2,
+      "{ items : [ ~, { x : ~ }, ~, { x : ~ } ] }",
+      "{ items : [ ~, { x : 111 }, ~, { x : 111 } ] }");
+
+   CheckEnsure("items : [ a ]", "items[!0-1]", 2,
+      "{ items : [ a, ~ ] }",
+      "{ items : [ a, 111 ] }");
+
+   // a slice of a map or a scalar cannot be ensured
+   Node config = Load("{ items : { a : 1 }, name : x }");
+   for (auto path : { "items[0-1]", "name[1-2].n" })
+   {
+      EPathError err = EPathError::OK;
+      try { Ensure(config, path); } catch (PathException const & x) { err = x.Error(); }
+      CHECK(err == EPathError::InvalidNodeType);
+   }
+
 }
 
 
+TEST_CASE("Assign")
+{
+   Node root;
+   CHECK(Assign(root, "a.b", 5) == 1);
+   CHECK(Assign(root, "a.b", 6) == 1);     // the existing key is assigned
+   CHECK(Assign(root, "{x,y}.z", std::string("v")) == 2);
+   CHECK(Assign(root, "c[1]", Load("{ k : [ 1, 2 ] }")) == 1);
+   CHECK(Assign(root, "s[1-3].n", "t") == 3);
+   CHECK(T(root) == T(Load("{ a : { b : 6 }, x : { z : v }, y : { z : v }, c : [ ~, { k : [ 1, 2 ] } ], s : [ ~, { n : t }, { n : t }, { n : t } ] }")));
+
+   // each node has its own value
+   CHECK(!root["x"]["z"].is(root["y"]["z"]));
+   CHECK(!root["s"][1]["n"].is(root["s"][2]["n"]));
+   root["s"][1]["n"] = "u";
+   CHECK(root["s"][2]["n"].as<std::string>() == "t");
+   Node shared;
+   CHECK(Assign(shared, "a[0-1]", Node("v")) == 2);
+   CHECK(!shared["a"][0].is(shared["a"][1]));
+   CHECK(Dump(shared).find('&') == std::string::npos);     // no anchor and alias
+   Node value = Load("{ k : 1 }");
+   CHECK(Assign(shared, "b[0-1]", value) == 2);
+   CHECK(!shared["b"][0].is(value));
+   CHECK(!shared["b"][0]["k"].is(shared["b"][1]["k"]));
+
+   // a map filter assigns its own values
+   CHECK(Assign(root, "a{d=1}", 2) == 0);
+   CHECK(root["a"]["d"].as<int>() == 1);
+
+   // same document as Ensure, assigning the value to each result node
+   char const * initial = "{ servers : [ { name : a } ], keyA : 12 }";
+   std::vector<std::pair<PathArg, Node>> items = {
+      { "servers[2].name", Node("c") }, { "servers[0].port", Node(80) }, { "config.{cache,log}.level", Node(3) },
+      { "{keyA=22,keyB}.keyC", Node("bc") }, { "list[1]", Node(1) }, { "list[0-1]", Node(0) }, { "config.log", Node("db") } };
+   Node expected = Load(initial);
+   Node assigned = Load(initial);
+   for (auto && item : items)
+   {
+      Node result = Ensure(expected, item.first);
+      for (size_t i = 0; i < result.size(); ++i)
+         result[i] = item.second;
+      CHECK(Assign(assigned, item.first, Node(item.second)) == result.size());
+   }
+   CHECK(T(assigned) == T(expected));
 
+   // errors are those of Ensure
+   CHECK_THROWS_AS(Assign(assigned, "keyA.x", 1), PathException);
+   CHECK_THROWS_AS(Assign(assigned, "{a!=1}", 1), PathException);
+}
 
 
-bool is(char const * a, char const * b) { return _stricmp(a, b) == 0; }
+TEST_CASE("EnsureMany")
+{
+   // same document as Ensure for each item, assigning the value to each result node
+   char const * initial = "{ servers : [ { name : a } ], keyA : 12 }";
+   std::vector<std::pair<PathArg, Node>> items = {
+      { "servers[2].name", Node("c") }, { "servers[2].ports[1]", Node(8080) }, { "servers[0].port", Node(80) },
+      { "config.db.host", Node("localhost") }, { "config.db.port", Node(5432) }, { "config.{cache,log}.level", Node(3) },
+      { "{keyA=22,keyB}.keyC", Node("bc") }, { "list[1]", Node(1) }, { "list[0]", Node(0) }, { "config.db.host", Node("db") },
+      { "slots[0-4,2].id", Node(7) }, { "slots[1].id", Node(8) }, { "slots[0-4,2].on", Node(true) }, { "servers[!1-2]", Node("s") } };
+
+   Node expected = Load(initial);
+   for (auto && item : items)
+   {
+      Node result = Ensure(expected, item.first);
+      for (size_t i = 0; i < result.size(); ++i)
+         result[i] = item.second;
+   }
+
+   Node root = Load(initial);
+   EnsureMany(root, items.data(), items.size());
+   CHECK(T(root) == T(expected));
+   CHECK(root["config"]["db"]["host"].as<std::string>() == "db");
+   CHECK(root["servers"].size() == 3);
+   CHECK(root["list"][1].as<int>() == 1);
+   CHECK(root["slots"].size() == 5);
+   CHECK(root["slots"][4]["on"].as<bool>());
+
+   // a default-constructed root becomes the document, as for Ensure
+   Node created;
+   EnsureMany(created, { { "a.b", Node(1) }, { "a.c[1]", Node(2) } });
+   CHECK(T(created) == T(Load("{ a : { b : 1, c : [ ~, 2 ] } }")));
+   Node ensured;
+   Ensure(ensured, "a.b");
+   CHECK(T(ensured) == T(Load("{ a : { b : ~ } }")));
+
+   // a value replaces the nodes created below it
+   Node replaced;
+   EnsureMany(replaced, { { "a.b", Node(1) }, { "a", Node(2) } });
+   CHECK(replaced["a"].as<int>() == 2);
+
+   // malformed and unsupported paths throw before the document is modified
+   Node unchanged = Load(initial);
+   CHECK_THROWS_AS(EnsureMany(unchanged, { { "new", Node(1) }, { "a..b", Node(2) } }), PathException);
+   CHECK_THROWS_AS(EnsureMany(unchanged, { { "new", Node(1) }, { "{a!=1}", Node(2) } }), PathException);
+   CHECK_THROWS_AS(EnsureMany(unchanged, { { "new.%", Node(1) } }), PathException);
+   CHECK(T(unchanged) == T(Load(initial)));
+
+   // a path that cannot be ensured
+   CHECK_THROWS_AS(EnsureMany(unchanged, { { "keyA.x", Node(1) } }), PathException);
+}
+
+
+
+
+
+bool is(char const * a, char const * b) 
+{ 
+   for (; *a && *b; ++a, ++b)
+      if (std::tolower((unsigned char) *a) != std::tolower((unsigned char) *b))
+         return false;
+   return *a == *b;
+}
 bool is(char const * a, char const * b, char const * balt) { return is(a,b) || (balt && is(a,balt)); }
 
 int main(int argc, char ** argv)
@@ -805,12 +2663,12 @@ int main(int argc, char ** argv)
          if (is_(cmdidx, "S", "Select") || argc <= cmdidx || is_(cmdidx, ""))    // Select
          {
             auto result = YAML::Select(root, yamlPath);
-            std::cout << (YAML::Emitter() << result).c_str() << "\n";
+            std::cout << YAML::Dump(result) << "\n";
          }
          else if (is_(cmdidx, "R", "Require"))
          {
             auto result = YAML::Require(root, yamlPath);
-            std::cout << (YAML::Emitter() << result).c_str() << "\n";
+            std::cout << YAML::Dump(result) << "\n";
          }
          else if (is_(cmdidx, "P", "PathResolve"))
          {
@@ -818,7 +2676,7 @@ int main(int argc, char ** argv)
             YAML::PathArg path = yamlPath;
             auto result = PathResolve(root, path, {}, verbose ? &x : nullptr);
 
-            std::cout << (YAML::Emitter() << root).c_str() << "\n";
+            std::cout << YAML::Dump(root) << "\n";
 
             if (verbose)
             {
@@ -850,11 +2708,11 @@ int main(int argc, char ** argv)
             size_t erroffs = 0;
             auto result = YAML::Ensure(root, yamlPath);
 
-            std::cout << (YAML::Emitter() << root).c_str() << "\n";
+            std::cout << YAML::Dump(root) << "\n";
          }
 
          else
-            throw std::exception("unknown command");
+            throw std::runtime_error("unknown command");
       }
       catch (std::exception const & x)
       {
@@ -19,8 +19,25 @@ The most important methods are
 
    - \ref Select "Select"(node, path) selecting a node. If no node can be matched, an empty node is returned
    - \ref Require "Require"(node, path) Like \c select, but failure to match a node throws an exception
+   - \ref SelectEach "SelectEach"(node, path, callback) visits the selected nodes, without creating a sequence for the result. 
+     \ref SelectInto, \ref SelectFirst, \ref SelectExists, \ref SelectCount and \ref SelectAccumulate are built on it
+   - \ref Accumulate sums (or folds) the values of a node, \ref SelectAccumulate, \ref SelectMin, \ref SelectMax, \ref SelectMean and \ref SelectValueCount the values of the selected nodes (<tt>yaml-accumulate.h</tt>)
+   - \ref SelectStream "SelectStream"(input, path, callback) selects while a document is parsed, without loading it
+   - \ref SelectAll "SelectAll"(yaml, path, callback) and SelectAllFromFile select from every document of a multi-document text, optionally in parallel
+   - \ref SelectMany "SelectMany"(node, paths, count) selects many paths in one traversal, resolving common prefixes once
+   - \ref Ensure "Ensure"(node, path) creates the nodes of a path, \ref EnsureMany "EnsureMany"(node, items) builds many paths with their values in one pass
+   - \ref Assign "Assign"(node, path, value) creates the nodes of a path and assigns them a value, without creating a result sequence
    - \ref PathResolve for incremental matching
    - \ref PathValidate for validating a path
+   - \ref CompilePath parses a path once, the \ref CompiledPath can be passed to \c Select, \c Require and \c PathResolve without parsing it again
+   - \ref StaticPath path literals (<code>"a.b"_ypath</code>) are validated and parsed during compilation
+   - \ref PathCacheSetCapacity configures the cache of parsed paths used by the string-based functions
+   - \ref PathIndex indexes a sequence of maps by the value of a key, for map filters resolved with a \ref PathContext
+   - \ref DocumentIndex indexes all keys of a document, for recursive key selectors resolved with a \ref PathContext
+   - \ref SelectCache memoizes the results of \c Select on one document, discarding them when the document is modified by \ref Ensure
+   - \ref SelectOptions on a \ref PathContext filter large sequences on multiple threads
+   - \ref PathArena supplies the scratch memory for resolving paths, reused across calls (by default, one arena per thread)
+   - \ref PathTracer on a \ref PathContext receives the time, nodes and keys read of each selector; \ref PathStats collects them to find the slowest paths
 
    - \ref SelectByKey, \ref SelectByIndex, \ref SelectBySeqMapFilter
 
@@ -50,6 +67,31 @@ Example:
 If \c node is a sequence, selects the n'th node (where \c n is the number in brackets).\n
 If \c node is a scalar or a map, and \c n is 0, selects that scalar or map
 
+## Slice
+
+<code>Select(node, "[5-7]")</code>, <code>Select(node, "[!5-7]")</code> or <code>Select(node, "[5-9,2]")</code>
+
+If \c node is a sequence, selects the elements at the positions \c 5 to \c 7 (less if they don't exist), 
+or with the increment after the comma: \c "[5-9,2]" selects the positions \c 5, \c 7 and \c 9.\n
+With an exclamation mark, selects nothing unless all positions exist.\n
+A scalar or a map acts as a one-element sequence, as for an index. The result is a sequence, like a key selector applied to a sequence.
+
+Only the elements of the slice are read, and a slice applied to the result of another fan-out selector selects from that result:
+<code>"items.name[0-9]"</code> selects the first ten names.
+
+## Type Predicates
+
+<code>Select(node, "!ismap")</code>, <code>Select(node, "[$isscalar]")</code> or <code>Select(node, "{$isseq}")</code>
+
+\c "!ismap", \c "!isseq" and \c "!isscalar" select \c node if it is a map (or sequence, or scalar, respectively).\n
+\c "[$ismap]" etc. selects the elements of a sequence that are maps. If \c node is not a sequence, it works like \c "!ismap".\n
+\c "{$isscalar}" etc. is a key selection in a map filter: it selects the keys whose value is a scalar, e.g. 
+<code>"{color=red,$isscalar}"</code> selects the scalar values of the maps with a red color.
+
+Only the node type is compared, scalars are not read or converted. 
+Applied to the result of a fan-out selector, \c "!ismap" and \c "[$ismap]" select the maps of that result:
+<code>"items.details!ismap"</code> selects the details that are maps.
+
 ## Seq-Map Filter
 
 <code>Select(node, "{key=value}")</code> or <code>Select(node, "{key=}")</code>
@@ -63,6 +105,26 @@ If \c node is a sequence, selects all maps from the sequence that contain a key
 independent of its value.\n
 To check for an empty key, you can use quotes, e.g. <code>Select(node, "{key=''}"</code> (see quoting)
 
+Conditions separated by a comma select a map if any of them matches, e.g. <code>"{color=red,color=blue}"</code>. \n
+Conditions joined by \c & match together: <code>"{color=red&size=L,color=blue}"</code> selects the maps with a red color and 
+size L, and the maps with a blue color. The sequence is filtered in one pass, in sequence order. If a \ref PathIndex exists for 
+conditions of each group, the maps are looked up in the indexes.
+
+## Recursive Key
+
+<code>Select(node, "..key")</code> or <code>Select(node, "**.key")</code>
+
+Selects the values of \c "key" in \c node and in all maps below it, at any depth, in document order: 
+the value in a map comes before the values found in its children. The result is a sequence, like a key selector applied to a sequence. 
+After another selector, the first period of \c ".." is the separator, i.e. \c "a..key" selects below \c "a".
+
+Example:
+\code
+{ timeout : 1, db : { timeout : 2 }, hosts : [ { timeout : 3 } ] }  ==&rarr;  [ 1, 2, 3 ]
+\endcode
+
+Without a \ref DocumentIndex, all nodes below \c node are visited.
+
 ## Selector Chaining
 
 <code>Select(node, "keyA.keyB")</code>
@@ -90,7 +152,7 @@ The token can be wrapped either in single or double quotes. A token in single qu
 Each element in the list can be initialized by either a \c PathArg or an unsigned integer.
 If a \c "%" is found where a a <i>bindable token</i> is expected, the next value from the argument list is taken instead.
 
-Bindable tokens are all string tokens (see "Quoting") and the value of an index selector.
+Bindable tokens are all string tokens (see "Quoting"), the value of an index selector, and the positions and increment of a slice.
 
 ## Character Set and Case Sensitivity
 
@@ -106,6 +168,20 @@ There are two categories of errors: \ref PathException::IsPathError "path errors
 \ref PathException::IsNodeError "node errors" indicate a failure
 to find a matching node for a selector.
 
+# Thread Safety
+
+Resolving a path never modifies the document: lookups use the const \c Node interface only.
+\ref Select, \ref Require, \ref PathResolve, \ref SelectMany and the \ref SelectEach family can be called 
+concurrently on the same document from many threads, as long as no thread modifies it (e.g. with \ref Ensure, 
+or assigning to a node).
+
+yaml-cpp nodes of one document share a memory holder, which is modified when a new node refers to document nodes. 
+The result sequence of a fan-out selector and the map created by key selection in a map filter are such nodes: 
+yaml-path creates them under a global lock. Other code creating such nodes in a document that is read concurrently
+has to synchronize itself.
+
+The path cache and \ref PathIndex "indexes" are thread safe. A \ref PathContext can be shared by threads after it was set up.
+
 
 */
 
@@ -21,13 +21,218 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
-
 #pragma once
 
-#include <yaml-cpp/node/node.h>
+#include <yaml-cpp/yaml.h>
+#include "yaml-path.h"
+#include <charconv>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace YAML
 {
+   namespace YamlPathDetail
+   {
+      /// \internal \c T is converted by \ref ParseNumber instead of yaml-cpp's stream based <code>convert&larr;T&rarr;</code> (the character types are read as characters, or as numbers, by yaml-cpp)
+      template <typename T>
+      inline constexpr bool IsFastNumber = std::is_arithmetic_v<T> && !std::is_same_v<T, bool> &&
+         !std::is_same_v<T, char> && !std::is_same_v<T, signed char> && !std::is_same_v<T, unsigned char> &&
+         !std::is_same_v<T, wchar_t> && !std::is_same_v<T, char16_t> && !std::is_same_v<T, char32_t>
+#if !defined(__cpp_lib_to_chars)
+         && std::is_integral_v<T>      // no std::from_chars for floating point types
+#endif
+         ;
+
+      /// \internal excludes a \ref PathContext pointer from the \c op argument of the accumulate functions, in favor of the overloads using <code>operator+=</code>
+      template <typename TOp>
+      using EnableIfOp = std::enable_if_t<!std::is_convertible_v<TOp, PathContext const *>, int>;
+
+      /** \internal parses \c text as a number, if it is in the common decimal form.
+
+          Returns \c false for anything else, which is left to yaml-cpp: a leading \c + or zero (yaml-cpp reads \c 010 as octal, \c 0x10 as hex), 
+          surrounding white space, \c .inf and \c .nan, and values out of range.
+      */
+      template <typename T>
+      bool ParseNumber(std::string const & text, T & value)
+      {
+         char const * begin = text.data();
+         char const * end = begin + text.size();
+         char const * digits = begin + (begin != end && *begin == '-');
+         if (digits == end)
+            return false;
+
+         if constexpr (std::is_integral_v<T>)
+         {
+            if (*digits == '0' && digits + 1 != end)
+               return false;
+         }
+         else if (*digits != '.' && (*digits < '0' || *digits > '9'))    // std::from_chars accepts "inf" and "nan"
+            return false;
+
+         auto [ptr, ec] = std::from_chars(begin, end, value);
+         return ec == std::errc() && ptr == end;
+      }
+
+      /// \internal <code>n.as&larr;T&rarr;()</code>, parsing numbers without yaml-cpp's conversion if possible
+      template <typename T>
+      T ValueAs(Node const & n)
+      {
+         if constexpr (IsFastNumber<T>)
+         {
+            T value{};
+            if (n.IsScalar() && ParseNumber(n.Scalar(), value))
+               return value;
+         }
+         return n.as<T>();
+      }
+
+      /// \internal calls <tt>fn(T)</tt> for the values \ref Accumulate visits: \c n if it is a scalar, the elements of a sequence, or the values of a map
+      template <typename T, typename TFunc>
+      void ForEachValue(Node const & n, TFunc && fn)
+      {
+         switch (n.Type())
+         {
+         case NodeType::Scalar:
+            fn(ValueAs<T>(n));
+            return;
+
+         case NodeType::Sequence:
+            for (auto && el : n)
+               fn(ValueAs<T>(el));
+            return;
+
+         case NodeType::Map:
+            for (auto it = n.begin(); it != n.end(); ++it)
+               fn(ValueAs<T>(it->second));
+            return;
+
+         case NodeType::Null:
+         default:
+            return;
+         }
+      }
+
+      /** \internal adds the values of \c n (see \ref ForEachValue) to \c acc, using <tt>add(TAcc &, T)</tt>.
+
+          A sequence that \ref FanOutChunks splits for the \ref SelectOptions of \c context is folded in parallel: 
+          each chunk is added to a default-constructed \c TAcc, and the chunks are combined in order 
+          using <tt>merge(TAcc & acc, TAcc && chunk)</tt>.
+      */
+      template <typename T, typename TAcc, typename TAdd, typename TMerge>
+      void Fold(Node const & n, TAcc & acc, TAdd & add, TMerge & merge, PathContext const * context)
+      {
+         size_t chunks = n.IsSequence() ? FanOutChunks(n.size(), context) : 1;
+         if (chunks <= 1)
+         {
+            ForEachValue<T>(n, [&](T && value) { add(acc, std::move(value)); });
+            return;
+         }
+
+         std::vector<TAcc> partial(chunks);
+         ParallelChunks(n.size(), chunks, [&](size_t chunk, size_t begin, size_t end)
+         {
+            for (size_t i = begin; i < end; ++i)
+               add(partial[chunk], ValueAs<T>(n[i]));
+         });
+         for (auto && p : partial)
+            merge(acc, std::move(p));
+      }
+
+      /// \internal \ref Fold for a binary operation without identity: the accumulator of a chunk is empty until its first value
+      template <typename T, typename TOp>
+      void FoldOp(Node const & n, std::optional<T> & acc, TOp & op, PathContext const * context)
+      {
+         auto add = [&](std::optional<T> & a, T && value)
+         {
+            if (a)
+               a = op(std::move(*a), std::move(value));
+            else
+               a.emplace(std::move(value));
+         };
+         auto merge = [&](std::optional<T> & a, std::optional<T> && chunk)
+         {
+            if (chunk)
+               add(a, std::move(*chunk));
+         };
+         Fold<T>(n, acc, add, merge, context);
+      }
+
+      /// \internal like \ref FoldOp, for an operation <tt>refop(T &, T)</tt>
+      template <typename T, typename TOp>
+      void FoldRefOp(Node const & n, std::optional<T> & acc, TOp & refop, PathContext const * context)
+      {
+         auto add = [&](std::optional<T> & a, T && value)
+         {
+            if (a)
+               refop(*a, std::move(value));
+            else
+               a.emplace(std::move(value));
+         };
+         auto merge = [&](std::optional<T> & a, std::optional<T> && chunk)
+         {
+            if (chunk)
+               add(a, std::move(*chunk));
+         };
+         Fold<T>(n, acc, add, merge, context);
+      }
+
+      /// \internal accumulator of \ref SelectMean
+      template <typename T>
+      struct MeanAcc
+      {
+         T sum = T();
+         size_t count = 0;
+      };
+
+      /// \internal \ref FoldOp over the nodes selected by \c path, empty if there is no value
+      template <typename T, typename TOp>
+      std::optional<T> SelectFoldOp(Node node, PathArg path, TOp op, PathBoundArgs args, PathContext const * context)
+      {
+         std::optional<T> result;
+         SelectEach(node, path, [&](Node const & n) { FoldOp(n, result, op, context); }, args, context);
+         return result;
+      }
+
+      template <typename T, typename TOp>
+      std::optional<T> SelectFoldOp(Node node, CompiledPath const & path, TOp op, PathContext const * context)
+      {
+         std::optional<T> result;
+         SelectEach(node, path, [&](Node const & n) { FoldOp(n, result, op, context); }, context);
+         return result;
+      }
+
+      template <typename T>
+      std::optional<T> MeanOf(MeanAcc<T> const & acc)
+      {
+         if (!acc.count)
+            return std::nullopt;
+         return acc.sum / static_cast<T>(acc.count);
+      }
+
+      /// \internal adds the values of \c n to \c acc, like \ref Fold
+      template <typename T>
+      void AddMean(MeanAcc<T> & acc, Node const & n, PathContext const * context)
+      {
+         auto add = [](MeanAcc<T> & a, T && value) { a.sum += std::move(value); ++a.count; };
+         auto merge = [](MeanAcc<T> & a, MeanAcc<T> && chunk) { a.sum += std::move(chunk.sum); a.count += chunk.count; };
+         Fold<T>(n, acc, add, merge, context);
+      }
+
+      /// \internal the number of values \ref ForEachValue visits
+      inline size_t ValueCount(Node const & n)
+      {
+         switch (n.Type())
+         {
+         case NodeType::Scalar:     return 1;
+         case NodeType::Sequence:
+         case NodeType::Map:        return n.size();
+         default:                   return 0;
+         }
+      }
+   }
 
    /** accumulates node values
 
@@ -37,69 +242,157 @@ namespace YAML
 
    Nodes to accumulate are converted to \c T using <code>Node.as&larr;T&rarr;()</code>,
    and then are accumulated by <code>x = op(x, node[i])</code>, starting with \c initial.
+   Arithmetic types (except \c bool and the character types) are parsed with \c std::from_chars when the scalar 
+   is a plain decimal number, with the same result as <code>Node.as&larr;T&rarr;()</code>.
+
+   With a \c context allowing parallel filtering (see \ref SelectOptions), a long sequence is split into chunks 
+   that are accumulated on multiple threads, and then combined in order. This requires an associative \c op, 
+   and \c op must be safe to call from multiple threads. Maps are always accumulated on the calling thread.
    */
-   template <typename T, typename TOp>
-   T Accumulate(Node n, T initial, TOp op)
+   template <typename T, typename TOp, YamlPathDetail::EnableIfOp<TOp> = 0>
+   T Accumulate(Node n, T initial, TOp op, PathContext const * context = nullptr)
    {
-      switch (n.Type())
-      {
-      case NodeType::Scalar:
-         return op(std::move(initial), std::move(n.as<T>()));
-
-      case NodeType::Sequence:
-         for (auto && el : n)
-            initial = op(std::move(initial), std::move(el.as<T>()));
-         return initial;
-
-      case NodeType::Map:
-         for (auto it = n.begin(); it != n.end(); ++it)
-            initial = op(std::move(initial), std::move(it->second.as<T>()));
-         return initial;
-
-      case NodeType::Null:
-      default:
-         return std::move(initial);
-      }
+      std::optional<T> result(std::move(initial));
+      YamlPathDetail::FoldOp(n, result, op, context);
+      return std::move(*result);
    }
 
    /** Accumulates node values
 
    like \ref Accumulate, but uses <code>op(x (by reference), node[i])</code>
    */
-   template <typename T, typename TOp>
-   T AccumulateRefOp(Node n, T initial, TOp refop)
+   template <typename T, typename TOp, YamlPathDetail::EnableIfOp<TOp> = 0>
+   T AccumulateRefOp(Node n, T initial, TOp refop, PathContext const * context = nullptr)
    {
-      switch (n.Type())
-      {
-      case NodeType::Null:
-         return std::move(initial);
+      std::optional<T> result(std::move(initial));
+      YamlPathDetail::FoldRefOp(n, result, refop, context);
+      return std::move(*result);
+   }
 
-      case NodeType::Scalar:
-         refop(initial, std::move(n.as<T>()));
-         return std::move(initial);
 
-      case NodeType::Sequence:
-         for (auto && el : n)
-            refop(initial, std::move(el.as<T>()));
-         return std::move(initial);
+   /** like \ref Accumulate, using <code>operator+=(T&, T)</code>
+   */
+   template <typename T>
+   T Accumulate(Node n, T initial = T(), PathContext const * context = nullptr)
+   {
+      return AccumulateRefOp(n, std::move(initial), [](T & a, T b) { a += b; }, context);
+   }
 
-      case NodeType::Map:
-         for (auto it = n.begin(); it != n.end(); ++it)
-            refop(initial, std::move(it->second.as<T>()));
-         return std::move(initial);
+   /** accumulates the values of the nodes selected by \c path, without creating a result sequence
 
-      default:
-         return initial;
-      }
+   Each node visited by \ref SelectEach is accumulated like \ref Accumulate does. 
+   This gives the same result as <code>Accumulate(Select(node, path), initial, op)</code>, 
+   except that a path fanning out over a sequence of sequences or maps accumulates their elements, instead of throwing.
+
+   Since the selected nodes are not collected, e.g. summing <tt>items.price</tt> needs constant extra memory.\n
+   \c context is used for resolving the path, and for accumulating a long sequence selected by the path in parallel (see \ref Accumulate). 
+   The fan-out of the path itself is visited on the calling thread.
+   */
+   template <typename T, typename TOp, YamlPathDetail::EnableIfOp<TOp> = 0>
+   T SelectAccumulate(Node node, PathArg path, T initial, TOp op, PathBoundArgs args = {}, PathContext const * context = nullptr)
+   {
+      SelectEach(node, path, [&](Node const & n) { initial = Accumulate(n, std::move(initial), op, context); }, args, context);
+      return initial;
    }
 
+   /** like \ref SelectAccumulate, for a path compiled by \ref CompilePath */
+   template <typename T, typename TOp, YamlPathDetail::EnableIfOp<TOp> = 0>
+   T SelectAccumulate(Node node, CompiledPath const & path, T initial, TOp op, PathContext const * context = nullptr)
+   {
+      SelectEach(node, path, [&](Node const & n) { initial = Accumulate(n, std::move(initial), op, context); }, context);
+      return initial;
+   }
 
-   /** like \ref Accumulate, using <code>operator+=(T&, T)</code>
+   /** like \ref SelectAccumulate, using <code>operator+=(T&, T)</code>
+   */
+   template <typename T>
+   T SelectAccumulate(Node node, PathArg path, T initial = T(), PathBoundArgs args = {}, PathContext const * context = nullptr)
+   {
+      auto add = [](T & a, T b) { a += b; };
+      SelectEach(node, path, [&](Node const & n) { initial = AccumulateRefOp(n, std::move(initial), add, context); }, args, context);
+      return initial;
+   }
+
+   /** like \ref SelectAccumulate, using <code>operator+=(T&, T)</code>, for a path compiled by \ref CompilePath
+   */
+   template <typename T>
+   T SelectAccumulate(Node node, CompiledPath const & path, T initial = T(), PathContext const * context = nullptr)
+   {
+      auto add = [](T & a, T b) { a += b; };
+      SelectEach(node, path, [&](Node const & n) { initial = AccumulateRefOp(n, std::move(initial), add, context); }, context);
+      return initial;
+   }
+
+   /** the smallest value accumulated by \ref SelectAccumulate, compared by <code>operator&lt;</code>. 
+       \returns an empty \c std::optional if there is no value
+   */
+   template <typename T>
+   std::optional<T> SelectMin(Node node, PathArg path, PathBoundArgs args = {}, PathContext const * context = nullptr)
+   {
+      return YamlPathDetail::SelectFoldOp<T>(node, path, [](T a, T b) { return b < a ? b : a; }, args, context);
+   }
+
+   /** like \ref SelectMin, for a path compiled by \ref CompilePath */
+   template <typename T>
+   std::optional<T> SelectMin(Node node, CompiledPath const & path, PathContext const * context = nullptr)
+   {
+      return YamlPathDetail::SelectFoldOp<T>(node, path, [](T a, T b) { return b < a ? b : a; }, context);
+   }
+
+   /** the largest value accumulated by \ref SelectAccumulate, compared by <code>operator&lt;</code>. 
+       \returns an empty \c std::optional if there is no value
    */
    template <typename T>
-   T Accumulate(Node n, T initial = T())
+   std::optional<T> SelectMax(Node node, PathArg path, PathBoundArgs args = {}, PathContext const * context = nullptr)
+   {
+      return YamlPathDetail::SelectFoldOp<T>(node, path, [](T a, T b) { return a < b ? b : a; }, args, context);
+   }
+
+   /** like \ref SelectMax, for a path compiled by \ref CompilePath */
+   template <typename T>
+   std::optional<T> SelectMax(Node node, CompiledPath const & path, PathContext const * context = nullptr)
+   {
+      return YamlPathDetail::SelectFoldOp<T>(node, path, [](T a, T b) { return a < b ? b : a; }, context);
+   }
+
+   /** the mean of the values accumulated by \ref SelectAccumulate: their sum (by <code>operator+=</code>), divided by their number. 
+       The division is done in \c T, use a floating point type for a fractional result.
+       \returns an empty \c std::optional if there is no value
+   */
+   template <typename T = double>
+   std::optional<T> SelectMean(Node node, PathArg path, PathBoundArgs args = {}, PathContext const * context = nullptr)
+   {
+      YamlPathDetail::MeanAcc<T> acc;
+      SelectEach(node, path, [&](Node const & n) { YamlPathDetail::AddMean(acc, n, context); }, args, context);
+      return YamlPathDetail::MeanOf(acc);
+   }
+
+   /** like \ref SelectMean, for a path compiled by \ref CompilePath */
+   template <typename T = double>
+   std::optional<T> SelectMean(Node node, CompiledPath const & path, PathContext const * context = nullptr)
+   {
+      YamlPathDetail::MeanAcc<T> acc;
+      SelectEach(node, path, [&](Node const & n) { YamlPathDetail::AddMean(acc, n, context); }, context);
+      return YamlPathDetail::MeanOf(acc);
+   }
+
+   /** the number of values \ref SelectAccumulate would accumulate: 1 for a selected scalar, the number of elements 
+       of a selected sequence or map. Unlike \ref SelectCount, it counts the elements of a sequence selected as a single node.
+       The values are not converted.
+   */
+   inline size_t SelectValueCount(Node node, PathArg path, PathBoundArgs args = {}, PathContext const * context = nullptr)
+   {
+      size_t count = 0;
+      SelectEach(node, path, [&](Node const & n) { count += YamlPathDetail::ValueCount(n); }, args, context);
+      return count;
+   }
+
+   /** like \ref SelectValueCount, for a path compiled by \ref CompilePath */
+   inline size_t SelectValueCount(Node node, CompiledPath const & path, PathContext const * context = nullptr)
    {
-      return AccumulateRefOp(n, initial, [](T & a, T b) { a += b; });
+      size_t count = 0;
+      SelectEach(node, path, [&](Node const & n) { count += YamlPathDetail::ValueCount(n); }, context);
+      return count;
    }
 
 } // namespace YAML
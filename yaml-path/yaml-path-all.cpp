@@ -0,0 +1,370 @@
+/*
+MIT License
+
+Copyright(c) 2019 Peter Hauptmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "yaml-path.h"
+#include "yaml-path-internals.h"
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <istream>
+#include <streambuf>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace YAML
+{
+   namespace YamlPathDetail
+   {
+      namespace
+      {
+         /// \internal a line of \c yaml starting at \c line with a document marker
+         bool IsMarker(std::string_view yaml, size_t line, char const * marker)
+         {
+            if (yaml.compare(line, 3, marker) != 0)
+               return false;
+            return line + 3 == yaml.size() || std::string_view(" \t\r\n").find(yaml[line + 3]) != std::string_view::npos;
+         }
+
+         /// \internal reads a document from memory, without copying it
+         class MemoryInput : public std::streambuf
+         {
+         public:
+            explicit MemoryInput(std::string_view text)
+            {
+               char * begin = const_cast<char *>(text.data());      // the get area is only read
+               setg(begin, begin, begin + text.size());
+            }
+         };
+
+         /// \internal a file mapped into memory for reading
+         class MappedFile
+         {
+         public:
+            explicit MappedFile(std::string const & fileName);
+            ~MappedFile();
+            MappedFile(MappedFile const &) = delete;
+            MappedFile & operator=(MappedFile const &) = delete;
+
+            std::string_view Data() const { return { m_data, m_size }; }
+
+         private:
+            char const * m_data = nullptr;
+            size_t m_size = 0;
+#ifdef _WIN32
+            HANDLE m_file = INVALID_HANDLE_VALUE;
+            HANDLE m_mapping = nullptr;
+
+            void Close();
+#endif
+         };
+
+#ifdef _WIN32
+         MappedFile::MappedFile(std::string const & fileName)
+         {
+            auto fail = [&]
+            {
+               auto err = GetLastError();
+               Close();
+               throw std::system_error(int(err), std::system_category(), "cannot map " + fileName);
+            };
+
+            m_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE)
+               fail();
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(m_file, &size))
+               fail();
+            m_size = size_t(size.QuadPart);
+            if (m_size == 0)
+               return;
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!m_mapping)
+               fail();
+            m_data = static_cast<char const *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+            if (!m_data)
+               fail();
+         }
+
+         MappedFile::~MappedFile()
+         {
+            Close();
+         }
+
+         void MappedFile::Close()
+         {
+            if (m_data)
+               UnmapViewOfFile(m_data);
+            if (m_mapping)
+               CloseHandle(m_mapping);
+            if (m_file != INVALID_HANDLE_VALUE)
+               CloseHandle(m_file);
+            m_data = nullptr;
+            m_mapping = nullptr;
+            m_file = INVALID_HANDLE_VALUE;
+         }
+#else
+         MappedFile::MappedFile(std::string const & fileName)
+         {
+            int fd = ::open(fileName.c_str(), O_RDONLY);
+            if (fd < 0)
+               throw std::system_error(errno, std::generic_category(), "cannot map " + fileName);
+
+            struct stat st;
+            void * data = MAP_FAILED;
+            int err = 0;
+            if (::fstat(fd, &st) != 0)
+               err = errno;
+            else if (st.st_size > 0 && (data = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+               err = errno;
+            ::close(fd);      // the mapping stays valid
+            if (err)
+               throw std::system_error(err, std::generic_category(), "cannot map " + fileName);
+
+            if (data != MAP_FAILED)
+            {
+               m_data = static_cast<char const *>(data);
+               m_size = size_t(st.st_size);
+               ::madvise(data, m_size, MADV_SEQUENTIAL);
+            }
+         }
+
+         MappedFile::~MappedFile()
+         {
+            if (m_data)
+               ::munmap(const_cast<char *>(m_data), m_size);
+         }
+#endif
+
+         /// \internal resolves a document from \c text like \ref SelectStream. Returns false if the text contains no document.
+         bool SelectDocument(std::string_view text, CompiledPathData const & cp, NodeVisitor const & visitor, size_t & visited, PathContext const * context)
+         {
+            MemoryInput buffer(text);
+            std::istream input(&buffer);
+            return StreamDocument(input, cp, visitor, visited, context);
+         }
+
+         size_t VisitAllSerial(std::string_view yaml, CompiledPathData const & cp, NodeVisitor const & visitor, size_t & document, PathContext const * context)
+         {
+            bool stopped = false;
+            auto visit = [&](Node const & node) { stopped = !visitor(node); return !stopped; };
+            NodeVisitor stopping(visit);
+
+            size_t visited = 0;
+            size_t documents = 0;
+            for (size_t begin = 0; begin < yaml.size() && !stopped; )
+            {
+               size_t end = DocumentEnd(yaml, begin);
+               document = documents;
+               if (SelectDocument(yaml.substr(begin, end - begin), cp, stopping, visited, context))
+                  ++documents;
+               begin = end;
+            }
+            return visited;
+         }
+
+         /** \internal parses the documents of a stream on worker threads, and visits their results in document order on the calling thread.
+
+             Workers claim the next document (splitting it from the stream) while it is inside a window of \c window documents 
+             after the last document visited, and store the selected nodes in the slot of the document.
+         */
+         class ParallelDocuments
+         {
+         public:
+            ParallelDocuments(std::string_view yaml, CompiledPathData const & cp, size_t threads) : m_yaml(yaml), m_cp(cp), m_slots(2 * threads)
+            {
+               m_workers.reserve(threads);
+               for (size_t i = 0; i < threads; ++i)
+                  m_workers.emplace_back([this] { Work(); });
+            }
+
+            ~ParallelDocuments()
+            {
+               {
+                  std::lock_guard<std::mutex> lock(m_lock);
+                  m_stop = true;
+               }
+               m_changed.notify_all();
+               for (auto && worker : m_workers)
+                  worker.join();
+            }
+
+            size_t Visit(NodeVisitor const & visitor, size_t & document);
+
+         private:
+            struct Slot
+            {
+               bool ready = false;
+               bool document = false;        ///< the text contained a document
+               std::vector<Node> nodes;
+               std::exception_ptr error;
+            };
+
+            std::string_view m_yaml;
+            CompiledPathData const & m_cp;
+            std::mutex m_lock;
+            std::condition_variable m_changed;
+            std::vector<Slot> m_slots;
+            size_t m_next = 0;               ///< the index of the next document to claim
+            size_t m_scan = 0;               ///< the start of the next document in \c m_yaml
+            size_t m_visited = 0;            ///< the number of documents taken by \ref Visit
+            bool m_stop = false;
+            std::vector<std::thread> m_workers;
+
+            void Work();
+         };
+
+         void ParallelDocuments::Work()
+         {
+            std::unique_lock<std::mutex> lock(m_lock);
+            for (;;)
+            {
+               m_changed.wait(lock, [&] { return m_stop || m_scan >= m_yaml.size() || m_next < m_visited + m_slots.size(); });
+               if (m_stop || m_scan >= m_yaml.size())
+                  return;
+
+               size_t index = m_next++;
+               size_t begin = m_scan;
+               m_scan = DocumentEnd(m_yaml, begin);
+               size_t end = m_scan;
+               lock.unlock();
+
+               Slot result;
+               try
+               {
+                  auto collect = [&](Node const & node) { result.nodes.push_back(node); };
+                  size_t visited = 0;
+                  result.document = SelectDocument(m_yaml.substr(begin, end - begin), m_cp, NodeVisitor(collect), visited, nullptr);    // the arena of a context can't be shared
+               }
+               catch (...)
+               {
+                  result.error = std::current_exception();
+               }
+
+               lock.lock();
+               result.ready = true;
+               m_slots[index % m_slots.size()] = std::move(result);
+               m_changed.notify_all();
+            }
+         }
+
+         size_t ParallelDocuments::Visit(NodeVisitor const & visitor, size_t & document)
+         {
+            size_t visited = 0;
+            size_t documents = 0;
+            for (size_t index = 0; ; ++index)
+            {
+               Slot slot;
+               {
+                  std::unique_lock<std::mutex> lock(m_lock);
+                  auto & next = m_slots[index % m_slots.size()];
+                  m_changed.wait(lock, [&] { return next.ready || (m_scan >= m_yaml.size() && index >= m_next); });
+                  if (!next.ready)
+                     return visited;      // all documents visited
+                  slot = std::move(next);
+                  next = Slot();
+                  m_visited = index + 1;
+               }
+               m_changed.notify_all();
+
+               if (slot.error)
+                  std::rethrow_exception(slot.error);
+               if (!slot.document)
+                  continue;
+
+               document = documents++;
+               for (auto && node : slot.nodes)
+               {
+                  ++visited;
+                  if (!visitor(node))
+                     return visited;
+               }
+            }
+         }
+
+         size_t Threads(PathContext const * context)
+         {
+            if (!context)
+               return 1;
+            size_t threads = context->Options().threads;
+            return threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+         }
+      }
+
+      size_t DocumentEnd(std::string_view yaml, size_t begin)
+      {
+         bool started = false;      // false while there are only directives, comments and blank lines, which belong to the next document
+         for (size_t line = begin; line < yaml.size(); )
+         {
+            size_t eol = yaml.find('\n', line);
+            size_t next = eol == std::string_view::npos ? yaml.size() : eol + 1;
+            if (IsMarker(yaml, line, "---"))
+            {
+               if (started)
+                  return line;
+               started = true;
+            }
+            else if (IsMarker(yaml, line, "..."))
+               return next;
+            else if (!started)
+            {
+               size_t first = yaml.find_first_not_of(" \t\r", line);
+               started = first < next && yaml[first] != '\n' && yaml[first] != '#' && yaml[first] != '%';
+            }
+            line = next;
+         }
+         return yaml.size();
+      }
+
+      size_t VisitAll(std::string_view yaml, CompiledPath const & path, NodeVisitor const & visitor, size_t & document, PathContext const * context)
+      {
+         auto && cp = StreamPathData(path);
+         size_t threads = Threads(context);
+         if (threads <= 1)
+            return VisitAllSerial(yaml, cp, visitor, document, context);
+
+         ParallelDocuments documents(yaml, cp, threads);
+         return documents.Visit(visitor, document);
+      }
+
+      size_t VisitAllFromFile(std::string const & fileName, CompiledPath const & path, NodeVisitor const & visitor, size_t & document, PathContext const * context)
+      {
+         StreamPathData(path);      // a malformed path throws before the file is opened
+         MappedFile file(fileName);
+         return VisitAll(file.Data(), path, visitor, document, context);
+      }
+   }
+}
@@ -0,0 +1,182 @@
+/*
+MIT License
+
+Copyright(c) 2019 Peter Hauptmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "yaml-path.h"
+#include "yaml-path-internals.h"
+#include <algorithm>
+#include <cstdint>
+
+/* Scratch memory (PathArena, ScratchScope)
+
+   The arena is a list of blocks used from front to back. Allocating bumps the top (block, offset), deallocating does nothing:
+   when a ScratchScope ends, the top is reset to where it was when the scope began, and the blocks are kept for the next call.
+   A new block is at least twice the size of the previous one, so a call that needs more scratch memory than the arena has
+   adds only a few blocks. Allocations larger than LargeAllocation are forwarded to the heap, to limit the memory kept per thread.
+   When the thread arena is no longer used, it releases the blocks beyond ThreadArenaRetained: 
+   one large call does not pin its scratch memory for the lifetime of the thread.
+*/
+
+namespace YAML
+{
+   namespace
+   {
+      constexpr size_t MinBlockSize = 4096;
+
+      /// the first offset from \c base, starting at \c offset, that is aligned to \c alignment
+      size_t AlignUp(std::byte const * base, size_t offset, size_t alignment)
+      {
+         auto address = reinterpret_cast<std::uintptr_t>(base) + offset;
+         return offset + ((alignment - address % alignment) % alignment);
+      }
+   }
+
+   PathArena::PathArena(size_t reserve)
+   {
+      if (reserve)
+         AddBlock(reserve);
+   }
+
+   PathArena::~PathArena() = default;
+
+   size_t PathArena::Capacity() const
+   {
+      size_t capacity = 0;
+      for (auto && block : m_blocks)
+         capacity += block.size;
+      return capacity;
+   }
+
+   size_t PathArena::Used() const
+   {
+      size_t used = m_top.offset;
+      for (size_t i = 0; i < m_top.block && i < m_blocks.size(); ++i)
+         used += m_blocks[i].size;
+      return used;
+   }
+
+   void PathArena::Trim()
+   {
+      size_t keep = m_top.offset ? m_top.block + 1 : m_top.block;
+      if (keep < m_blocks.size())
+         m_blocks.resize(keep);
+   }
+
+   /// \internal releases unused blocks from the back, until the blocks kept have at most \c capacity bytes
+   void PathArena::TrimTo(size_t capacity)
+   {
+      size_t keep = m_top.offset ? m_top.block + 1 : m_top.block;
+      size_t total = Capacity();
+      while (m_blocks.size() > keep && total > capacity)
+      {
+         total -= m_blocks.back().size;
+         m_blocks.pop_back();
+      }
+   }
+
+   /// \internal inserts a block of at least \c minSize bytes after the current one, and makes it the current block
+   void PathArena::AddBlock(size_t minSize)
+   {
+      size_t size = std::max(minSize, MinBlockSize);
+      if (!m_blocks.empty())
+         size = std::max(size, 2 * m_blocks[std::min(m_top.block, m_blocks.size() - 1)].size);
+
+      Block block;
+      block.data.reset(new std::byte[size]);
+      block.size = size;
+
+      size_t at = m_blocks.empty() ? 0 : m_top.block + (m_top.offset ? 1 : 0);
+      m_blocks.insert(m_blocks.begin() + at, std::move(block));
+      m_top.block = at;
+      m_top.offset = 0;
+   }
+
+   void * PathArena::do_allocate(size_t bytes, size_t alignment)
+   {
+      if (bytes > LargeAllocation)
+         return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+
+      // the current block, or the next one that is large enough
+      while (m_top.block < m_blocks.size())
+      {
+         Block & block = m_blocks[m_top.block];
+         size_t offset = AlignUp(block.data.get(), m_top.offset, alignment);
+         if (offset + bytes <= block.size)
+         {
+            m_top.offset = offset + bytes;
+            return block.data.get() + offset;
+         }
+         if (m_top.block + 1 == m_blocks.size())
+            break;
+         ++m_top.block;
+         m_top.offset = 0;
+      }
+
+      AddBlock(bytes + alignment);
+      Block & block = m_blocks[m_top.block];
+      size_t offset = AlignUp(block.data.get(), 0, alignment);
+      m_top.offset = offset + bytes;
+      return block.data.get() + offset;
+   }
+
+   void PathArena::do_deallocate(void * p, size_t bytes, size_t alignment)
+   {
+      if (bytes > LargeAllocation)
+         std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+      // else: released when the scope ends
+   }
+
+   namespace YamlPathDetail
+   {
+      namespace
+      {
+         thread_local PathArena * t_scratch = nullptr;      // the arena of the innermost scope
+      }
+
+      /// \internal the default arena of the calling thread
+      PathArena & ThreadArena()
+      {
+         thread_local PathArena arena;
+         return arena;
+      }
+
+      ScratchScope::ScratchScope(PathContext const * context) 
+         : m_arena(context && context->Arena() ? context->Arena() : &ThreadArena()), m_previous(t_scratch), m_mark(m_arena->m_top)
+      {
+         t_scratch = m_arena;
+      }
+
+      ScratchScope::~ScratchScope()
+      {
+         m_arena->m_top = m_mark;
+         t_scratch = m_previous;
+         if (!m_mark.block && !m_mark.offset && m_arena == &ThreadArena())
+            m_arena->TrimTo(ThreadArenaRetained);      // the outermost scope using the thread arena
+      }
+
+      std::pmr::memory_resource * Scratch()
+      {
+         return t_scratch ? static_cast<std::pmr::memory_resource *>(t_scratch) : std::pmr::new_delete_resource();
+      }
+   }
+}
@@ -0,0 +1,194 @@
+/*
+MIT License
+
+Copyright(c) 2019 Peter Hauptmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "yaml-path.h"
+#include "yaml-path-internals.h"
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+/* Path cache for the string-based API (Select, Require, PathResolve)
+
+   The cache maps a path string to a compiled template (see CompiledPathData), so bound arguments are not part of the key.
+   It is split into shards, each with its own lock and LRU list, so that concurrent callers rarely wait for each other.
+*/
+
+namespace YAML
+{
+   namespace YamlPathDetail
+   {
+      class PathCache
+      {
+      public:
+         static const size_t ShardCount = 16;
+         static const size_t DefaultCapacity = 1024;
+
+         std::shared_ptr<CompiledPathData const> Get(PathArg path);
+         void SetCapacity(size_t capacity);
+         PathCacheStats Stats();
+         void Clear();
+
+      private:
+         using tEntry = std::shared_ptr<CompiledPathData const>;
+         struct Shard
+         {
+            std::mutex lock;
+            std::list<tEntry> lru;                                   // most recently used first
+            std::unordered_map<PathArg, std::list<tEntry>::iterator> index;   // keys refer to the path stored in the entry
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+         };
+
+         Shard m_shards[ShardCount];
+         std::atomic<size_t> m_capacity = DefaultCapacity;
+
+         size_t ShardCapacity() const { return (m_capacity + ShardCount - 1) / ShardCount; }
+         static void Trim(Shard & shard, size_t capacity);
+      };
+
+      /// \internal removes least recently used entries until \c shard holds at most \c capacity entries. Requires the shard lock to be held.
+      void PathCache::Trim(Shard & shard, size_t capacity)
+      {
+         while (shard.lru.size() > capacity)
+         {
+            shard.index.erase(shard.lru.back()->path);
+            shard.lru.pop_back();
+            ++shard.evictions;
+         }
+      }
+
+      std::shared_ptr<CompiledPathData const> PathCache::Get(PathArg path)
+      {
+         size_t capacity = ShardCapacity();
+         if (!capacity)
+            return nullptr;
+
+         Shard & shard = m_shards[std::hash<PathArg>()(path) % ShardCount];
+         {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            auto it = shard.index.find(path);
+            if (it != shard.index.end())
+            {
+               ++shard.hits;
+               shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+               return *it->second;
+            }
+            ++shard.misses;
+         }
+
+         // compile without holding the lock. If another thread added the same path meanwhile, its entry is used
+         auto cp = PathCompiler::CompileOwnedTemplate(path);
+
+         std::lock_guard<std::mutex> lock(shard.lock);
+         auto it = shard.index.find(path);
+         if (it != shard.index.end())
+            return *it->second;
+
+         shard.lru.push_front(cp);
+         shard.index.emplace(cp->path, shard.lru.begin());
+         Trim(shard, capacity);
+         return cp;
+      }
+
+      void PathCache::SetCapacity(size_t capacity)
+      {
+         m_capacity = capacity;
+         for (auto & shard : m_shards)
+         {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            Trim(shard, ShardCapacity());
+         }
+      }
+
+      PathCacheStats PathCache::Stats()
+      {
+         PathCacheStats stats;
+         stats.capacity = m_capacity;
+         for (auto & shard : m_shards)
+         {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            stats.hits += shard.hits;
+            stats.misses += shard.misses;
+            stats.evictions += shard.evictions;
+            stats.size += shard.lru.size();
+         }
+         return stats;
+      }
+
+      void PathCache::Clear()
+      {
+         for (auto & shard : m_shards)
+         {
+            std::lock_guard<std::mutex> lock(shard.lock);
+            shard.index.clear();
+            shard.lru.clear();
+            shard.hits = shard.misses = shard.evictions = 0;
+         }
+      }
+
+      PathCache & TheCache()
+      {
+         static PathCache cache;
+         return cache;
+      }
+
+      std::shared_ptr<CompiledPathData const> PathCacheGet(PathArg path)
+      {
+         return TheCache().Get(path);
+      }
+   }
+
+   using namespace YamlPathDetail;
+
+   /** Sets the maximum number of paths kept in the path cache.
+
+      The string-based \ref Select, \ref Require and \ref PathResolve look up the parsed path in a process-wide cache,
+      and parse a path only if it is not found. Paths containing bound arguments are cached as a template, 
+      so one entry is used for all argument values.
+
+      The cache is thread safe. It is split into shards, the capacity per shard is rounded up, so the cache may hold 
+      slightly more than \c capacity paths.\n
+      When the cache is full, the least recently used paths are removed. 
+      A capacity of 0 disables the cache (paths are parsed on every call). The default capacity is 1024.
+   */
+   void PathCacheSetCapacity(size_t capacity)
+   {
+      TheCache().SetCapacity(capacity);
+   }
+
+   /** returns hit, miss and eviction counts of the path cache, see \ref PathCacheSetCapacity */
+   PathCacheStats PathCacheGetStats()
+   {
+      return TheCache().Stats();
+   }
+
+   void PathCacheClear()
+   {
+      TheCache().Clear();
+   }
+}
@@ -0,0 +1,568 @@
+/*
+MIT License
+
+Copyright(c) 2019 Peter Hauptmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "yaml-path.h"
+#include "yaml-path-internals.h"
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/* Indexes for map filters (PathIndex, PathContext) and recursive key selectors (DocumentIndex)
+
+   An index maps the scalar values of one key to the positions of the maps in a sequence.
+   A document index maps each key to its values in all maps of a document, in document order. 
+   Lookups take a snapshot of the table under the index lock, so a rebuild (after Ensure modified a document)
+   does not invalidate a table that is still in use.
+
+   Indexes and caches register a DocumentWatch with the nodes they read. Ensure reports the nodes it modifies,
+   which outdates only the watches containing one of them: modifying one document does not rebuild the indexes of another.
+*/
+
+namespace YAML
+{
+   namespace YamlPathDetail
+   {
+      void const * NodeIdentity(Node const & node)
+      {
+         if (!node.IsDefined())
+            return nullptr;
+         void const * id = &node.Scalar();
+         return id == &detail::node_data::empty_scalar() ? nullptr : id;
+      }
+
+      namespace
+      {
+         std::mutex g_watchLock;
+         std::vector<std::weak_ptr<DocumentWatch>> g_watches;     // guarded by g_watchLock
+         std::atomic<size_t> g_watchCount = 0;
+      }
+
+      DocumentWatch::DocumentWatch() { ++g_watchCount; }
+      DocumentWatch::~DocumentWatch() { --g_watchCount; }
+
+      /// \internal watches \c nodes (in any order, \c nullptr is ignored) from now on, and returns the current generation
+      uint64_t DocumentWatch::Watch(std::vector<void const *> && nodes)
+      {
+         std::sort(nodes.begin(), nodes.end());
+         nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+         std::lock_guard<std::mutex> lock(this->lock);
+         this->nodes = std::move(nodes);
+         watching = true;
+         return generation;
+      }
+
+      /// \internal stops watching, e.g. when the owner discarded what it read
+      void DocumentWatch::Stop()
+      {
+         std::lock_guard<std::mutex> lock(this->lock);
+         nodes.clear();
+         watching = false;
+      }
+
+      /// \internal true if the node with the identity \c id is watched
+      bool DocumentWatch::Watches(void const * id)
+      {
+         std::lock_guard<std::mutex> lock(this->lock);
+         return watching && Contains(id);
+      }
+
+      /// \internal adds the identities of \c node and of all values and elements below it to \c nodes (but not of the keys)
+      void DocumentWatch::Collect(std::vector<void const *> & nodes, Node const & node)
+      {
+         nodes.push_back(NodeIdentity(node));
+         if (node.IsMap())
+            for (auto && kv : node)
+               Collect(nodes, kv.second);
+         else if (node.IsSequence())
+            for (auto && el : node)
+               Collect(nodes, el);
+      }
+
+      /// \internal creates a watch, which is notified by \ref DocumentModified as long as it exists
+      std::shared_ptr<DocumentWatch> WatchDocument()
+      {
+         auto watch = std::make_shared<DocumentWatch>();
+         std::lock_guard<std::mutex> lock(g_watchLock);
+         g_watches.erase(std::remove_if(g_watches.begin(), g_watches.end(), [](auto const & w) { return w.expired(); }), g_watches.end());
+         g_watches.push_back(watch);
+         return watch;
+      }
+
+      /// \internal true if any index or cache exists, i.e. if \ref Ensure needs to report the nodes it modifies
+      bool DocumentsWatched() { return g_watchCount != 0; }
+
+      /// \internal outdates the watches containing one of the \c count \c nodes (by \ref NodeIdentity), which were modified
+      void DocumentModified(void const * const * nodes, size_t count)
+      {
+         std::lock_guard<std::mutex> lock(g_watchLock);
+         for (auto && w : g_watches)
+         {
+            auto watch = w.lock();
+            if (!watch)
+               continue;
+
+            std::lock_guard<std::mutex> watchLock(watch->lock);
+            if (!watch->watching)
+               continue;   // already outdated
+            if (std::any_of(nodes, nodes + count, [&](void const * id) { return watch->Contains(id); }))
+            {
+               ++watch->generation;
+               watch->nodes.clear();
+               watch->watching = false;
+            }
+         }
+      }
+
+      /// \internal rebuilds the table. Requires \c lock to be held. Watches the sequence, its elements and the values of the key.
+      void PathIndexData::Rebuild()
+      {
+         std::vector<void const *> watched{ NodeIdentity(sequence) };
+
+         auto result = std::make_shared<PathIndexTable>();
+         if (sequence.IsSequence())
+         {
+            size_t pos = 0;
+            for (auto && el : static_cast<Node const &>(sequence))
+            {
+               Node value = FindKey(el, key);
+               watched.push_back(NodeIdentity(el));
+               watched.push_back(NodeIdentity(value));
+               if (value && value.IsScalar())
+               {
+                  auto && scalar = value.Scalar();
+                  auto it = result->positions.find(scalar);
+                  if (it == result->positions.end())
+                  {
+                     result->values.push_back(scalar);
+                     it = result->positions.emplace(result->values.back(), std::vector<size_t>()).first;
+                  }
+                  it->second.push_back(pos);
+               }
+               ++pos;
+            }
+         }
+         generation = watch->Watch(std::move(watched));
+         table = std::move(result);
+      }
+
+      /// \internal returns the current table, rebuilding it if the sequence was modified since it was built
+      std::shared_ptr<PathIndexTable const> PathIndexData::Table()
+      {
+         std::lock_guard<std::mutex> lock(this->lock);
+         if (!watch->Current(generation))
+            Rebuild();
+         return table;
+      }
+
+      /** \internal checks if \c filter can use an index from \c context when applied to \c sequence.
+
+         This is the case if each \c alternative group of conditions (see \ref OrderConditions) has an indexed condition 
+         <tt>key=value</tt> matching key and value exactly: a map not found by one of them cannot be selected. 
+         A single indexed condition returns the positions of the index. Otherwise, the positions of the conditions of a 
+         group are intersected, and the results of the groups are combined in a bitmap of the sequence, which gives 
+         the candidates in sequence order.
+         The candidates still need to be checked with \ref ApplyMapFilterToMap, which also applies the other conditions and the key selectors.
+      */
+      std::optional<IndexLookup> LookupIndex(PathContext const * context, Node const & sequence, ArgMapFilter const & filter)
+      {
+         if (!context)
+            return std::nullopt;
+
+         // the positions of the indexed conditions, by group
+         struct Hits { std::shared_ptr<PathIndexTable const> table; std::vector<size_t> const * positions = nullptr; size_t group = 0; };
+         ScratchVector<Hits> hits(Scratch());
+         size_t groups = 0;
+         for (auto group = filter.begin(); group != filter.end(); )
+         {
+            auto end = GroupEnd(group, filter.end());
+            if (group->op != EKVOp::Select && group->alternative)
+            {
+               size_t before = hits.size();
+               for (auto it = group; it != end; ++it)
+               {
+                  auto && cond = *it;
+                  if (cond.op != EKVOp::Equal || cond.key.starry || cond.key.noCase || cond.value.starry || cond.value.noCase)
+                     continue;
+                  auto index = context->FindIndex(sequence, cond.key.token);
+                  if (!index)
+                     continue;
+
+                  Hits & h = hits.emplace_back();
+                  h.table = PathIndexData::Of(*index).Table();
+                  h.group = groups;
+                  auto found = h.table->positions.find(cond.value.token);
+                  if (found != h.table->positions.end())
+                     h.positions = &found->second;
+               }
+               if (hits.size() == before)
+                  return std::nullopt;    // other maps could match this group
+               ++groups;
+            }
+            group = end;
+         }
+
+         if (hits.empty())
+            return std::nullopt;
+
+         IndexLookup result;
+         if (hits.size() == 1)
+         {
+            result.table = hits[0].table;
+            result.positions = hits[0].positions;
+            return result;
+         }
+
+         // a group matches only the positions all of its indexed conditions found
+         const size_t size = sequence.size();
+         ScratchVector<uint64_t> bits((size + 63) / 64, 0, Scratch());
+         for (size_t g = 0, k = 0; g < groups; ++g)
+         {
+            size_t end = k;
+            while (end < hits.size() && hits[end].group == g)
+               ++end;
+            auto shortest = std::min_element(hits.begin() + k, hits.begin() + end, [](Hits const & a, Hits const & b) 
+            {
+               return (a.positions ? a.positions->size() : 0) < (b.positions ? b.positions->size() : 0);
+            });
+            if (shortest->positions)
+            {
+               for (size_t pos : *shortest->positions)
+               {
+                  bool all = pos < size && std::all_of(hits.begin() + k, hits.begin() + end, [&](Hits const & h) 
+                  { 
+                     return &h == &*shortest || std::binary_search(h.positions->begin(), h.positions->end(), pos); 
+                  });
+                  if (all)
+                     bits[pos / 64] |= uint64_t(1) << (pos % 64);
+               }
+            }
+            k = end;
+         }
+
+         auto combined = std::make_shared<std::vector<size_t>>();
+         for (size_t word = 0; word < bits.size(); ++word)
+            for (size_t bit = 0; bit < 64 && bits[word] >> bit; ++bit)
+               if ((bits[word] >> bit) & 1)
+                  combined->push_back(word * 64 + bit);
+         if (!combined->empty())
+            result.positions = combined.get();
+         result.combined = std::move(combined);
+         return result;
+      }
+
+      namespace
+      {
+         /// \internal collects the containers and keys of a part of a document, keys refer to the document
+         struct KeyCollector
+         {
+            std::vector<DocumentIndexTable::Container> containers;
+            std::unordered_map<PathArg, std::vector<DocumentIndexTable::Entry>> keys;
+            std::vector<void const *> nodes;      // the identities of all nodes added, for the DocumentWatch
+
+            /// adds a container and the first value of each of its keys (as \ref FindKey finds it), returns its position
+            size_t Open(Node const & node)
+            {
+               size_t pos = containers.size();
+               containers.push_back({ node, 0 });
+               if (node.IsMap())
+               {
+                  for (auto && kv : node)
+                  {
+                     if (!kv.first.IsScalar())
+                        continue;
+                     auto & entries = keys[kv.first.Scalar()];
+                     if (entries.empty() || entries.back().container != pos)
+                        entries.push_back({ pos, kv.second });
+                  }
+               }
+               return pos;
+            }
+
+            void Add(Node const & node)
+            {
+               nodes.push_back(NodeIdentity(node));
+               if (!node.IsMap() && !node.IsSequence())
+                  return;
+
+               size_t pos = Open(node);
+               if (node.IsMap())
+                  for (auto && kv : node)
+                     Add(kv.second);
+               else
+                  for (auto && el : node)
+                     Add(el);
+               containers[pos].end = containers.size();
+            }
+
+            /// appends the collected part to \c table, in which it follows the containers already there. Copies the keys.
+            void MergeInto(DocumentIndexTable & table) const
+            {
+               size_t offset = table.containers.size();
+               for (auto && c : containers)
+                  table.containers.push_back({ c.node, c.end + offset });
+
+               for (auto && k : keys)
+               {
+                  auto it = table.keys.find(k.first);
+                  if (it == table.keys.end())
+                     it = table.keys.emplace(table.strings.emplace_back(k.first), std::vector<DocumentIndexTable::Entry>()).first;
+                  it->second.reserve(it->second.size() + k.second.size());
+                  for (auto && e : k.second)
+                     it->second.push_back({ e.container + offset, e.value });
+               }
+            }
+         };
+      }
+
+      /** \internal rebuilds the table. Requires \c lock to be held. 
+          With more than one thread, the subtrees of the root's children are collected in parallel, and merged in order.
+      */
+      void DocumentIndexData::Rebuild()
+      {
+         auto result = std::make_shared<DocumentIndexTable>();
+
+         std::vector<void const *> watched;
+         std::vector<Node> children;
+         size_t chunks = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+         if (chunks > 1)
+         {
+            if (root.IsMap())
+               for (auto && kv : static_cast<Node const &>(root))
+                  children.push_back(kv.second);
+            else if (root.IsSequence())
+               for (auto && el : static_cast<Node const &>(root))
+                  children.push_back(el);
+            chunks = std::min(chunks, children.size());
+         }
+
+         if (chunks <= 1)
+         {
+            KeyCollector all;
+            all.Add(root);
+            all.MergeInto(*result);
+            watched = std::move(all.nodes);
+         }
+         else
+         {
+            KeyCollector top;
+            top.Open(root);
+            std::vector<KeyCollector> parts(chunks);
+            ParallelChunks(children.size(), chunks, [&](size_t chunk, size_t begin, size_t end)
+            {
+               for (size_t i = begin; i < end; ++i)
+                  parts[chunk].Add(children[i]);
+            });
+
+            top.MergeInto(*result);
+            watched.push_back(NodeIdentity(root));
+            for (auto && part : parts)
+            {
+               part.MergeInto(*result);
+               watched.insert(watched.end(), part.nodes.begin(), part.nodes.end());
+            }
+            result->containers.front().end = result->containers.size();
+         }
+
+         result->positions.reserve(result->containers.size());
+         for (size_t pos = 0; pos < result->containers.size(); ++pos)
+            result->positions.emplace(NodeIdentity(result->containers[pos].node), pos);    // the first, for a node found through aliases
+
+         generation = watch->Watch(std::move(watched));
+         table = std::move(result);
+      }
+
+      /// \internal returns the current table, rebuilding it if the document was modified since it was built
+      std::shared_ptr<DocumentIndexTable const> DocumentIndexData::Table()
+      {
+         std::lock_guard<std::mutex> lock(this->lock);
+         if (!watch->Current(generation))
+            Rebuild();
+         return table;
+      }
+
+      /** \internal finds the values of \c key in \c node and below in a \ref DocumentIndex of \c context.
+          Returns \c std::nullopt if no index contains \c node, and an empty range if it contains no value of \c key.
+      */
+      std::optional<DocumentIndexLookup> LookupDocumentIndex(PathContext const * context, Node const & node, PathArg key)
+      {
+         if (!context || (!node.IsMap() && !node.IsSequence()))
+            return std::nullopt;
+
+         for (auto && index : context->DocumentIndexes())
+         {
+            auto table = DocumentIndexData::Of(index).Table();
+            auto found = table->positions.find(NodeIdentity(node));
+            if (found == table->positions.end())
+               continue;
+
+            DocumentIndexLookup result;
+            auto it = table->keys.find(key);
+            if (it != table->keys.end())
+            {
+               size_t first = found->second;
+               auto && entries = it->second;
+               auto ByContainer = [](DocumentIndexTable::Entry const & e, size_t pos) { return e.container < pos; };
+               auto begin = std::lower_bound(entries.begin(), entries.end(), first, ByContainer);
+               auto end = std::lower_bound(begin, entries.end(), table->containers[first].end, ByContainer);
+               result.begin = entries.data() + (begin - entries.begin());
+               result.end = entries.data() + (end - entries.begin());
+            }
+            result.table = std::move(table);
+            return result;
+         }
+         return std::nullopt;
+      }
+   }
+
+   using namespace YamlPathDetail;
+
+   /** Creates an index of the maps in \c sequence by the value of \c key. 
+       If \c sequence is not a sequence, the index is empty.
+   */
+   PathIndex::PathIndex(Node sequence, PathArg key) : m_data(std::make_shared<PathIndexData>())
+   {
+      if (sequence)
+         m_data->sequence.reset(sequence);
+      m_data->key = std::string(key);
+      m_data->Rebuild();
+   }
+
+   Node PathIndex::Sequence() const
+   {
+      return m_data->sequence;
+   }
+
+   PathArg PathIndex::Key() const
+   {
+      return m_data->key;
+   }
+
+   std::vector<size_t> PathIndex::Find(PathArg value) const
+   {
+      auto table = m_data->Table();
+      auto it = table->positions.find(value);
+      return it == table->positions.end() ? std::vector<size_t>() : it->second;
+   }
+
+   void PathIndex::Rebuild()
+   {
+      std::lock_guard<std::mutex> lock(m_data->lock);
+      m_data->Rebuild();
+   }
+
+   PathIndex PathContext::AddIndex(Node sequence, PathArg key)
+   {
+      if (auto index = FindIndex(sequence, key))
+         return *index;
+
+      m_indexes.emplace_back(sequence, key);
+      return m_indexes.back();
+   }
+
+   /** adds an existing index, e.g. to share it between contexts. 
+       An index for the same sequence and key is replaced.
+   */
+   void PathContext::AddIndex(PathIndex const & index)
+   {
+      for (auto && existing : m_indexes)
+      {
+         if (existing.m_data->sequence.is(index.m_data->sequence) && existing.m_data->key == index.m_data->key)
+         {
+            existing = index;
+            return;
+         }
+      }
+      m_indexes.push_back(index);
+   }
+
+   PathIndex const * PathContext::FindIndex(Node const & sequence, PathArg key) const
+   {
+      for (auto && index : m_indexes)
+         if (index.m_data->sequence.is(sequence) && index.m_data->key == key)
+            return &index;
+      return nullptr;
+   }
+
+   DocumentIndex::DocumentIndex(Node root, size_t threads) : m_data(std::make_shared<DocumentIndexData>())
+   {
+      if (root)
+         m_data->root.reset(root);
+      m_data->threads = threads;
+      m_data->Rebuild();
+   }
+
+   Node DocumentIndex::Root() const
+   {
+      return m_data->root;
+   }
+
+   std::vector<Node> DocumentIndex::Find(PathArg key) const
+   {
+      auto table = m_data->Table();
+      auto it = table->keys.find(key);
+      std::vector<Node> result;
+      if (it != table->keys.end())
+         for (auto && e : it->second)
+            result.push_back(e.value);
+      return result;
+   }
+
+   void DocumentIndex::Rebuild()
+   {
+      std::lock_guard<std::mutex> lock(m_data->lock);
+      m_data->Rebuild();
+   }
+
+   DocumentIndex PathContext::AddDocumentIndex(Node root, size_t threads)
+   {
+      if (auto index = FindDocumentIndex(root))
+         return *index;
+
+      m_documentIndexes.emplace_back(root, threads);
+      return m_documentIndexes.back();
+   }
+
+   /// adds an existing key index, an index for the same root is replaced
+   void PathContext::AddIndex(DocumentIndex const & index)
+   {
+      for (auto && existing : m_documentIndexes)
+      {
+         if (existing.m_data->root.is(index.m_data->root))
+         {
+            existing = index;
+            return;
+         }
+      }
+      m_documentIndexes.push_back(index);
+   }
+
+   DocumentIndex const * PathContext::FindDocumentIndex(Node const & root) const
+   {
+      for (auto && index : m_documentIndexes)
+         if (index.m_data->root.is(root))
+            return &index;
+      return nullptr;
+   }
+}
@@ -29,8 +29,17 @@ SOFTWARE.
 
 
 #include "yaml-path.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
 #include <sstream>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
@@ -73,21 +82,39 @@ namespace YAML
          Asterisk,
          Tilde, 
          Comma,
+         Minus,
+         Ampersand,
+         Dollar,
       };
       /* when adding a new token, also add to:
             - MapETokenName
             - ValidTokensAtStart, if applicable
             - TokenData, if a new data type is required
-            - PathScanner::NextToken, to recognize it
+            - MakeCharTable, if it is a single-char token, or PathScanner::NextToken, to recognize it
             - PathScanner::NextSelector, to process it
       */
 
+      /// \internal classification of a path character for the token scanner, see \ref CharClass
+      struct CharInfo
+      {
+         EToken token = EToken::None;     ///< the single-char token starting with this char, or \c EToken::None
+         bool identifier = false;         ///< part of an unquoted identifier: non-ascii, or neither whitespace nor punctuation
+         bool space = false;              ///< whitespace, skipped between tokens
+      };
+
+      /// \internal returns the classification of \c c, taken from a table built at compile time
+      constexpr CharInfo const & CharClass(char c);
+
+      /// \internal marks a token or selector argument that was not taken from a bound argument
+      constexpr size_t NoBoundArg = size_t(-1);
+
       /// \internal data for one token, see \ref PathScanner
       struct TokenData
       {
          EToken   id = EToken::None;
          PathArg value;
          size_t index = 0;
+         size_t arg = NoBoundArg;      ///< bound argument index, if the token is a placeholder for a deferred argument
       };
 
       /// \internal Selectors supported by the selector level parser of \ref PathScanner
@@ -98,14 +125,80 @@ namespace YAML
          Key,
          Index,
          MapFilter,
+         RecursiveKey,     // "..key" or "**.key", data is ArgKey
+         Slice,            // "[first-last,step]", data is ArgSlice
+         TypeCheck,        // "!ismap", data is ArgNodeType
+         TypeFilter,       // "[$ismap]", data is ArgNodeType
       };
 
       // Data for different selector types
+      // (\c arg, \c keyArg and \c valueArg refer to a deferred bound argument that replaces the respective token, see \ref PathScanner::DeferArgs)
       struct ArgNull {};
-      struct ArgKey { PathArg key; };
-      struct ArgIndex { size_t index; };
-      struct ArgKVPair { KVToken key; KVToken value; EKVOp op = EKVOp::Equal; };
-      using ArgMapFilter = std::vector<ArgKVPair>;
+      struct ArgKey { PathArg key; size_t arg = NoBoundArg; };
+      struct ArgIndex { size_t index; size_t arg = NoBoundArg; };
+      /// \internal the positions <tt>first, first + step, ...</tt> up to \c last of a slice. If \c required, all of them must exist.
+      struct ArgSlice
+      {
+         size_t first = 0;
+         size_t last = 0;
+         size_t step = 1;
+         bool required = false;
+         size_t firstArg = NoBoundArg;
+         size_t lastArg = NoBoundArg;
+         size_t stepArg = NoBoundArg;
+
+         bool Valid() const { return step > 0 && first <= last; }
+         size_t Last() const { return first + (last - first) / step * step; }    ///< the last position selected
+         size_t Position(size_t k) const { return first + k * step; }           ///< the position of the k-th element selected
+         /// the number of positions selected from \c size elements, 0 if the slice is \c required and not all of its positions exist
+         size_t Count(size_t size) const { return first >= size || (required && Last() >= size) ? 0 : (std::min(last, size - 1) - first) / step + 1; }
+      };
+      /// \internal the node type of a type predicate: "ismap", "isseq" or "isscalar"
+      struct ArgNodeType { NodeType::value type = NodeType::Undefined; };
+
+      /// \internal the node type tested by the type predicate \c name, \c NodeType::Undefined if \c name is not a type predicate
+      constexpr NodeType::value PredicateType(PathArg name)
+      {
+         return name == "ismap" ? NodeType::Map : name == "isseq" ? NodeType::Sequence : name == "isscalar" ? NodeType::Scalar : NodeType::Undefined;
+      }
+
+      /// \internal a condition or key selection of a map filter
+      struct ArgKVPair 
+      { 
+         KVToken key; 
+         KVToken value; 
+         EKVOp op = EKVOp::Equal; 
+         size_t keyArg = NoBoundArg; 
+         size_t valueArg = NoBoundArg; 
+         PathArg keyFolded;      ///< ASCII-lowercase copy of a \c noCase key token, precomputed by \ref PathCompiler
+         PathArg valueFolded;    ///< ASCII-lowercase copy of a \c noCase value token, precomputed by \ref PathCompiler
+         bool alternative = true;      ///< a match of this condition selects the map (if the required keys are present), see \ref OrderConditions
+         bool lastAlternative = false; ///< no alternative follows in the order of \ref OrderConditions
+         bool joined = false;          ///< joined to the next condition by "&": the conditions of a group match together
+         NodeType::value valueType = NodeType::Undefined;   ///< a key selection "$ismap": selects the keys with a value of this type
+      };
+      using ArgMapFilter = std::pmr::vector<ArgKVPair>;     ///< (a pmr vector, so bound copies can use scratch memory, see \ref PathCompiler::BindArgs)
+
+      void OrderConditions(ArgMapFilter & filter);
+
+      /// \internal the end of the group of conditions starting at \c begin, see \ref ArgKVPair::joined
+      template <typename TIterator>
+      TIterator GroupEnd(TIterator begin, TIterator end)
+      {
+         while (begin != end && (begin++)->joined)
+            ;
+         return begin;
+      }
+
+      /// \internal scan state for a deferred bound argument, to report errors when the argument does not match the token expected
+      struct ArgSlot
+      {
+         EToken expected = EToken::QuotedIdentifier;    ///< \c EToken::Index for \c size_t arguments, \c EToken::QuotedIdentifier for \c PathArg
+         uint64_t validTokens = 0;                      ///< tokens accepted at the position of the argument
+         EPathError error = EPathError::InvalidToken;   ///< error reported if the argument type does not match
+         size_t offsSelector = 0;
+         size_t offsToken = 0;
+      };
 
       /** \internal progressive scanner/parser for a YAML path as specified by YAML::Select
          This class implements two layers of the scan: 
@@ -123,12 +216,13 @@ namespace YAML
       class PathScanner
       {
       public:
-         using tSelectorData = std::variant<ArgNull, ArgKey, ArgIndex, ArgMapFilter>;  ///< union of the selector data for all selector types
+         using tSelectorData = std::variant<ArgNull, ArgKey, ArgIndex, ArgMapFilter, ArgSlice, ArgNodeType>;  ///< union of the selector data for all selector types
 
       private:
          PathArg    m_rpath;        // remainder of path to be scanned
-         PathBoundArgs m_args;      // list of arguments that should be used as tokens
-         size_t     m_argIdx;       // next argument index to fetch
+         PathBoundArg const * m_args = nullptr;    // list of arguments that should be used as tokens
+         size_t     m_argCount = 0;
+         size_t     m_argIdx = 0;   // next argument index to fetch
          TokenData  m_curToken;
 
          ESelector      m_selector = ESelector::None;
@@ -139,7 +233,11 @@ namespace YAML
 
          EPathError     m_error = EPathError::OK;
          PathArg       m_fullPath;
-         PathException * m_diags = nullptr;
+         PathException * m_diags = nullptr;          ///< if not null, receives the diagnostics when an error occurs
+         size_t         m_offsSelector = 0;           ///< scan offset at the start of the current selector
+         size_t         m_offsToken = 0;              ///< scan offset after the last valid token
+         std::optional<size_t> m_fromBoundArg;        ///< index of the last bound argument fetched
+         std::vector<ArgSlot> * m_argSlots = nullptr;    ///< if not null, bound arguments are deferred
 
          TokenData const & SetToken(EToken id, PathArg p);
          TokenData const & SetToken(EToken id, size_t index);
@@ -155,16 +253,28 @@ namespace YAML
          void SkipWS();
          bool NextSelectorToken(uint64_t validTokens, EPathError error = EPathError::InvalidToken);
          bool PeekSelectorToken(uint64_t validTokens);
-         bool ReadKVToken(KVToken & result, uint64_t endTokens);
+         bool ReadKVToken(KVToken & result, uint64_t endTokens, size_t & arg);
+         ESelector ReadRecursiveKey();
+         ESelector ReadSlice(ArgIndex first, bool required);
+         bool ReadTypePredicate(NodeType::value & type);
 
       public:
          PathScanner(PathArg p, PathBoundArgs args = {}, PathException * diags = nullptr);
+         PathScanner(PathArg p, PathBoundArg const * args, size_t argCount, PathException * diags = nullptr);
 
          explicit operator bool() const { return !m_rpath.empty() && m_error == EPathError::OK; }
 
+         /** Instead of fetching bound arguments, "%" tokens become placeholders that remember the argument index.
+             For each argument, \c slots receives the information needed to bind it later, see \ref CompiledPathData.
+         */
+         void DeferArgs(std::vector<ArgSlot> & slots) { m_argSlots = &slots; }
+
          auto Error() const            { return m_error; }
          auto const & Right() const    { return m_rpath; }                             ///< remainder (unscanned part)
          size_t ScanOffset() const     { return m_fullPath.length() - m_rpath.length(); }        ///< token scanner position
+         size_t SelectorOffset() const { return m_offsSelector; }                      ///< scan offset at the start of the current selector
+         size_t TokenOffset() const    { return m_offsToken; }                         ///< scan offset after the last valid token
+         auto BoundArg() const         { return m_fromBoundArg; }                      ///< index of the last bound argument fetched, if any
 
          // -----token-level scanner
          TokenData const & NextToken();
@@ -181,9 +291,389 @@ namespace YAML
          // for access by utility functions to record an error
          EPathError SetError(EPathError error, uint64_t validTypes = 0);
 
-         inline static const uint64_t ValidTokensAtStart = BitsOf({ EToken::FetchArg, EToken::None, EToken::OpenBracket, EToken::OpenBrace,  EToken::QuotedIdentifier, EToken::UnquotedIdentifier });
+         inline static const uint64_t ValidTokensAtStart = BitsOf({ EToken::FetchArg, EToken::None, EToken::OpenBracket, EToken::OpenBrace,  EToken::QuotedIdentifier, EToken::UnquotedIdentifier, EToken::Period, EToken::Asterisk, EToken::Exclamation });
+      };
+
+      /// \internal scan state after a selector was read, allows to generate diagnostics for a compiled path without scanning it again
+      struct SelectorDiags
+      {
+         size_t offsRight = 0;         ///< scan offset before the selector was read, i.e. the remainder returned by \ref PathResolve if the selector fails
+         size_t offsSelector = 0;      ///< selector scan offset, as recorded in \ref PathException
+         size_t offsToken = 0;         ///< token scan offset, as recorded in \ref PathException
+         std::optional<size_t> fromBoundArg;
+      };
+
+      /// \internal a selector stored in a \ref CompiledPathData
+      struct PathSelector
+      {
+         ESelector selector = ESelector::None;
+         PathScanner::tSelectorData data;
+         SelectorDiags diags;
+         bool deferredArgs = false;             ///< \c data contains placeholders for bound arguments, see \ref PathCompiler::BindArgs
+      };
+
+      /** \internal the result of parsing a path with \ref PathScanner, see \ref CompiledPath
+
+         String tokens in \c selectors refer to \c path or to the bound arguments used for scanning.
+         \ref CompiledPath owns copies of both, the string-based API compiles into a temporary \c CompiledPathData
+         that refers to the caller's arguments.
+
+         A <i>template</i> is compiled without arguments: "%" tokens become placeholders, 
+         and the arguments are bound when the path is resolved (\c argSlots contains one entry for each placeholder).
+         This allows the path cache to use one entry for all argument sets.
+      */
+      struct CompiledPathData
+      {
+         PathArg path;                          ///< the full path
+         std::vector<PathSelector> selectors;   ///< all valid selectors from the start of the path
+         PathException error;                   ///< path error after the last valid selector, if any
+         size_t errorRight = 0;                 ///< scan offset before the malformed selector
+         std::vector<ArgSlot> argSlots;         ///< placeholders of a template
+
+         // storage used by CompiledPath
+         std::string pathStorage;
+         std::deque<std::string> argStorage;
+         std::deque<std::string> foldedStorage; ///< targets of \ref ArgKVPair::keyFolded and \ref ArgKVPair::valueFolded
+         std::vector<PathBoundArg> args;
+      };
+
+      /// \internal creates \ref CompiledPathData, and maps resolution errors to diagnostics
+      class PathCompiler
+      {
+      public:
+         static void Compile(CompiledPathData & cp, PathArg path, PathBoundArg const * args, size_t argCount);
+         static void CompileTemplate(CompiledPathData & cp, PathArg path);
+         static void Compile(CompiledPathData & cp, PathScanner & scan, PathArg path);
+         static void FoldTokens(CompiledPathData & cp, ArgMapFilter & filter);
+         static CompiledPath CompileOwned(PathArg path, PathBoundArgs args);
+         static std::shared_ptr<CompiledPathData const> CompileOwnedTemplate(PathArg path);
+         static EPathError BindArgs(CompiledPathData const & cp, PathSelector const & selector, PathBoundArg const * args, size_t argCount, PathScanner::tSelectorData & bound, PathException * px);
+         static CompiledPathData const * Data(CompiledPath const & path) { return path.m_data.get(); }
+
+         static EPathError SetNodeError(CompiledPathData const & cp, PathSelector const * selector, EPathError error, PathException * px);
+         static EPathError SetPathError(CompiledPathData const & cp, PathException * px);
+      };
+
+      /** \internal makes a \ref PathArena the scratch memory of the calling thread, until the scope ends.
+
+          Opened by the API functions that resolve paths. The scratch memory allocated in the scope is reused when the scope ends,
+          so nothing allocated from \ref Scratch may outlive it. Scopes nest, e.g. for a \ref Select in a \ref SelectEach callback.
+      */
+      class ScratchScope
+      {
+      public:
+         explicit ScratchScope(PathContext const * context);
+         ~ScratchScope();
+         ScratchScope(ScratchScope const &) = delete;
+         ScratchScope & operator=(ScratchScope const &) = delete;
+
+      private:
+         PathArena * m_arena;
+         PathArena * m_previous;
+         PathArena::Mark m_mark;
+      };
+
+      /// \internal the scratch memory of the calling thread: the arena of the innermost \ref ScratchScope, or the heap outside of a scope
+      std::pmr::memory_resource * Scratch();
+
+      PathArena & ThreadArena();
+      constexpr size_t ThreadArenaRetained = PathArena::LargeAllocation;   ///< \internal the most bytes the thread arena keeps between calls
+
+      template <typename T>
+      using ScratchVector = std::pmr::vector<T>;   ///< \internal a vector for scratch data, constructed with \ref Scratch
+
+      /** \internal the nodes selected by a selector that fans out over a sequence.
+
+          A node set is used as the intermediate result of a path: the following selectors treat it like a sequence node, 
+          but no YAML sequence has to be created for it. \c Node::push_back into an empty node grows yaml-cpp's node vector
+          one element at a time, and each push merges the memory of the source document into the result.
+
+          \ref ToNode creates the YAML sequence for \ref Select, \ref SelectEach does not need a node set, see \ref PathStream.
+      */
+      class NodeSet
+      {
+      public:
+         using const_iterator = ScratchVector<Node>::const_iterator;
+
+         NodeSet() : m_nodes(Scratch()) {}
+         explicit NodeSet(std::pmr::memory_resource * resource) : m_nodes(resource) {}
+         NodeSet(NodeSet const & other) : m_nodes(other.m_nodes, other.m_nodes.get_allocator()) {}
+         NodeSet(NodeSet &&) = default;
+         NodeSet & operator=(NodeSet const &) = default;
+         NodeSet & operator=(NodeSet &&) = default;
+
+         void Reserve(size_t n)              { m_nodes.reserve(n); }
+         void Add(Node const & node)         { m_nodes.push_back(node); }
+         bool Empty() const                  { return m_nodes.empty(); }
+         size_t Size() const                 { return m_nodes.size(); }
+         Node const & operator[](size_t index) const { return m_nodes[index]; }
+         const_iterator begin() const        { return m_nodes.begin(); }
+         const_iterator end() const          { return m_nodes.end(); }
+         void Clear()                        { m_nodes.clear(); }
+
+         Node ToNode() const;
+
+      private:
+         ScratchVector<Node> m_nodes;
+      };
+
+      Node FindKey(Node const & node, PathArg key);
+      std::mutex & MemoryLock();
+
+      /// \internal ASCII-lowercase copy of \c s. Non-ASCII bytes are left unchanged.
+      std::string FoldCase(PathArg s);
+
+      /// \internal compares the \c len bytes at \c s, ignoring ASCII case, to \c folded, which is already lowercase
+      bool EqualFolded(char const * s, char const * folded, size_t len);
+
+      /** \internal matches a scalar \c node against \c tok, reading the scalar in place.
+          For a \c noCase token, \c folded is the precomputed lowercase token; if it is empty, the token is folded on the fly.
+      */
+      bool StrIsMatch(KVToken const & tok, PathArg folded, Node const & node);
+
+      /** \internal returns an address identifying the data of \c node, as compared by \c Node::is, or \c nullptr for a node without data.
+          yaml-cpp keeps a scalar string for maps and sequences, too, and returns it by reference.
+      */
+      void const * NodeIdentity(Node const & node);
+
+      /** \internal the nodes an index or a cache depends on, to detect their modification by \ref Ensure (see \ref DocumentModified).
+
+          The owner sets the nodes when it reads them, and compares the generation \ref Watch returned with \c generation when it is used.
+          After a modification, no nodes are watched until the owner sets them again.
+      */
+      struct DocumentWatch
+      {
+         std::atomic<uint64_t> generation = 0;  ///< counts the modifications of the watched nodes
+         std::mutex lock;
+         std::vector<void const *> nodes;       ///< by \ref NodeIdentity, sorted
+         bool watching = false;
+
+         DocumentWatch();
+         ~DocumentWatch();
+         uint64_t Watch(std::vector<void const *> && nodes);
+         void Stop();
+         bool Current(uint64_t g) const { return generation == g; }
+         bool Contains(void const * id) const { return std::binary_search(nodes.begin(), nodes.end(), id); }
+         bool Watches(void const * id);
+
+         static void Collect(std::vector<void const *> & nodes, Node const & node);
+      };
+
+      std::shared_ptr<DocumentWatch> WatchDocument();
+      bool DocumentsWatched();
+      void DocumentModified(void const * const * nodes, size_t count);
+
+      /** \internal collects the nodes \ref Ensure modifies, and outdates the indexes and caches watching them (see \ref DocumentModified) 
+          when it goes out of scope, also if \c Ensure fails. Nothing is collected if no nodes are watched, or if \c track is \c false.
+          Requires a \ref ScratchScope.
+      */
+      class DocumentChanges
+      {
+      public:
+         explicit DocumentChanges(bool track = true) : m_track(track && DocumentsWatched()), m_nodes(Scratch()) {}
+         ~DocumentChanges() { if (!m_nodes.empty()) DocumentModified(m_nodes.data(), m_nodes.size()); }
+         DocumentChanges(DocumentChanges const &) = delete;
+         DocumentChanges & operator=(DocumentChanges const &) = delete;
+
+         /// records that \c node is about to be modified: a child is added, or it is assigned
+         void Modified(Node const & node)
+         {
+            if (!m_track)
+               return;
+            void const * id = NodeIdentity(node);
+            if (id && (m_nodes.empty() || m_nodes.back() != id))
+               m_nodes.push_back(id);
+         }
+
+      private:
+         bool m_track;
+         ScratchVector<void const *> m_nodes;
+      };
+
+      /// \internal the positions of the elements of an indexed sequence, by value. Keys refer to \c values.
+      struct PathIndexTable
+      {
+         std::unordered_map<PathArg, std::vector<size_t>> positions;
+         std::deque<std::string> values;
+      };
+
+      /// \internal shared state of \ref PathIndex copies
+      struct PathIndexData
+      {
+         Node sequence;
+         std::string key;
+         std::mutex lock;
+         std::shared_ptr<PathIndexTable const> table;
+         std::shared_ptr<DocumentWatch> watch = WatchDocument();
+         uint64_t generation = 0;      ///< the generation of \c watch when \c table was built
+
+         std::shared_ptr<PathIndexTable const> Table();
+         void Rebuild();
+
+         static PathIndexData & Of(PathIndex const & index) { return *index.m_data; }
+      };
+
+      /** \internal candidates for a map filter on an indexed sequence, see \ref LookupIndex. 
+          \c positions is \c nullptr if no element matches.
+      */
+      struct IndexLookup
+      {
+         std::shared_ptr<PathIndexTable const> table;    // keeps positions alive
+         std::vector<size_t> const * positions = nullptr;
+         std::shared_ptr<std::vector<size_t> const> combined;    // the positions of several conditions, if not from a single index
+      };
+
+      std::optional<IndexLookup> LookupIndex(PathContext const * context, Node const & sequence, ArgMapFilter const & filter);
+
+      /// \internal the keys of a document, see \ref DocumentIndex
+      struct DocumentIndexTable
+      {
+         /// a map or sequence, \c end is the position after the last container below it
+         struct Container { Node node; size_t end = 0; };
+         /// the value of a key in the map at position \c container
+         struct Entry { size_t container = 0; Node value; };
+
+         std::vector<Container> containers;                       ///< the maps and sequences of the document, in document order
+         std::unordered_map<void const *, size_t> positions;     ///< the position of each container in \c containers, by \ref NodeIdentity
+         std::unordered_map<PathArg, std::vector<Entry>> keys;    ///< by key, in document order. Keys refer to \c strings.
+         std::deque<std::string> strings;
+      };
+
+      /// \internal shared state of \ref DocumentIndex copies
+      struct DocumentIndexData
+      {
+         Node root;
+         size_t threads = 1;
+         std::mutex lock;
+         std::shared_ptr<DocumentIndexTable const> table;
+         std::shared_ptr<DocumentWatch> watch = WatchDocument();
+         uint64_t generation = 0;      ///< the generation of \c watch when \c table was built
+
+         std::shared_ptr<DocumentIndexTable const> Table();
+         void Rebuild();
+
+         static DocumentIndexData & Of(DocumentIndex const & index) { return *index.m_data; }
+      };
+
+      /// \internal the values of a key below a node, found in a \ref DocumentIndex, see \ref LookupDocumentIndex
+      struct DocumentIndexLookup
+      {
+         std::shared_ptr<DocumentIndexTable const> table;         // keeps the entries alive
+         DocumentIndexTable::Entry const * begin = nullptr;
+         DocumentIndexTable::Entry const * end = nullptr;
+      };
+
+      std::optional<DocumentIndexLookup> LookupDocumentIndex(PathContext const * context, Node const & node, PathArg key);
+      bool VisitDescendantKeys(Node const & node, PathArg key, PathContext const * context, NodeVisitor const & visitor);
+
+      template <typename TElements>
+      EPathError FanOutKey(TElements const & elements, PathArg key, NodeSet & result);
+
+      Node UndefinedNode();
+      EPathError ApplySelector(Node & node, NodeSet & nodes, ESelector selector, PathScanner::tSelectorData const & data, PathContext const * context, uint64_t * keysScanned = nullptr);
+      EPathError Materialize(Node & node, NodeSet const & nodes, EPathError err);
+
+      /** \internal reports the resolution of one path to the \ref PathTracer of a context.
+
+          Without a tracer, the members only test for it. \c node and \c nodes are the current result, as in \ref ResolveNodes.
+      */
+      class PathTraceScope
+      {
+      public:
+         PathTraceScope(PathContext const * context, PathArg path);
+
+         uint64_t * KeysScanned()     { return m_tracer ? &m_selector.keysScanned : nullptr; }   ///< the counter passed to \ref ApplySelector
+
+         void BeginSelector(size_t position, ESelector selector, Node const & node, NodeSet const & nodes) { if (m_tracer) Begin(position, selector, node, nodes); }
+         void EndSelector(Node const & node, NodeSet const & nodes, EPathError err)                    { if (m_tracer) End(node, nodes, err); }
+         EPathError EndPath(EPathError err, size_t output)                                             { if (m_tracer) End(err, output); return err; }
+         EPathError EndPath(EPathError err, Node const & node, NodeSet const & nodes)                  { return m_tracer ? EndPath(err, err == EPathError::OK ? Count(node, nodes) : 0) : err; }
+
+      private:
+         using Clock = std::chrono::steady_clock;
+
+         PathTracer * m_tracer = nullptr;
+         PathTrace m_path;
+         PathSelectorTrace m_selector;
+         Clock::time_point m_pathStart;
+         Clock::time_point m_selectorStart;
+
+         static size_t Count(Node const & node, NodeSet const & nodes) { return nodes.Empty() ? (node ? 1 : 0) : nodes.Size(); }
+         void Begin(size_t position, ESelector selector, Node const & node, NodeSet const & nodes);
+         void End(Node const & node, NodeSet const & nodes, EPathError err);
+         void End(EPathError err, size_t output);
+      };
+
+      /** \internal resolves a valid path depth-first, passing each selected node to a visitor as soon as it is found.
+
+          The result of a fan-out selector is never collected: each match runs through the following selectors 
+          before the next element is inspected. The following key and map filter selectors apply to each element 
+          (as they would to the elements of the sequence created by \ref Select), an index selector picks the 
+          n-th element that reaches it, and stops the fan-out. A slice selector counts the elements reaching it 
+          the same way, and stops the fan-out after its last position.
+
+          Resolution stops as soon as the visitor returns \c false, so e.g. \ref SelectExists inspects only 
+          the elements up to the first match.\n
+          \ref SelectStream continues with \ref Single and \ref Element on the subtrees it builds from parser events.
+      */
+      class PathStream
+      {
+      public:
+         PathStream(CompiledPathData const & cp, NodeVisitor const & visitor, PathContext const * context) : m_cp(cp), m_visitor(visitor), m_context(context) {}
+
+         bool Bind(PathBoundArg const * args, size_t argCount);
+         size_t Run(Node const & node);
+
+         PathScanner::tSelectorData const & Data(size_t i) const { return m_cp.selectors[i].deferredArgs ? m_bound[i] : m_cp.selectors[i].data; }
+         bool Single(size_t i, Node const & node);
+         bool Element(size_t i, Node element, size_t & index);
+         void BeginFanOut(size_t i);
+         size_t Visited() const { return m_visited; }
+
+      private:
+         /// the elements a slice selector has counted in the current fan-out, and the elements held back by a required slice
+         struct SliceState
+         {
+            size_t position = 0;
+            ScratchVector<Node> pending{ Scratch() };
+         };
+
+         CompiledPathData const & m_cp;
+         NodeVisitor const & m_visitor;
+         PathContext const * m_context;
+         ScratchVector<PathScanner::tSelectorData> m_bound{ Scratch() };   // selector data with bound arguments, for the selectors with deferred arguments
+         ScratchVector<SliceState> m_slices{ Scratch() };                  // by selector, allocated for the first slice applied to a fan-out
+         size_t m_visited = 0;
+
+         bool Visit(Node const & node)  { ++m_visited; return m_visitor(node); }
+         SliceState & Slice(size_t i);
       };
 
+      /// \internal the data of a path for \ref SelectStream: throws the path error of a malformed path, an empty path selects the whole document
+      CompiledPathData const & StreamPathData(CompiledPath const & path);
+
+      /** \internal runs \c cp on the events of the next document in \c input, see \ref SelectStream. 
+          Adds the number of visited nodes to \c visited. Returns \c false if there is no document.
+      */
+      bool StreamDocument(std::istream & input, CompiledPathData const & cp, NodeVisitor const & visitor, size_t & visited, PathContext const * context);
+
+      /** \internal the end of the document in \c yaml that starts at \c begin, for splitting a stream without parsing it. 
+
+          A document ends after a line starting with a document end marker <tt>...</tt>, or before a line starting with 
+          a document start marker <tt>---</tt>, unless only directives, comments and blank lines precede it: they belong to the document it starts.
+          YAML does not allow these markers at the start of a line inside a document, e.g. in a block scalar.
+      */
+      size_t DocumentEnd(std::string_view yaml, size_t begin);
+
+      // Ensure steps, shared by \ref Ensure and \ref EnsureMany
+      bool EnsureSupports(ArgKVPair const & kvp);
+      void EnsureNodeExists(Node & node);
+      void EnsureSequenceSize(Node & el, size_t size, DocumentChanges & changes);
+      EPathError EnsureSelector(ScratchVector<Node> & next, ESelector selector, PathScanner::tSelectorData const & data, DocumentChanges & changes);
+
+      /// \internal returns the compiled template for \c path from the path cache, compiling it if necessary. Returns \c nullptr if the cache is disabled.
+      std::shared_ptr<CompiledPathData const> PathCacheGet(PathArg path);
+
       template <typename T2, typename TEnum>
       T2 MapValue(TEnum value, std::initializer_list<std::pair<TEnum, T2>> values, T2 dflt = T2());
 
@@ -221,9 +711,47 @@ namespace YAML
       template<typename TBits, typename TValue>
       bool constexpr BitsContain(TBits bits, TValue v)
       {
-         return ((TBits(1) << TBits(v)) & bits) != 0;
+         return TBits(v) < sizeof(TBits) * 8 && ((TBits(1) << TBits(v)) & bits) != 0;    // EToken::Invalid (-1) is never contained
       }
 
+      /// \internal builds the table used by \ref CharClass. The classes are those of the "C" locale.
+      constexpr std::array<CharInfo, 256> MakeCharTable()
+      {
+         std::array<CharInfo, 256> table{};
+         for (int c = 0; c < 256; ++c)
+         {
+            bool space = c == ' ' || (c >= '\t' && c <= '\r');
+            bool punct = (c >= '!' && c <= '/') || (c >= ':' && c <= '@') || (c >= '[' && c <= '`') || (c >= '{' && c <= '~');
+            table[c].space = space;
+            table[c].identifier = c >= 0x80 || !(space || punct);
+         }
+
+         constexpr std::pair<char, EToken> tokens[] = {
+            { '.', EToken::Period },
+            { '[', EToken::OpenBracket },
+            { ']', EToken::CloseBracket },
+            { '{', EToken::OpenBrace },
+            { '}', EToken::CloseBrace },
+            { '=', EToken::Equal },
+            { '%', EToken::FetchArg },
+            { '!', EToken::Exclamation },
+            { '^', EToken::Caret },
+            { '*', EToken::Asterisk },
+            { '~', EToken::Tilde },
+            { ',', EToken::Comma },
+            { '-', EToken::Minus },
+            { '&', EToken::Ampersand },
+            { '$', EToken::Dollar },
+         };
+         for (auto && t : tokens)
+            table[(unsigned char)t.first].token = t.second;
+         return table;
+      }
+
+      inline constexpr std::array<CharInfo, 256> CharTable = MakeCharTable();
+
+      constexpr CharInfo const & CharClass(char c) { return CharTable[(unsigned char)c]; }
+
       /// \internal helper to map enum values to names, used for diagnostics
       template <typename T2, typename TEnum>
       T2 MapValue(TEnum value, std::initializer_list<std::pair<TEnum, T2>> values, T2 dflt)
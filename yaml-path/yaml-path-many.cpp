@@ -0,0 +1,508 @@
+/*
+MIT License
+
+Copyright(c) 2019 Peter Hauptmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "yaml-path.h"
+#include "yaml-path-internals.h"
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+/* Selecting and ensuring many paths at once (SelectMany, EnsureMany)
+
+   The selectors of all paths are merged into a prefix trie. Resolving the trie applies each selector once
+   to the result of its parent, so paths sharing a prefix (e.g. "db.host", "db.port") resolve the prefix once.
+   EnsureMany builds the nodes of each trie entry once, and adds the keys of a new map without looking them up.
+*/
+
+namespace YAML
+{
+   namespace YamlPathDetail
+   {
+      namespace
+      {
+         bool SameToken(KVToken const & a, KVToken const & b)
+         {
+            return a.token == b.token && a.required == b.required && a.noCase == b.noCase && a.starry == b.starry;
+         }
+
+         /// \internal true if \c a and \c b select the same nodes from any node
+         bool SameSelector(PathSelector const & a, PathSelector const & b)
+         {
+            if (a.selector != b.selector)
+               return false;
+
+            switch (a.selector)
+            {
+               case ESelector::Key:
+               case ESelector::RecursiveKey:
+                  return std::get<ArgKey>(a.data).key == std::get<ArgKey>(b.data).key;
+
+               case ESelector::Index:
+                  return std::get<ArgIndex>(a.data).index == std::get<ArgIndex>(b.data).index;
+
+               case ESelector::Slice:
+               {
+                  auto && sa = std::get<ArgSlice>(a.data);
+                  auto && sb = std::get<ArgSlice>(b.data);
+                  return sa.first == sb.first && sa.last == sb.last && sa.step == sb.step && sa.required == sb.required;
+               }
+
+               case ESelector::TypeCheck:
+               case ESelector::TypeFilter:
+                  return std::get<ArgNodeType>(a.data).type == std::get<ArgNodeType>(b.data).type;
+
+               case ESelector::MapFilter:
+               {
+                  auto && fa = std::get<ArgMapFilter>(a.data);
+                  auto && fb = std::get<ArgMapFilter>(b.data);
+                  return std::equal(fa.begin(), fa.end(), fb.begin(), fb.end(), [](ArgKVPair const & x, ArgKVPair const & y)
+                  {
+                     return x.op == y.op && x.alternative == y.alternative && x.joined == y.joined && x.valueType == y.valueType && SameToken(x.key, y.key) && SameToken(x.value, y.value);
+                  });
+               }
+
+               default:
+                  return false;
+            }
+         }
+
+         /** \internal the selectors of many compiled paths, merged by common prefixes
+
+             Entry 0 is the root, the other entries apply their selector to the result of their parent entry.
+             A path ends in the entry of its last valid selector.
+         */
+         class PathTrie
+         {
+         public:
+            PathTrie() : m_entries(1) {}
+
+            void Add(size_t path, CompiledPathData const & cp);
+            std::vector<Node> Resolve(Node const & node, PathContext const * context);
+
+         private:
+            struct Entry
+            {
+               PathSelector const * selector = nullptr;
+               std::vector<size_t> children;
+               std::vector<size_t> paths;          ///< the paths ending here
+            };
+
+            std::vector<Entry> m_entries;
+            std::vector<CompiledPathData const *> m_paths;
+            std::vector<std::optional<Node>> m_results;
+            size_t m_firstPathError = NoBoundArg;
+
+            void Walk(size_t entry, Node & node, NodeSet & nodes, PathContext const * context);
+         };
+
+         void PathTrie::Add(size_t path, CompiledPathData const & cp)
+         {
+            size_t entry = 0;
+            for (auto && selector : cp.selectors)
+            {
+               auto && children = m_entries[entry].children;
+               auto it = std::find_if(children.begin(), children.end(), [&](size_t child) { return SameSelector(*m_entries[child].selector, selector); });
+               if (it != children.end())
+               {
+                  entry = *it;
+                  continue;
+               }
+
+               children.push_back(m_entries.size());
+               entry = m_entries.size();
+               m_entries.emplace_back().selector = &selector;
+            }
+            m_entries[entry].paths.push_back(path);
+
+            if (m_paths.size() <= path)
+               m_paths.resize(path + 1);
+            m_paths[path] = &cp;
+         }
+
+         /// \internal resolves the paths ending at \c entry and below, \c node and \c nodes are the result of \c entry (see \ref ApplySelector)
+         void PathTrie::Walk(size_t entry, Node & node, NodeSet & nodes, PathContext const * context)
+         {
+            const bool undefined = !node && nodes.Empty();
+            for (size_t path : m_entries[entry].paths)
+            {
+               // same order of checks as ResolveNodes: a node error before the malformed part of a path is not a path error
+               if (m_paths[path]->error.Error() != EPathError::OK)
+               {
+                  if (!undefined)
+                     m_firstPathError = std::min(m_firstPathError, path);
+               }
+               else if (nodes.Empty())
+                  m_results[path] = node;
+               else
+                  m_results[path] = nodes.ToNode();
+            }
+
+            if (undefined)
+               return;     // node error for all paths below
+
+            auto && children = m_entries[entry].children;
+            for (size_t i = 0; i < children.size(); ++i)
+            {
+               PathSelector const & selector = *m_entries[children[i]].selector;
+               Node childNode = node;
+               NodeSet childNodes = i + 1 < children.size() ? nodes : std::move(nodes);   // the last child takes over the intermediate result
+               if (ApplySelector(childNode, childNodes, selector.selector, selector.data, context) == EPathError::OK)
+                  Walk(children[i], childNode, childNodes, context);
+            }
+         }
+
+         std::vector<Node> PathTrie::Resolve(Node const & node, PathContext const * context)
+         {
+            m_results.assign(m_paths.size(), std::nullopt);
+
+            Node root = node;
+            NodeSet nodes;
+            Walk(0, root, nodes, context);
+
+            if (m_firstPathError != NoBoundArg)
+            {
+               PathException x;
+               PathCompiler::SetPathError(*m_paths[m_firstPathError], &x);
+               throw x;
+            }
+
+            std::vector<Node> results;
+            results.reserve(m_results.size());
+            for (auto && result : m_results)
+               results.push_back(result ? *result : UndefinedNode());
+            return results;
+         }
+
+         /** \internal the selectors of the paths given to \ref EnsureMany, merged by common prefixes
+
+             As \ref PathTrie, and the children of an entry are found by hash for key and index selectors,
+             so an entry can have many children (e.g. the keys of a large map).
+         */
+         class EnsureTrie
+         {
+         public:
+            EnsureTrie() : m_entries(1) {}
+
+            EPathError Add(size_t item, CompiledPathData const & cp, PathException * px);
+            void Build(Node & root, std::pair<PathArg, Node> const * items, DocumentChanges & changes);
+
+         private:
+            struct Entry
+            {
+               PathSelector const * selector = nullptr;
+               size_t firstItem = 0;               ///< the item that added the entry, for diagnostics
+               std::vector<size_t> children;
+               size_t item = NoBoundArg;           ///< the last item ending here, which supplies the value
+               bool keysOnly = true;               ///< all children are key selectors
+               bool indexesOnly = true;            ///< all children are index selectors
+               size_t maxIndex = 0;                ///< the largest index of the children
+            };
+
+            struct ChildKey
+            {
+               size_t parent;
+               ESelector selector;
+               PathArg key;
+               size_t index;
+
+               bool operator==(ChildKey const & other) const
+               {
+                  return parent == other.parent && selector == other.selector && key == other.key && index == other.index;
+               }
+            };
+
+            struct ChildKeyHash
+            {
+               size_t operator()(ChildKey const & k) const
+               {
+                  return std::hash<PathArg>()(k.key) ^ (k.parent * 0x9E3779B97F4A7C15ull) ^ (k.index * 31 + size_t(k.selector));
+               }
+            };
+
+            std::vector<Entry> m_entries;
+            std::unordered_map<ChildKey, size_t, ChildKeyHash> m_lookup;    ///< key and index children of all entries
+            std::vector<CompiledPathData const *> m_paths;
+            std::pair<PathArg, Node> const * m_items = nullptr;
+            DocumentChanges * m_changes = nullptr;
+
+            size_t Child(size_t entry, PathSelector const & selector, size_t item);
+            void Build(size_t entry, ScratchVector<Node> const & nodes);
+            void Throw(size_t entry, EPathError error);
+         };
+
+         /// \internal returns the child of \c entry for \c selector, adding it if necessary
+         size_t EnsureTrie::Child(size_t entry, PathSelector const & selector, size_t item)
+         {
+            size_t child = m_entries.size();
+            if (selector.selector == ESelector::MapFilter || selector.selector == ESelector::Slice)
+            {
+               auto && children = m_entries[entry].children;
+               auto it = std::find_if(children.begin(), children.end(), [&](size_t c) { return SameSelector(*m_entries[c].selector, selector); });
+               if (it != children.end())
+                  return *it;
+            }
+            else
+            {
+               ChildKey key{ entry, selector.selector, PathArg(), 0 };
+               if (selector.selector == ESelector::Key)
+                  key.key = std::get<ArgKey>(selector.data).key;
+               else
+                  key.index = std::get<ArgIndex>(selector.data).index;
+
+               auto inserted = m_lookup.emplace(key, child);
+               if (!inserted.second)
+                  return inserted.first->second;
+            }
+
+            Entry & parent = m_entries[entry];
+            parent.children.push_back(child);
+            parent.keysOnly = parent.keysOnly && selector.selector == ESelector::Key;
+            parent.indexesOnly = parent.indexesOnly && selector.selector == ESelector::Index;
+            if (selector.selector == ESelector::Index)
+               parent.maxIndex = std::max(parent.maxIndex, std::get<ArgIndex>(selector.data).index);
+
+            Entry & added = m_entries.emplace_back();
+            added.selector = &selector;
+            added.firstItem = item;
+            return child;
+         }
+
+         /// \internal adds the path of \c item. Fails (without modifying the trie) if the path is malformed or cannot be ensured.
+         EPathError EnsureTrie::Add(size_t item, CompiledPathData const & cp, PathException * px)
+         {
+            if (cp.error.Error() != EPathError::OK)
+               return PathCompiler::SetPathError(cp, px);
+
+            for (auto && selector : cp.selectors)
+            {
+               bool supported = selector.selector == ESelector::Key || selector.selector == ESelector::Index || selector.selector == ESelector::Slice;
+               if (selector.selector == ESelector::MapFilter)
+               {
+                  auto && filter = std::get<ArgMapFilter>(selector.data);
+                  supported = std::all_of(filter.begin(), filter.end(), EnsureSupports);
+               }
+               if (!supported)
+                  return PathCompiler::SetNodeError(cp, &selector, EPathError::SelectorNotSupported, px);
+            }
+
+            if (m_paths.size() <= item)
+               m_paths.resize(item + 1);
+            m_paths[item] = &cp;
+
+            size_t entry = 0;
+            for (auto && selector : cp.selectors)
+               entry = Child(entry, selector, item);
+            m_entries[entry].item = item;
+            return EPathError::OK;
+         }
+
+         void EnsureTrie::Throw(size_t entry, EPathError error)
+         {
+            PathException x;
+            PathCompiler::SetNodeError(*m_paths[m_entries[entry].firstItem], m_entries[entry].selector, error, &x);
+            throw x;
+         }
+
+         /// \internal creates the children of \c entry below \c nodes (the nodes ensured for \c entry), then assigns the value of \c entry
+         void EnsureTrie::Build(size_t entry, ScratchVector<Node> const & nodes)
+         {
+            if (nodes.empty())
+               return;     // below a map filter that only assigned values
+
+            Entry const & e = m_entries[entry];
+            ScratchVector<ScratchVector<Node>> childNodes(e.children.size(), Scratch());
+
+            if (e.indexesOnly && !e.children.empty())
+            {
+               // size each sequence once, for the largest index
+               for (Node el : nodes)
+               {
+                  if (el.IsNull() || el.IsSequence())
+                  {
+                     EnsureSequenceSize(el, e.maxIndex + 1, *m_changes);
+                     Node const & seq = el;
+                     for (size_t i = 0; i < e.children.size(); ++i)
+                        childNodes[i].push_back(seq[std::get<ArgIndex>(m_entries[e.children[i]].selector->data).index]);
+                  }
+               }
+               if (childNodes[0].empty())
+                  Throw(e.children[0], EPathError::Internal);
+            }
+            else if (!e.children.empty())
+            {
+               ScratchVector<Node> existing(Scratch());      // nodes that may already contain some of the keys
+               for (Node node : nodes)
+               {
+                  if (!e.keysOnly || !node.IsNull())
+                  {
+                     existing.push_back(node);
+                     continue;
+                  }
+
+                  // a new map: the keys of the children are distinct, and are added without a lookup
+                  m_changes->Modified(node);
+                  for (size_t i = 0; i < e.children.size(); ++i)
+                  {
+                     Node value(NodeType::Null);
+                     node.force_insert(std::string(std::get<ArgKey>(m_entries[e.children[i]].selector->data).key), value);  // value now shares the memory of node
+                     childNodes[i].push_back(value);
+                  }
+               }
+
+               if (!existing.empty())
+               {
+                  for (size_t i = 0; i < e.children.size(); ++i)
+                  {
+                     PathSelector const & selector = *m_entries[e.children[i]].selector;
+                     ScratchVector<Node> next(existing, Scratch());
+                     EPathError err = EnsureSelector(next, selector.selector, selector.data, *m_changes);
+                     if (err != EPathError::OK && childNodes[i].empty())
+                        Throw(e.children[i], err);
+                     if (err == EPathError::OK)
+                        childNodes[i].insert(childNodes[i].end(), next.begin(), next.end());
+                  }
+               }
+            }
+
+            for (size_t i = 0; i < e.children.size(); ++i)
+               Build(e.children[i], childNodes[i]);
+
+            if (e.item != NoBoundArg)
+            {
+               for (Node node : nodes)
+               {
+                  m_changes->Modified(node);
+                  node = m_items[e.item].second;
+               }
+            }
+         }
+
+         void EnsureTrie::Build(Node & root, std::pair<PathArg, Node> const * items, DocumentChanges & changes)
+         {
+            m_items = items;
+            m_changes = &changes;
+            EnsureNodeExists(root);
+            Build(0, ScratchVector<Node>({ root }, Scratch()));
+         }
+      }
+   }
+
+   /** Selects \c count paths from \c node, walking common prefixes of the paths only once.
+
+       The result contains one node for each path, in the order of \c paths, which is the node \ref Select would return.
+       Selectors that are the same in several paths, starting from the first selector, are applied only once,
+       e.g. for \c "db.host" and \c "db.port", \c "db" is resolved once.
+
+       \par Error Handling
+
+       As for \ref Select, a path that does not match gives an <i>invalid node</i>.\n
+       If any of the paths is malformed (and no node error occurs before the malformed part of the path),
+       the \ref PathException that \c Select would throw for the first of these paths is thrown.\n
+       Paths cannot contain placeholders for bound arguments.
+
+       \c paths must remain valid during the call only.
+   */
+   std::vector<Node> SelectMany(Node node, PathArg const * paths, size_t count, PathContext const * context)
+   {
+      using namespace YamlPathDetail;
+
+      std::vector<std::shared_ptr<CompiledPathData const>> compiled;
+      compiled.reserve(count);
+      PathTrie trie;
+      for (size_t i = 0; i < count; ++i)
+      {
+         auto cp = PathCacheGet(paths[i]);
+         if (!cp || !cp->argSlots.empty())
+         {
+            // cache disabled, or a template: compile without arguments, so placeholders report the same error as Select without arguments
+            auto local = std::make_shared<CompiledPathData>();
+            PathCompiler::Compile(*local, paths[i], nullptr, 0);
+            cp = local;
+         }
+         trie.Add(i, *cp);
+         compiled.push_back(std::move(cp));
+      }
+
+      ScratchScope scratch(context);
+      return trie.Resolve(node, context);
+   }
+
+   /** Like \ref SelectMany, for a list of paths */
+   std::vector<Node> SelectMany(Node node, std::initializer_list<PathArg> paths, PathContext const * context)
+   {
+      return SelectMany(node, paths.begin(), paths.size(), context);
+   }
+
+   /** Ensures the paths of all \c items exist in \c node, and assigns the value of each item to the nodes ensured for its path.
+
+       The result is the same as calling \ref Ensure for each item in turn, and assigning the value to each node of the result,
+       but selectors that are the same in several paths, starting from the first selector, are applied only once.
+       Keys added to a new map are not looked up, and a sequence is extended once, for the largest index of all paths.
+       This builds a large document in a single pass, e.g. from \c "servers[0].name", \c "servers[0].port", \c "servers[1].name", ...
+
+       If the path of an item is a prefix of the path of another item, the value replaces the nodes created below it.
+       If several items have the same path, the last value is assigned.
+
+       \par Error Handling
+
+       All paths are checked before \c node is modified: if a path is malformed or contains a selector that \ref Ensure does not support,
+       the \ref PathException that \c Ensure would throw is thrown for the first of these items.\n
+       If a path cannot be ensured (e.g. a key below a scalar), a \ref PathException is thrown, and \c node may be partially modified.\n
+       Paths cannot contain placeholders for bound arguments.
+   */
+   void EnsureMany(Node & node, std::pair<PathArg, Node> const * items, size_t count)
+   {
+      using namespace YamlPathDetail;
+
+      std::vector<std::shared_ptr<CompiledPathData const>> compiled;
+      compiled.reserve(count);
+      EnsureTrie trie;
+      for (size_t i = 0; i < count; ++i)
+      {
+         auto cp = PathCacheGet(items[i].first);
+         if (!cp || !cp->argSlots.empty())
+         {
+            auto local = std::make_shared<CompiledPathData>();
+            PathCompiler::Compile(*local, items[i].first, nullptr, 0);
+            cp = local;
+         }
+
+         PathException x;
+         if (trie.Add(i, *cp, &x) != EPathError::OK)
+            throw x;
+         compiled.push_back(std::move(cp));
+      }
+
+      ScratchScope scratch(nullptr);
+      DocumentChanges changes;
+      trie.Build(node, items, changes);
+   }
+
+   /** Like \ref EnsureMany, for a list of items */
+   void EnsureMany(Node & node, std::initializer_list<std::pair<PathArg, Node>> items)
+   {
+      EnsureMany(node, items.begin(), items.size());
+   }
+}
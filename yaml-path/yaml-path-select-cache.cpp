@@ -0,0 +1,279 @@
+/*
+MIT License
+
+Copyright(c) 2019 Peter Hauptmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "yaml-path.h"
+#include "yaml-path-internals.h"
+#include <yaml-cpp/yaml.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+/* Result cache for one document (SelectCache)
+
+   The results are kept in an LRU list, and found by a key made of the path and the bound arguments.
+   A result sequence created by Select is returned as a copy, so a caller modifying it does not modify the cached result.
+   As with the path cache, a result is computed without holding the lock. 
+   The cache watches the nodes of the document while it holds results (see DocumentWatch), 
+   and discards them when it is used after Ensure modified one of them.
+*/
+
+namespace YAML
+{
+   namespace YamlPathDetail
+   {
+      /// \internal shared state of \ref SelectCache copies
+      struct SelectCacheData
+      {
+         struct Entry
+         {
+            std::string key;
+            Node result;
+            size_t memory = 0;
+            bool created = false;      ///< \c result is a result sequence created by Select, not a node of the document
+         };
+
+         Node root;
+         std::atomic<size_t> capacity = 0;
+         mutable std::mutex lock;
+         std::list<Entry> lru;                                             // most recently used first
+         std::unordered_map<PathArg, std::list<Entry>::iterator> index;    // keys refer to the key stored in the entry
+         std::shared_ptr<DocumentWatch> watch = WatchDocument();
+         uint64_t generation = 0;      ///< the generation of \c watch the cached results belong to
+         uint64_t hits = 0;
+         uint64_t misses = 0;
+         uint64_t evictions = 0;
+         uint64_t invalidations = 0;
+         size_t memory = 0;
+
+         std::optional<Node> Find(PathArg key);
+         void Insert(PathArg key, Node const & result, uint64_t resultGeneration);
+         void Trim(size_t capacity);
+         void Clear();
+      };
+
+      namespace
+      {
+         template <typename T>
+         void AppendBytes(std::pmr::string & key, T value)
+         {
+            key.append(reinterpret_cast<char const *>(&value), sizeof(value));
+         }
+
+         /// \internal the cache key for a path and its bound arguments. Lengths are included, so different paths and arguments never give the same key
+         void MakeKey(std::pmr::string & key, PathArg path, PathBoundArg const * args, size_t argCount)
+         {
+            AppendBytes(key, path.size());
+            key.append(path);
+            for (size_t i = 0; i < argCount; ++i)
+            {
+               if (auto s = std::get_if<PathArg>(&args[i]))
+               {
+                  key.push_back('s');
+                  AppendBytes(key, s->size());
+                  key.append(*s);
+               }
+               else
+               {
+                  key.push_back('i');
+                  AppendBytes(key, std::get<size_t>(args[i]));
+               }
+            }
+         }
+
+         /// \internal a new result sequence with the elements of \c result, which are the same document nodes
+         Node CopyResult(Node const & result)
+         {
+            NodeSet nodes;
+            nodes.Reserve(result.size());
+            for (auto && el : result)
+               nodes.Add(el);
+            return nodes.ToNode();
+         }
+
+         /// \internal approximate bytes used for caching \c result under \c key: the entry, its list and hash nodes, and a result sequence
+         size_t EntryMemory(PathArg key, Node const & result)
+         {
+            size_t bytes = sizeof(SelectCacheData::Entry) + key.size() + 6 * sizeof(void *);
+            if (result.IsSequence())
+               bytes += result.size() * sizeof(Node);
+            return bytes;
+         }
+      }
+
+      /** \internal returns the cached result for \c key, a copy of a result sequence. 
+          Discards all results if the document was modified since they were cached.
+      */
+      std::optional<Node> SelectCacheData::Find(PathArg key)
+      {
+         std::unique_lock<std::mutex> lock(this->lock);
+         if (!watch->Current(generation))
+         {
+            if (!lru.empty())
+               ++invalidations;
+            Clear();
+         }
+
+         auto it = index.find(key);
+         if (it == index.end())
+         {
+            ++misses;
+            return std::nullopt;
+         }
+         ++hits;
+         lru.splice(lru.begin(), lru, it->second);
+         Node result = it->second->result;
+         bool created = it->second->created;
+         lock.unlock();
+         return created ? CopyResult(result) : result;
+      }
+
+      /** \internal caches \c result, unless the document was modified since \c resultGeneration, or another thread added \c key meanwhile.
+          The first result cached starts watching the document. A result sequence is copied, the caller keeps \c result.
+      */
+      void SelectCacheData::Insert(PathArg key, Node const & result, uint64_t resultGeneration)
+      {
+         std::lock_guard<std::mutex> lock(this->lock);
+         if (resultGeneration != generation || !watch->Current(resultGeneration) || index.count(key))
+            return;
+
+         if (lru.empty())
+         {
+            std::vector<void const *> watched;
+            DocumentWatch::Collect(watched, root);
+            watch->Watch(std::move(watched));
+         }
+
+         auto & entry = lru.emplace_front();
+         entry.key = std::string(key);
+         entry.created = result.IsSequence() && !watch->Watches(NodeIdentity(result));
+         entry.result.reset(entry.created ? CopyResult(result) : result);
+         entry.memory = EntryMemory(key, result);
+         memory += entry.memory;
+         index.emplace(entry.key, lru.begin());
+         Trim(capacity);
+      }
+
+      /// \internal removes least recently used entries until at most \c capacity are left. Requires \c lock to be held.
+      void SelectCacheData::Trim(size_t capacity)
+      {
+         while (lru.size() > capacity)
+         {
+            memory -= lru.back().memory;
+            index.erase(lru.back().key);
+            lru.pop_back();
+            ++evictions;
+         }
+      }
+
+      /// \internal removes all entries, and stops watching the document. Requires \c lock to be held.
+      void SelectCacheData::Clear()
+      {
+         index.clear();
+         lru.clear();
+         memory = 0;
+         watch->Stop();
+         generation = watch->generation;
+      }
+   }
+
+   using namespace YamlPathDetail;
+
+   SelectCache::SelectCache(Node root, size_t capacity) : m_data(std::make_shared<SelectCacheData>())
+   {
+      if (root)
+         m_data->root.reset(root);
+      m_data->capacity = capacity;
+   }
+
+   Node SelectCache::Root() const
+   {
+      return m_data->root;
+   }
+
+   Node SelectCache::Select(PathArg path, PathBoundArgs args, PathContext const * context)
+   {
+      if (!m_data->capacity)
+         return YAML::Select(m_data->root, path, args, context);
+
+      ScratchScope scratch(context);
+      std::pmr::string key(Scratch());
+      MakeKey(key, path, args.begin(), args.size());
+      if (auto cached = m_data->Find(key))
+         return *cached;
+
+      uint64_t generation = m_data->watch->generation;
+      Node result = YAML::Select(m_data->root, path, args, context);
+      m_data->Insert(key, result, generation);
+      return result;
+   }
+
+   Node SelectCache::Select(CompiledPath const & path, PathContext const * context)
+   {
+      auto cp = PathCompiler::Data(path);
+      if (!m_data->capacity || !cp)
+         return YAML::Select(m_data->root, path, context);
+
+      ScratchScope scratch(context);
+      std::pmr::string key(Scratch());
+      MakeKey(key, cp->path, cp->args.data(), cp->args.size());
+      if (auto cached = m_data->Find(key))
+         return *cached;
+
+      uint64_t generation = m_data->watch->generation;
+      Node result = YAML::Select(m_data->root, path, context);
+      m_data->Insert(key, result, generation);
+      return result;
+   }
+
+   void SelectCache::Invalidate()
+   {
+      std::lock_guard<std::mutex> lock(m_data->lock);
+      if (!m_data->lru.empty())
+         ++m_data->invalidations;
+      m_data->Clear();
+   }
+
+   void SelectCache::SetCapacity(size_t capacity)
+   {
+      std::lock_guard<std::mutex> lock(m_data->lock);
+      m_data->capacity = capacity;
+      m_data->Trim(capacity);
+   }
+
+   SelectCacheStats SelectCache::Stats() const
+   {
+      std::lock_guard<std::mutex> lock(m_data->lock);
+      SelectCacheStats stats;
+      stats.hits = m_data->hits;
+      stats.misses = m_data->misses;
+      stats.evictions = m_data->evictions;
+      stats.invalidations = m_data->invalidations;
+      stats.size = m_data->lru.size();
+      stats.capacity = m_data->capacity;
+      stats.memory = m_data->memory;
+      return stats;
+   }
+}
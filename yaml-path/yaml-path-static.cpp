@@ -0,0 +1,162 @@
+/*
+MIT License
+
+Copyright(c) 2019 Peter Hauptmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "yaml-path-static.h"
+#include <yaml-cpp/yaml.h>
+#include <assert.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace YAML
+{
+   namespace YamlPathDetail
+   {
+      void ThrowStaticPathError(PathArg path)
+      {
+         PathException x;
+         PathScanner scan(path, {}, &x);
+         while (scan)
+            scan.NextSelector();
+
+         if (scan.Error() != EPathError::OK)
+            throw x;
+         throw std::length_error("yaml-path: path literal exceeds the capacity of StaticPath");
+      }
+
+      /// \internal like \ref ResolveNodes for a compiled path, without diagnostics
+      EPathError ResolveStatic(Node & node, NodeSet & nodes, StaticPath const & path, PathContext const * context)
+      {
+         PathTraceScope trace(context, path.Path());
+         PathScanner::tSelectorData data;
+         for (size_t i = 0; i < path.Size(); ++i)
+         {
+            if (!node && nodes.Empty())
+               return trace.EndPath(EPathError::NodeNotFound, 0);
+
+            auto && selector = path.Selector(i);
+            trace.BeginSelector(i, selector.selector, node, nodes);
+            switch (selector.selector)
+            {
+               case ESelector::Key:
+                  data = ArgKey{ selector.key };
+                  break;
+
+               case ESelector::RecursiveKey:
+                  data = ArgKey{ selector.key };
+                  break;
+
+               case ESelector::Index:
+                  data = ArgIndex{ selector.index };
+                  break;
+
+               case ESelector::Slice:
+               {
+                  ArgSlice slice;
+                  slice.first = selector.index;
+                  slice.last = selector.last;
+                  slice.step = selector.step;
+                  slice.required = selector.required;
+                  data = slice;
+                  break;
+               }
+
+               case ESelector::TypeCheck:
+               case ESelector::TypeFilter:
+                  data = ArgNodeType{ selector.type };
+                  break;
+
+               case ESelector::MapFilter:
+               {
+                  ArgMapFilter filter(Scratch());
+                  filter.reserve(selector.kvCount);
+                  for (size_t k = selector.firstKV; k < selector.firstKV + selector.kvCount; ++k)
+                  {
+                     auto && kv = path.KV(k);
+                     ArgKVPair & kvp = filter.emplace_back();
+                     kvp.key = kv.key;
+                     kvp.value = kv.value;
+                     kvp.op = kv.op;
+                     kvp.joined = kv.joined;
+                     kvp.valueType = kv.valueType;
+                  }
+                  OrderConditions(filter);      // same order as PathScanner::NextSelector
+                  data = std::move(filter);
+                  break;
+               }
+
+               default:
+                  assert(false);
+                  return EPathError::Internal;
+            }
+
+            auto err = ApplySelector(node, nodes, selector.selector, data, context, trace.KeysScanned());
+            trace.EndSelector(node, nodes, err);
+            if (err != EPathError::OK)
+               return trace.EndPath(err, 0);
+         }
+         return trace.EndPath(EPathError::OK, node, nodes);
+      }
+   }
+
+   using namespace YamlPathDetail;
+
+   /** Like \ref PathResolve, for a \ref StaticPath. 
+       If an error occurs and \c px is not \c nullptr, the path is resolved again as a string, to collect the diagnostics.
+   */
+   EPathError PathResolve(Node & node, StaticPath const & path, PathException * px, PathContext const * context)
+   {
+      ScratchScope scratch(context);
+      Node start = node;
+      NodeSet nodes;
+      EPathError err = Materialize(node, nodes, ResolveStatic(node, nodes, path, context));
+      if (err == EPathError::OK || !px)
+         return err;
+
+      node.reset(start);
+      PathArg rpath = path.Path();
+      return PathResolve(node, rpath, {}, px, context);
+   }
+
+   /** Like \ref Select, for a \ref StaticPath */
+   Node Select(Node node, StaticPath const & path, PathContext const * context)
+   {
+      Node result = node;
+      if (PathResolve(result, path, nullptr, context) != EPathError::OK)
+         return UndefinedNode();    // a StaticPath is valid, only node errors can occur
+      return result;
+   }
+
+   /** Like \ref Require, for a \ref StaticPath */
+   Node Require(Node node, StaticPath const & path, PathContext const * context)
+   {
+      Node result = node;
+      auto err = PathResolve(result, path, nullptr, context);
+      if (err == EPathError::OK)
+         return result;
+
+      PathException x;
+      PathResolve(node, path, &x, context);
+      throw x;
+   }
+}
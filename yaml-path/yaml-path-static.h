@@ -0,0 +1,584 @@
+/*
+MIT License
+
+Copyright(c) 2019 Peter Hauptmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "yaml-path.h"
+#include "yaml-path-internals.h"
+
+/** \file
+    path literals that are validated and parsed during compilation, see \ref StaticPath
+*/
+
+namespace YAML
+{
+   class StaticPath;
+
+   namespace YamlPathDetail
+   {
+      /// \internal a selector of a \ref StaticPath. Tokens refer to the path literal.
+      struct StaticSelector
+      {
+         ESelector selector = ESelector::None;
+         PathArg key;               ///< \c ESelector::Key and \c ESelector::RecursiveKey
+         size_t index = 0;          ///< \c ESelector::Index, and the first position of \c ESelector::Slice
+         size_t last = 0;           ///< \c ESelector::Slice: see \ref ArgSlice
+         size_t step = 1;
+         bool required = false;
+         NodeType::value type = NodeType::Undefined;    ///< \c ESelector::TypeCheck and \c ESelector::TypeFilter
+         size_t firstKV = 0;        ///< \c ESelector::MapFilter: the conditions and key selections are \c kvCount items in \ref StaticPath::KV
+         size_t kvCount = 0;
+      };
+
+      /// \internal an item of a map filter of a \ref StaticPath, in the order of the path
+      struct StaticKVPair
+      {
+         KVToken key;
+         KVToken value;
+         EKVOp op = EKVOp::Equal;
+         bool joined = false;       ///< see \ref ArgKVPair::joined
+         NodeType::value valueType = NodeType::Undefined;    ///< see \ref ArgKVPair::valueType
+      };
+
+      /** \internal fails a path literal: when evaluated during compilation, this is a compile error.
+          At run time, it throws the \ref PathException that \ref PathValidate would report for \c path.
+      */
+      [[noreturn]] void ThrowStaticPathError(PathArg path);
+
+      /** \internal the grammar of \ref PathScanner::NextSelector, for constant evaluation.
+          A path literal has no bound arguments, so a \c "%" token is an \c EPathError::MissingArg error.
+      */
+      class StaticScanner
+      {
+      public:
+         constexpr explicit StaticScanner(PathArg path) : m_rpath(path) { SkipWS(); }
+
+         /// equal to \ref PathScanner::ValidTokensAtStart, which is not a constant expression
+         static constexpr uint64_t ValidTokensAtStart = BitsOf({ EToken::FetchArg, EToken::None, EToken::OpenBracket, EToken::OpenBrace, EToken::QuotedIdentifier, EToken::UnquotedIdentifier, EToken::Period, EToken::Asterisk, EToken::Exclamation });
+
+         constexpr explicit operator bool() const { return !m_rpath.empty() && m_error == EPathError::OK; }
+         constexpr EPathError Error() const { return m_error; }
+
+         /// reads the next selector into \c selector, and the items of a map filter to \c kvs. Returns \ref ESelector::Invalid on error.
+         template <size_t N>
+         constexpr ESelector NextSelector(StaticSelector & selector, StaticKVPair (&kvs)[N], size_t & kvCount);
+
+      private:
+         struct Token
+         {
+            EToken id = EToken::None;
+            PathArg value;
+            size_t index = 0;
+         };
+
+         PathArg     m_rpath;
+         Token       m_curToken;
+         bool        m_tokenPending = false;
+         bool        m_periodAllowed = false;
+         bool        m_selectorRequired = false;
+         EPathError  m_error = EPathError::OK;
+
+         constexpr void SkipWS()
+         {
+            while (!m_rpath.empty() && CharClass(m_rpath[0]).space)
+               m_rpath.remove_prefix(1);
+         }
+
+         constexpr void SetToken(EToken id, PathArg value = {})
+         {
+            m_curToken = { id, value, 0 };
+            SkipWS();
+         }
+
+         constexpr bool SetError(EPathError error)
+         {
+            m_error = error;
+            m_curToken = Token{};
+            m_curToken.id = EToken::Invalid;
+            return false;
+         }
+
+         constexpr void NextToken();
+         constexpr bool NextSelectorToken(uint64_t validTokens, EPathError error = EPathError::InvalidToken);
+         constexpr bool PeekSelectorToken(uint64_t validTokens);
+         constexpr bool ReadKVToken(KVToken & kvtoken, uint64_t endTokens);
+
+         constexpr ESelector ReadRecursiveKey(StaticSelector & selector)
+         {
+            if (!NextSelectorToken(BitsOf({ EToken::FetchArg, EToken::QuotedIdentifier, EToken::UnquotedIdentifier })))
+               return ESelector::Invalid;
+
+            selector.selector = ESelector::RecursiveKey;
+            selector.key = m_curToken.value;
+            m_periodAllowed = true;
+            return selector.selector;
+         }
+
+         /// like \ref PathScanner::ReadTypePredicate
+         constexpr bool ReadTypePredicate(NodeType::value & type)
+         {
+            if (!NextSelectorToken(BitsOf({ EToken::UnquotedIdentifier })))
+               return false;
+
+            type = PredicateType(m_curToken.value);
+            if (type == NodeType::Undefined)
+               return SetError(EPathError::InvalidToken);
+            return true;
+         }
+
+         /// like \ref PathScanner::ReadSlice
+         constexpr ESelector ReadSlice(StaticSelector & selector)
+         {
+            if (!NextSelectorToken(BitsOf({ EToken::Index }), EPathError::InvalidIndex))
+               return ESelector::Invalid;
+            selector.last = m_curToken.index;
+
+            if (!NextSelectorToken(BitsOf({ EToken::Comma, EToken::CloseBracket })))
+               return ESelector::Invalid;
+            if (m_curToken.id == EToken::Comma)
+            {
+               if (!NextSelectorToken(BitsOf({ EToken::Index }), EPathError::InvalidIndex))
+                  return ESelector::Invalid;
+               selector.step = m_curToken.index;
+               if (selector.step == 0)
+                  return SetError(EPathError::InvalidIndex), ESelector::Invalid;
+               if (!NextSelectorToken(BitsOf({ EToken::CloseBracket })))
+                  return ESelector::Invalid;
+            }
+
+            if (selector.index > selector.last)
+               return SetError(EPathError::InvalidIndex), ESelector::Invalid;
+            selector.selector = ESelector::Slice;
+            return selector.selector;
+         }
+      };
+   }
+
+   /** A path literal, validated and parsed during compilation
+
+      \code
+      using namespace YAML::PathLiterals;
+      Node port = Select(root, "servers{role=primary}.port"_ypath);
+
+      constexpr StaticPath hosts("servers.hosts");      // a named path
+      \endcode
+
+      A malformed path is a compile error, as are paths with bound arguments (\c "%").
+      Applying a \c StaticPath resolves its selectors directly, without parsing the path or using the path cache.
+
+      In C++20, the \c _ypath literal is \c consteval, so a parse error is always reported by the compiler.
+      In C++17, the path is validated during compilation only in a constant expression, e.g. when initializing a \c constexpr variable 
+      or with \ref YAML_STATIC_PATH. Otherwise, the literal is parsed at run time on each evaluation (without allocating), 
+      and a malformed path throws the \ref PathException that \ref PathValidate would report.
+
+      A path can have up to \c MaxSelectors selectors, and its map filters up to \c MaxKVPairs items in total.
+   */
+   class StaticPath
+   {
+   public:
+      static constexpr size_t MaxSelectors = 16;
+      static constexpr size_t MaxKVPairs = 16;
+
+      constexpr StaticPath(char const * path, size_t length) : StaticPath(PathArg(path, length)) {}
+      constexpr explicit StaticPath(PathArg path);
+
+      constexpr PathArg Path() const { return m_path; }           ///< the path literal
+      constexpr size_t Size() const { return m_selectorCount; }    ///< the number of selectors
+
+      /// \internal the selectors and map filter items, applied by \ref PathResolve
+      constexpr YamlPathDetail::StaticSelector const & Selector(size_t i) const { return m_selectors[i]; }
+      constexpr YamlPathDetail::StaticKVPair const & KV(size_t i) const { return m_kvs[i]; }
+
+   private:
+      PathArg m_path;
+      YamlPathDetail::StaticSelector m_selectors[MaxSelectors] = {};
+      size_t m_selectorCount = 0;
+      YamlPathDetail::StaticKVPair m_kvs[MaxKVPairs] = {};
+      size_t m_kvCount = 0;
+   };
+
+#if defined(__cpp_consteval)
+#define YAML_PATH_CONSTEVAL consteval
+#else
+#define YAML_PATH_CONSTEVAL constexpr
+#endif
+
+   inline namespace PathLiterals
+   {
+      /// a \ref StaticPath literal, e.g. <code>"a.b{c=d}"_ypath</code>
+      YAML_PATH_CONSTEVAL StaticPath operator""_ypath(char const * path, size_t length) { return StaticPath(path, length); }
+   }
+
+/** a reference to a \ref StaticPath for the string literal \c path, that is always parsed during compilation (also in C++17) */
+#define YAML_STATIC_PATH(path) ([]() -> ::YAML::StaticPath const & { static constexpr ::YAML::StaticPath p(path, sizeof(path) - 1); return p; }())
+
+   Node Select(Node node, StaticPath const & path, PathContext const * context = nullptr);
+   Node Require(Node node, StaticPath const & path, PathContext const * context = nullptr);
+   EPathError PathResolve(Node & node, StaticPath const & path, PathException * px = nullptr, PathContext const * context = nullptr);
+}
+
+// ----- Implementation
+
+namespace YAML
+{
+   namespace YamlPathDetail
+   {
+      /** \internal like \ref PathScanner::NextToken */
+      constexpr void StaticScanner::NextToken()
+      {
+         if (m_rpath.empty())
+            return SetToken(EToken::None);
+
+         if (m_error != EPathError::OK)
+            return;
+
+         char head = m_rpath[0];
+         EToken t = CharClass(head).token;
+         if (t != EToken::None)
+         {
+            m_rpath.remove_prefix(1);
+            return SetToken(t);
+         }
+
+         if (head == '\'' || head == '"')
+         {
+            size_t end = m_rpath.find(head, 1);
+            if (end == PathArg::npos)
+               return SetToken(EToken::Invalid);
+
+            PathArg value = m_rpath.substr(1, end - 1);
+            m_rpath.remove_prefix(end + 1);
+            return SetToken(EToken::QuotedIdentifier, value);
+         }
+
+         size_t length = 0;
+         while (length < m_rpath.size() && CharClass(m_rpath[length]).identifier)
+            ++length;
+         if (!length)
+         {
+            SetError(EPathError::InvalidToken);
+            return;
+         }
+
+         PathArg value = m_rpath.substr(0, length);
+         m_rpath.remove_prefix(length);
+         SetToken(EToken::UnquotedIdentifier, value);
+      }
+
+      /** \internal like \ref PathScanner::PeekSelectorToken */
+      constexpr bool StaticScanner::PeekSelectorToken(uint64_t validTokens)
+      {
+         if (m_tokenPending)
+            m_tokenPending = false;
+         else
+            NextToken();
+
+         if (BitsContain(validTokens, m_curToken.id))
+            return true;
+
+         m_tokenPending = true;
+         return false;
+      }
+
+      /** \internal like \ref PathScanner::NextSelectorToken */
+      constexpr bool StaticScanner::NextSelectorToken(uint64_t validTokens, EPathError error)
+      {
+         if (m_tokenPending)
+            m_tokenPending = false;
+         else
+            NextToken();
+
+         if (m_curToken.id == EToken::FetchArg)
+            return SetError(EPathError::MissingArg);
+
+         if (m_curToken.id == EToken::UnquotedIdentifier && BitsContain(validTokens, EToken::Index))
+         {
+            // like AsIndex
+            size_t value = 0;
+            bool isIndex = true;
+            for (char c : m_curToken.value)
+            {
+               if (c < '0' || c > '9')
+               {
+                  isIndex = false;
+                  break;
+               }
+
+               size_t prev = value;
+               value = value * 10 + (c - '0');
+               if (value < prev)
+                  return SetError(EPathError::InvalidIndex);
+            }
+            if (isIndex)
+            {
+               m_curToken.id = EToken::Index;
+               m_curToken.index = value;
+            }
+         }
+
+         if (BitsContain(validTokens, m_curToken.id))
+            return true;
+
+         if (m_curToken.id == EToken::None)
+            error = EPathError::UnexpectedEnd;
+         return SetError(error);
+      }
+
+      /** \internal like \ref PathScanner::ReadKVToken */
+      constexpr bool StaticScanner::ReadKVToken(KVToken & kvtoken, uint64_t endTokens)
+      {
+         kvtoken = KVToken();
+
+         const auto nameTokens = BitsOf({ EToken::FetchArg, EToken::QuotedIdentifier, EToken::UnquotedIdentifier });
+         auto validTokens = BitsOf({ EToken::Exclamation, EToken::Caret, EToken::Asterisk }) | nameTokens;
+         while (true)
+         {
+            if (!NextSelectorToken(validTokens))
+               return false;
+
+            switch (m_curToken.id)
+            {
+               case EToken::Exclamation:
+                  validTokens &= ~BitsOf({ EToken::Exclamation });
+                  kvtoken.required = true;
+                  continue;
+
+               case EToken::Caret:
+                  validTokens &= ~BitsOf({ EToken::Caret });
+                  kvtoken.noCase = true;
+                  continue;
+
+               case EToken::QuotedIdentifier:
+               case EToken::UnquotedIdentifier:
+                  validTokens &= ~(nameTokens | BitsOf({ EToken::Caret, EToken::Exclamation }));
+                  validTokens |= endTokens;
+                  kvtoken.token = m_curToken.value;
+                  continue;
+
+               case EToken::Asterisk:
+                  validTokens = endTokens;
+                  kvtoken.starry = true;
+                  continue;
+
+               default:
+                  m_tokenPending = true;
+                  return BitsContain(endTokens, m_curToken.id);
+            }
+         }
+      }
+
+      template <size_t N>
+      constexpr ESelector StaticScanner::NextSelector(StaticSelector & selector, StaticKVPair (&kvs)[N], size_t & kvCount)
+      {
+         if (m_error != EPathError::OK)
+            return ESelector::Invalid;
+
+         bool separated = false;
+         if (m_periodAllowed)
+         {
+            if (!NextSelectorToken(ValidTokensAtStart))
+               return ESelector::Invalid;
+            m_periodAllowed = false;
+
+            separated = m_curToken.id == EToken::Period;
+            if (separated)
+               m_selectorRequired = true;
+            else
+               m_tokenPending = true;
+         }
+
+         if (!NextSelectorToken(ValidTokensAtStart))
+            return ESelector::Invalid;
+
+         selector = StaticSelector();
+         switch (m_curToken.id)
+         {
+            case EToken::None:
+               if (m_selectorRequired)
+                  return SetError(EPathError::UnexpectedEnd), ESelector::Invalid;
+               return ESelector::None;
+
+            case EToken::QuotedIdentifier:
+            case EToken::UnquotedIdentifier:
+               selector.selector = ESelector::Key;
+               selector.key = m_curToken.value;
+               m_periodAllowed = true;
+               return selector.selector;
+
+            case EToken::Period:
+               if (!separated && !NextSelectorToken(BitsOf({ EToken::Period })))
+                  return ESelector::Invalid;
+               return ReadRecursiveKey(selector);
+
+            case EToken::Asterisk:
+               if (!NextSelectorToken(BitsOf({ EToken::Asterisk })) || !NextSelectorToken(BitsOf({ EToken::Period })))
+                  return ESelector::Invalid;
+               return ReadRecursiveKey(selector);
+
+            case EToken::Exclamation:
+               if (!ReadTypePredicate(selector.type))
+                  return ESelector::Invalid;
+               m_periodAllowed = true;
+               selector.selector = ESelector::TypeCheck;
+               return selector.selector;
+
+            case EToken::OpenBracket:
+               if (!NextSelectorToken(BitsOf({ EToken::Index, EToken::Exclamation, EToken::Dollar }), EPathError::InvalidIndex))
+                  return ESelector::Invalid;
+
+               if (m_curToken.id == EToken::Dollar)
+               {
+                  if (!ReadTypePredicate(selector.type) || !NextSelectorToken(BitsOf({ EToken::CloseBracket })))
+                     return ESelector::Invalid;
+                  m_periodAllowed = true;
+                  selector.selector = ESelector::TypeFilter;
+                  return selector.selector;
+               }
+
+               selector.required = m_curToken.id == EToken::Exclamation;
+               if (selector.required && !NextSelectorToken(BitsOf({ EToken::Index }), EPathError::InvalidIndex))
+                  return ESelector::Invalid;
+
+               selector.index = m_curToken.index;
+               if (!NextSelectorToken(selector.required ? BitsOf({ EToken::Minus }) : BitsOf({ EToken::CloseBracket, EToken::Minus })))
+                  return ESelector::Invalid;
+
+               m_periodAllowed = true;
+               selector.selector = ESelector::Index;
+               if (m_curToken.id == EToken::Minus)
+                  return ReadSlice(selector);
+               return selector.selector;
+
+            case EToken::OpenBrace:
+            {
+               selector.firstKV = kvCount;
+               auto Add = [&](StaticKVPair const & kvp)
+               {
+                  if (kvCount == N)
+                     ThrowStaticPathError({});     // more map filter items than StaticPath::MaxKVPairs
+                  kvs[kvCount++] = kvp;
+               };
+
+               while (true)
+               {
+                  const bool joined = kvCount > selector.firstKV && kvs[kvCount - 1].joined;
+                  const auto keyEnd = joined ? BitsOf({ EToken::Tilde, EToken::Equal }) : BitsOf({ EToken::Tilde, EToken::Equal, EToken::Comma, EToken::CloseBrace });
+                  StaticKVPair kvp;
+                  if (!joined && PeekSelectorToken(BitsOf({ EToken::Dollar })))
+                  {
+                     if (!ReadTypePredicate(kvp.valueType) || !NextSelectorToken(BitsOf({ EToken::Comma, EToken::CloseBrace })))
+                        return ESelector::Invalid;
+                     kvp.op = EKVOp::Select;
+                     Add(kvp);
+                     if (m_curToken.id == EToken::Comma)
+                        continue;
+                     break;
+                  }
+
+                  if (!ReadKVToken(kvp.key, keyEnd))
+                     return ESelector::Invalid;
+
+                  if (!NextSelectorToken(keyEnd))
+                     return ESelector::Invalid;
+
+                  bool atEnd = false;
+                  switch (m_curToken.id)
+                  {
+                     case EToken::Tilde:
+                        if (!NextSelectorToken(BitsOf({ EToken::Equal })))
+                           return ESelector::Invalid;
+                        kvp.op = EKVOp::NotEqual;
+                        break;
+
+                     case EToken::Equal:
+                        kvp.op = EKVOp::Equal;
+                        break;
+
+                     case EToken::Comma:
+                        kvp.op = EKVOp::Select;
+                        Add(kvp);
+                        continue;
+
+                     default:    // CloseBrace
+                        kvp.op = EKVOp::Select;
+                        Add(kvp);
+                        atEnd = true;
+                        break;
+                  }
+                  if (atEnd)
+                     break;
+
+                  const auto conditionEnd = BitsOf({ EToken::Comma, EToken::CloseBrace, EToken::Ampersand });
+                  if (PeekSelectorToken(conditionEnd))
+                  {
+                     m_tokenPending = true;
+                     if (kvp.op == EKVOp::NotEqual)
+                        return SetError(EPathError::InvalidToken), ESelector::Invalid;
+                     kvp.op = EKVOp::Exists;
+                  }
+                  else if (!ReadKVToken(kvp.value, conditionEnd))
+                     return ESelector::Invalid;
+
+                  if (!NextSelectorToken(conditionEnd))
+                     return ESelector::Invalid;
+
+                  kvp.joined = m_curToken.id == EToken::Ampersand;
+                  Add(kvp);
+                  if (m_curToken.id != EToken::CloseBrace)
+                     continue;
+
+                  break;
+               }
+
+               selector.kvCount = kvCount - selector.firstKV;
+               m_periodAllowed = true;
+               selector.selector = ESelector::MapFilter;
+               return selector.selector;
+            }
+
+            default:
+               return ESelector::Invalid;
+         }
+      }
+   }
+
+   constexpr StaticPath::StaticPath(PathArg path) : m_path(path)
+   {
+      // the selector loop of PathCompiler::Compile
+      YamlPathDetail::StaticScanner scan(path);
+      while (scan)
+      {
+         YamlPathDetail::StaticSelector selector;
+         auto id = scan.NextSelector(selector, m_kvs, m_kvCount);
+         if (id == YamlPathDetail::ESelector::Invalid)
+            YamlPathDetail::ThrowStaticPathError(path);
+         if (id == YamlPathDetail::ESelector::None)
+            break;
+
+         if (m_selectorCount == MaxSelectors)
+            YamlPathDetail::ThrowStaticPathError({});    // more selectors than MaxSelectors
+         m_selectors[m_selectorCount++] = selector;
+      }
+   }
+}
@@ -0,0 +1,450 @@
+/*
+MIT License
+
+Copyright(c) 2019 Peter Hauptmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "yaml-path.h"
+#include "yaml-path-internals.h"
+#include <yaml-cpp/yaml.h>
+#include <yaml-cpp/eventhandler.h>
+#include <yaml-cpp/parser.h>
+#include <assert.h>
+#include <istream>
+#include <vector>
+
+namespace YAML
+{
+   namespace YamlPathDetail
+   {
+      namespace
+      {
+         /// \internal thrown by \ref EventSelector to stop the parser when nothing else can be selected
+         struct StopStream {};
+      }
+
+      /** \internal runs a compiled path on the events of a YAML \c Parser, see \ref SelectStream.
+
+          Each node of the document is read with a \ref Task, given by the container it is in (the root by \c Single(0)). 
+          The containers being read are on a stack of frames:
+
+          - \c Skip: a container that cannot be selected. Its nodes are skipped.
+          - \c MapKey: a map the key selector is applied to. The value of the first matching key gets the next task.
+          - \c FanOut: a sequence a key selector, map filter or type filter fans out over. Each element gets an \c Element task.
+          - \c SeqIndex: a sequence the index selector is applied to. Only the selected element gets the next task.
+          - \c SeqSlice: a sequence a slice selector fans out over. Each element in the slice gets an \c Element task.
+          - \c Build: a node being built, possibly with the task to apply to it when it is complete.
+
+          A node is built when the path needs all of it: at the end of the path, for a map filter or a recursive key, and if it has an anchor.
+          A required slice builds the sequence, to see if all of its positions exist. A slice applied to the elements of a fan-out builds each element.
+          The remaining selectors are applied to a built node by \ref PathStream, so the node-based and the event-based 
+          resolution give the same results. Scalars are built when they are used, since that is cheap.
+      */
+      class EventSelector : public EventHandler
+      {
+      public:
+         EventSelector(CompiledPathData const & cp, PathStream & nodes) : m_cp(cp), m_nodes(nodes) {}
+
+         void OnDocumentStart(Mark const &) override {}
+         void OnDocumentEnd() override {}
+
+         void OnNull(Mark const &, anchor_t anchor) override;
+         void OnAlias(Mark const &, anchor_t anchor) override;
+         void OnScalar(Mark const &, std::string const & tag, anchor_t anchor, std::string const & value) override;
+
+         void OnSequenceStart(Mark const &, std::string const & tag, anchor_t anchor, EmitterStyle::value style) override { Begin(NodeType::Sequence, tag, anchor, style); }
+         void OnSequenceEnd() override { End(); }
+         void OnMapStart(Mark const &, std::string const & tag, anchor_t anchor, EmitterStyle::value style) override { Begin(NodeType::Map, tag, anchor, style); }
+         void OnMapEnd() override { End(); }
+
+      private:
+         enum class ETask { Skip, MapKey, Build, Single, Element };
+         static constexpr size_t NoFrame = size_t(-1);
+
+         /// \internal what to do with a node. \c Single and \c Element apply the selectors from \c selector on, like \ref PathStream does
+         struct Task
+         {
+            ETask kind = ETask::Skip;
+            size_t selector = 0;
+            size_t fanOut = NoFrame;   ///< \c Element: the frame counting the elements that reach an index selector
+            bool last = false;         ///< nothing can be selected after this node
+         };
+
+         enum class EFrame { Skip, MapKey, FanOut, SeqIndex, SeqSlice, Build };
+
+         struct Frame
+         {
+            EFrame kind = EFrame::Skip;
+            Task task;                 ///< the task of the container
+            size_t children = 0;       ///< the number of complete child nodes. In a map, the even children are keys.
+            Task next;                 ///< \c MapKey, \c SeqIndex: the task of the selected child. \c FanOut, \c SeqSlice: the task of each element
+            PathArg key;               ///< \c MapKey: the key to select
+            size_t index = 0;          ///< \c SeqIndex: the position to select. \c FanOut, \c SeqSlice: the elements counted by an index selector
+            ArgSlice const * slice = nullptr;   ///< \c SeqSlice: the positions to select
+            bool matched = false;      ///< \c MapKey: the last key read matches \c key
+            bool found = false;        ///< \c MapKey: the value was selected
+            Node node;                 ///< \c Build: the node built. Set by \c Node::reset, \c operator= would assign to the node referred to
+            Node mapKey;               ///< \c Build of a map: the key of the next value
+         };
+
+         CompiledPathData const & m_cp;
+         PathStream & m_nodes;
+         std::vector<Frame> m_frames;
+         std::vector<Node> m_anchors;
+         Task m_root{ ETask::Single };
+         size_t m_fanOuts = 0;         ///< the number of \c FanOut and \c SeqSlice frames
+
+         static bool IsFanOut(EFrame kind) { return kind == EFrame::FanOut || kind == EFrame::SeqSlice; }
+
+         Task ChildTask();
+         void ChildDone();
+         void Begin(NodeType::value type, std::string const & tag, anchor_t anchor, EmitterStyle::value style);
+         void Dispatch(Task const & task, NodeType::value type, std::string const & tag, EmitterStyle::value style);
+         void Push(EFrame kind, Task const & task, Task const & next);
+         void Push(EFrame kind, Task const & task) { Push(kind, task, Task{}); }
+         void PushFanOut(Task const & task);
+         void PushBuild(Task const & task, NodeType::value type, std::string const & tag, anchor_t anchor, EmitterStyle::value style);
+         void End();
+         void Atomic(Task const & task, Node const & node, anchor_t anchor);
+         void Finish(Task const & task, Node const & node);
+         void Anchor(anchor_t anchor, Node const & node);
+      };
+
+      /// \internal the task of the next node in the current container
+      EventSelector::Task EventSelector::ChildTask()
+      {
+         if (m_frames.empty())
+            return std::exchange(m_root, Task{});     // the document root, once
+
+         auto & f = m_frames.back();
+         switch (f.kind)
+         {
+            case EFrame::MapKey:
+               if (f.found)
+                  return {};
+               if (f.children % 2 == 0)
+               {
+                  f.matched = false;
+                  return { ETask::MapKey };
+               }
+               if (!f.matched)
+                  return {};
+               f.found = true;
+               return f.next;
+
+            case EFrame::FanOut:    return f.next;
+            case EFrame::SeqIndex:  return f.children == f.index ? f.next : Task{};
+            case EFrame::SeqSlice:
+            {
+               auto && slice = *f.slice;
+               if (f.children < slice.first || (f.children - slice.first) % slice.step)
+                  return {};
+               Task next = f.next;
+               next.last = f.children == slice.Last();   // the fan-out ends with this element
+               return next;
+            }
+            case EFrame::Build:     return { ETask::Build };
+            default:                return {};
+         }
+      }
+
+      /// \internal a child of the current container is complete. Stops if nothing else can be selected.
+      void EventSelector::ChildDone()
+      {
+         if (m_frames.empty())
+            return;
+
+         auto & f = m_frames.back();
+         ++f.children;
+         if (m_fanOuts == 0)
+         {
+            bool selected = (f.kind == EFrame::MapKey && f.found && f.children % 2 == 0) || (f.kind == EFrame::SeqIndex && f.children > f.index);
+            if (selected)
+               throw StopStream();      // the surrounding frames are MapKey and SeqIndex frames that selected this one
+         }
+      }
+
+      void EventSelector::Begin(NodeType::value type, std::string const & tag, anchor_t anchor, EmitterStyle::value style)
+      {
+         Task task = ChildTask();
+         if (task.kind == ETask::Build || anchor != NullAnchor)
+            PushBuild(task, type, tag, anchor, style);
+         else if (task.kind == ETask::Single || task.kind == ETask::Element)
+            Dispatch(task, type, tag, style);
+         else
+            Push(EFrame::Skip, task);     // a map key can only be matched by a scalar
+      }
+
+      /// \internal starts reading a container (without anchor) with a \c Single or \c Element task
+      void EventSelector::Dispatch(Task const & task, NodeType::value type, std::string const & tag, EmitterStyle::value style)
+      {
+         size_t i = task.selector;
+         if (i == m_cp.selectors.size())
+            return PushBuild(task, type, tag, NullAnchor, style);
+
+         bool isMap = type == NodeType::Map;
+         bool single = task.kind == ETask::Single;
+         auto && data = m_nodes.Data(i);
+         switch (m_cp.selectors[i].selector)
+         {
+            case ESelector::Key:
+               if (isMap)
+               {
+                  Push(EFrame::MapKey, task, { task.kind, i + 1, task.fanOut });
+                  m_frames.back().key = std::get<ArgKey>(data).key;
+               }
+               else if (single)
+                  PushFanOut(task);
+               else
+                  Push(EFrame::Skip, task);
+               return;
+
+            case ESelector::MapFilter:
+               if (isMap)
+                  PushBuild(task, type, tag, NullAnchor, style);
+               else if (single)
+                  PushFanOut(task);
+               else
+                  Push(EFrame::Skip, task);
+               return;
+
+            case ESelector::Index:
+            {
+               size_t index = std::get<ArgIndex>(data).index;
+               if (!single)
+               {
+                  if (m_frames[task.fanOut].index++ < index)
+                     Push(EFrame::Skip, task);
+                  else
+                     Dispatch({ ETask::Single, i + 1, NoFrame, true }, type, tag, style);    // the fan-out ends with this element
+               }
+               else if (isMap)
+               {
+                  if (index == 0)
+                     Dispatch({ ETask::Single, i + 1, NoFrame, task.last }, type, tag, style);     // [0] of a map is the map itself
+                  else
+                     Push(EFrame::Skip, task);
+               }
+               else
+               {
+                  Push(EFrame::SeqIndex, task, { ETask::Single, i + 1 });
+                  m_frames.back().index = index;
+               }
+               return;
+            }
+
+            case ESelector::RecursiveKey:
+               PushBuild(task, type, tag, NullAnchor, style);     // the values can be anywhere below, and nested in each other
+               return;
+
+            case ESelector::Slice:
+            {
+               auto && slice = std::get<ArgSlice>(data);
+               if (single && !isMap && !slice.required)
+               {
+                  m_nodes.BeginFanOut(i);
+                  Push(EFrame::SeqSlice, task, { ETask::Element, i + 1, m_frames.size() });
+                  m_frames.back().slice = &slice;
+               }
+               else
+                  PushBuild(task, type, tag, NullAnchor, style);
+               return;
+            }
+
+            case ESelector::TypeCheck:
+            case ESelector::TypeFilter:
+               // the type is known from the event: the container is not built
+               if (single && !isMap && m_cp.selectors[i].selector == ESelector::TypeFilter)
+                  PushFanOut(task);    // each element checks its type, like an element of a fan-out
+               else if (type == std::get<ArgNodeType>(data).type)
+                  Dispatch({ task.kind, i + 1, task.fanOut, task.last }, type, tag, style);
+               else
+                  Push(EFrame::Skip, task);
+               return;
+
+            default:
+               assert(false);    // no other selectors supported right now
+               Push(EFrame::Skip, task);
+         }
+      }
+
+      void EventSelector::Push(EFrame kind, Task const & task, Task const & next)
+      {
+         auto & f = m_frames.emplace_back();
+         f.kind = kind;
+         f.task = task;
+         f.next = next;
+         if (IsFanOut(kind))
+            ++m_fanOuts;
+      }
+
+      /// \internal a sequence the selector of \c task fans out over
+      void EventSelector::PushFanOut(Task const & task)
+      {
+         m_nodes.BeginFanOut(task.selector);
+         Push(EFrame::FanOut, task, { ETask::Element, task.selector, m_frames.size() });
+      }
+
+      void EventSelector::PushBuild(Task const & task, NodeType::value type, std::string const & tag, anchor_t anchor, EmitterStyle::value style)
+      {
+         Push(EFrame::Build, task);
+         auto & node = m_frames.back().node;
+         node.reset(Node(type));
+         node.SetTag(tag);
+         node.SetStyle(style);
+         Anchor(anchor, node);      // before the children: they may refer to it
+      }
+
+      void EventSelector::End()
+      {
+         Frame f = std::move(m_frames.back());
+         m_frames.pop_back();
+         if (IsFanOut(f.kind))
+            --m_fanOuts;
+
+         if (f.kind == EFrame::Build)
+            Finish(f.task, f.node);
+         else if (f.task.last)
+            throw StopStream();
+         ChildDone();
+      }
+
+      void EventSelector::OnNull(Mark const &, anchor_t anchor)
+      {
+         Task task = ChildTask();
+         if (task.kind >= ETask::Build || anchor != NullAnchor)
+            Atomic(task, Node(NodeType::Null), anchor);
+         ChildDone();
+      }
+
+      void EventSelector::OnScalar(Mark const &, std::string const & tag, anchor_t anchor, std::string const & value)
+      {
+         Task task = ChildTask();
+         if (task.kind == ETask::MapKey)
+            m_frames.back().matched = value == m_frames.back().key;
+         if (task.kind >= ETask::Build || anchor != NullAnchor)
+         {
+            Node node(value);
+            node.SetTag(tag);
+            Atomic(task, node, anchor);
+         }
+         ChildDone();
+      }
+
+      void EventSelector::OnAlias(Mark const &, anchor_t anchor)
+      {
+         Task task = ChildTask();
+         Node node = anchor < m_anchors.size() ? m_anchors[anchor] : Node(NodeType::Null);
+         if (task.kind == ETask::MapKey)
+            m_frames.back().matched = node.IsScalar() && node.Scalar() == m_frames.back().key;
+         if (task.kind >= ETask::Build)
+            Finish(task, node);
+         ChildDone();
+      }
+
+      void EventSelector::Atomic(Task const & task, Node const & node, anchor_t anchor)
+      {
+         Anchor(anchor, node);
+         Finish(task, node);
+      }
+
+      /// \internal a node is built: adds it to the parent being built, or applies the remaining selectors
+      void EventSelector::Finish(Task const & task, Node const & node)
+      {
+         switch (task.kind)
+         {
+            case ETask::Build:
+            {
+               auto & parent = m_frames.back();
+               if (parent.node.IsSequence())
+                  parent.node.push_back(node);
+               else if (parent.children % 2 == 0)
+                  parent.mapKey.reset(node);
+               else
+                  parent.node.force_insert(parent.mapKey, node);
+               break;
+            }
+
+            case ETask::Single:
+               if (!m_nodes.Single(task.selector, node))
+                  throw StopStream();
+               break;
+
+            case ETask::Element:
+               if (!m_nodes.Element(task.selector, node, m_frames[task.fanOut].index))
+                  throw StopStream();
+               break;
+
+            default:
+               break;      // an anchored node that is not selected
+         }
+         if (task.last)
+            throw StopStream();
+      }
+
+      void EventSelector::Anchor(anchor_t anchor, Node const & node)
+      {
+         if (anchor == NullAnchor)
+            return;
+         if (anchor >= m_anchors.size())
+            m_anchors.resize(anchor + 1);
+         m_anchors[anchor].reset(node);
+      }
+
+      CompiledPathData const & StreamPathData(CompiledPath const & path)
+      {
+         static const CompiledPathData wholeDocument;
+         auto cp = PathCompiler::Data(path);
+         if (!cp)
+            return wholeDocument;
+         if (cp->error.Error() != EPathError::OK)
+            throw cp->error;
+         return *cp;
+      }
+
+      bool StreamDocument(std::istream & input, CompiledPathData const & cp, NodeVisitor const & visitor, size_t & visited, PathContext const * context)
+      {
+         ScratchScope scratch(context);
+         PathStream nodes(cp, visitor, context);
+         nodes.Bind(nullptr, 0);
+         EventSelector selector(cp, nodes);
+         Parser parser(input);
+         bool document = true;
+         try
+         {
+            document = parser.HandleNextDocument(selector);
+         }
+         catch (StopStream const &)
+         {
+         }
+         visited += nodes.Visited();
+         return document;
+      }
+
+      size_t VisitStream(std::istream & input, CompiledPath const & path, NodeVisitor const & visitor, PathContext const * context)
+      {
+         auto && cp = StreamPathData(path);
+         size_t visited = 0;
+         StreamDocument(input, cp, visitor, visited, context);
+         return visited;
+      }
+   }
+}
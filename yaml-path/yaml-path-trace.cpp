@@ -0,0 +1,192 @@
+/*
+MIT License
+
+Copyright(c) 2019 Peter Hauptmann
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files(the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "yaml-path.h"
+#include "yaml-path-internals.h"
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+
+/* Profiling events (PathTracer) and the statistics collected from them (PathStats)
+
+   ResolveNodes and ResolveStatic report each selector through a PathTraceScope, SelectEach reports the path only.
+   The time of a selector includes binding deferred arguments, the time of a path does not include 
+   creating the result sequence of Select.
+*/
+
+namespace YAML
+{
+   namespace YamlPathDetail
+   {
+      PathTraceScope::PathTraceScope(PathContext const * context, PathArg path) : m_tracer(context ? context->Tracer() : nullptr)
+      {
+         if (!m_tracer)
+            return;
+         m_path.path = path;
+         m_pathStart = Clock::now();
+      }
+
+      void PathTraceScope::Begin(size_t position, ESelector selector, Node const & node, NodeSet const & nodes)
+      {
+         m_selector = PathSelectorTrace();
+         m_selector.selector = selector;
+         m_selector.position = position;
+         m_selector.input = Count(node, nodes);
+         m_selectorStart = Clock::now();
+      }
+
+      void PathTraceScope::End(Node const & node, NodeSet const & nodes, EPathError err)
+      {
+         m_selector.nanoseconds = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_selectorStart).count());
+         m_selector.output = err == EPathError::OK ? Count(node, nodes) : 0;
+         m_path.keysScanned += m_selector.keysScanned;
+         ++m_path.selectors;
+         m_tracer->OnSelector(m_path.path, m_selector);
+      }
+
+      void PathTraceScope::End(EPathError err, size_t output)
+      {
+         m_path.nanoseconds = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_pathStart).count());
+         m_path.error = err;
+         m_path.output = output;
+         m_tracer->OnPath(m_path);
+      }
+
+      /// \internal the entries of a \ref PathStats, by path
+      struct PathStatsData
+      {
+         mutable std::mutex lock;
+         std::map<std::string, PathStatsEntry, std::less<>> entries;
+
+         PathStatsEntry & Entry(PathArg path)
+         {
+            auto it = entries.find(path);
+            if (it == entries.end())
+            {
+               it = entries.emplace(std::string(path), PathStatsEntry()).first;
+               it->second.path = it->first;
+            }
+            return it->second;
+         }
+      };
+   }
+
+   using namespace YamlPathDetail;
+
+   char const * PathSelectorName(ESelector selector)
+   {
+      return MapValue(selector, MapESelectorName, "");
+   }
+
+   PathStats::PathStats() : m_data(std::make_unique<PathStatsData>()) {}
+   PathStats::~PathStats() = default;
+
+   void PathStats::OnSelector(PathArg path, PathSelectorTrace const & trace)
+   {
+      std::lock_guard<std::mutex> lock(m_data->lock);
+      auto && selectors = m_data->Entry(path).selectors;
+      if (selectors.size() <= trace.position)
+         selectors.resize(trace.position + 1);
+
+      auto && s = selectors[trace.position];
+      s.selector = trace.selector;
+      s.input += trace.input;
+      s.output += trace.output;
+      s.keysScanned += trace.keysScanned;
+      s.nanoseconds += trace.nanoseconds;
+   }
+
+   void PathStats::OnPath(PathTrace const & trace)
+   {
+      std::lock_guard<std::mutex> lock(m_data->lock);
+      auto && entry = m_data->Entry(trace.path);
+      ++entry.calls;
+      entry.errors += trace.error != EPathError::OK;
+      entry.output += trace.output;
+      entry.keysScanned += trace.keysScanned;
+      entry.nanoseconds += trace.nanoseconds;
+      entry.maxNanoseconds = std::max(entry.maxNanoseconds, trace.nanoseconds);
+   }
+
+   std::vector<PathStatsEntry> PathStats::Slowest(size_t count) const
+   {
+      std::vector<PathStatsEntry> result;
+      {
+         std::lock_guard<std::mutex> lock(m_data->lock);
+         result.reserve(m_data->entries.size());
+         for (auto && e : m_data->entries)
+            result.push_back(e.second);
+      }
+
+      auto slower = [](PathStatsEntry const & a, PathStatsEntry const & b) { return a.nanoseconds != b.nanoseconds ? a.nanoseconds > b.nanoseconds : a.path < b.path; };
+      count = std::min(count, result.size());
+      std::partial_sort(result.begin(), result.begin() + count, result.end(), slower);
+      result.resize(count);
+      return result;
+   }
+
+   /** The table lists, for each path, the number of calls and errors, the total, mean and maximum time in microseconds,
+       and the nodes selected and map keys read per call. The selectors of a path follow it, with their total time,
+       the nodes they selected, the keys they read, and the nodes they were applied to per call.
+   */
+   void PathStats::Dump(std::ostream & out, size_t count) const
+   {
+      auto us = [](double ns) { return ns / 1000.0; };
+      auto flags = out.flags();
+      auto precision = out.precision();
+      out << std::fixed << std::setprecision(1);
+      out << std::left << std::setw(40) << "path" << std::right << std::setw(10) << "calls" << std::setw(8) << "errors"
+          << std::setw(12) << "total us" << std::setw(10) << "mean us" << std::setw(10) << "max us" 
+          << std::setw(12) << "nodes/call" << std::setw(12) << "keys/call" << "\n";
+
+      for (auto && e : Slowest(count))
+      {
+         double calls = double(std::max<uint64_t>(e.calls, 1));
+         out << std::left << std::setw(40) << e.path << std::right << std::setw(10) << e.calls << std::setw(8) << e.errors
+             << std::setw(12) << us(double(e.nanoseconds)) << std::setw(10) << us(e.MeanNanoseconds()) << std::setw(10) << us(double(e.maxNanoseconds))
+             << std::setw(12) << double(e.output) / calls << std::setw(12) << double(e.keysScanned) / calls << "\n";
+
+         for (size_t i = 0; i < e.selectors.size(); ++i)
+         {
+            auto && s = e.selectors[i];
+            std::string label = "   [" + std::to_string(i) + "] " + PathSelectorName(s.selector);
+            out << std::left << std::setw(58) << label << std::right << std::setw(12) << us(double(s.nanoseconds)) << std::setw(20) << ""
+                << std::setw(12) << double(s.output) / calls << std::setw(12) << double(s.keysScanned) / calls 
+                << "   input/call " << double(s.input) / calls << "\n";
+         }
+      }
+
+      out.flags(flags);
+      out.precision(precision);
+   }
+
+   void PathStats::Clear()
+   {
+      std::lock_guard<std::mutex> lock(m_data->lock);
+      m_data->entries.clear();
+   }
+}
@@ -27,8 +27,15 @@ SOFTWARE.
 #include <yaml-cpp/yaml.h>
 #include <assert.h>
 #include <algorithm>
+#include <atomic>
 #include <cstring>
-#include <strings.h>
+#include <exception>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define YAML_PATH_SSE2
+#include <emmintrin.h>
+#endif
 
 /// namspace shared by yaml-cpp and yaml-path
 namespace YAML
@@ -36,10 +43,9 @@ namespace YAML
 
    EPathError SelectByKey(Node & node, PathArg key)
    {
-      // possible optimizations: reserve for a node sequence, node[string_view] without copy-to-string
       if (node.IsMap())
       {
-         Node result = node[std::string(key)];
+         Node result = YamlPathDetail::FindKey(node, key);
          if (!result)
             return EPathError::NodeNotFound;
 
@@ -48,16 +54,10 @@ namespace YAML
       }
       else if (node.IsSequence())
       {
-         Node result;
-         for (auto && el : node)
-         {
-            Node val = el[std::string(key)];
-            if (val)
-               result.push_back(val);
-         }
-         if (!result.IsSequence())    // first call to push-back turns this into a sequence
-            return EPathError::NodeNotFound;
-         node.reset(result);
+         YamlPathDetail::NodeSet result;
+         if (auto err = YamlPathDetail::FanOutKey(node, key, result); err != EPathError::OK)
+            return err;
+         node.reset(result.ToNode());
          return EPathError::OK;
       }
       return EPathError::InvalidNodeType;
@@ -76,7 +76,8 @@ namespace YAML
          if (index >= node.size())
             return EPathError::NodeNotFound;
 
-         node.reset(node[index]);
+         Node const & sequence = node;    // const lookup, never modifies the document
+         node.reset(sequence[index]);
          return EPathError::OK;
       }
       return EPathError::InvalidNodeType;
@@ -91,7 +92,7 @@ namespace YAML
       {
          T1 result = std::move(target);
          target = std::move(newValue);
-         return std::move(result);
+         return result;
       }
 
       /// \internal uses the same mapping as \ref MapValue to create diagnostic for a bit mask (e.g. created by \ref BitsOf)
@@ -134,6 +135,9 @@ namespace YAML
          { EToken::Asterisk, "asterisk" },
          { EToken::Tilde, "tilde" },
          { EToken::Comma, "comma" },
+         { EToken::Minus, "minus" },
+         { EToken::Ampersand, "ampersand" },
+         { EToken::Dollar, "dollar" },
       };
 
       /// \internal name mapping for yaml-cpp node type
@@ -152,6 +156,10 @@ namespace YAML
          { ESelector::Index,  "index" },
          { ESelector::Key,    "key" },
          { ESelector::MapFilter, "map filter" },
+         { ESelector::RecursiveKey, "recursive key" },
+         { ESelector::Slice, "slice" },
+         { ESelector::TypeCheck, "type check" },
+         { ESelector::TypeFilter, "type filter" },
          { ESelector::None, "(none)" },
          { ESelector::Invalid, "(invalid)" },
       };
@@ -167,6 +175,7 @@ namespace YAML
          { EPathError::NodeNotFound,      "no node matches selector" },
          { EPathError::UnexpectedEnd,     "unexpected end of path" },
          { EPathError::SelectorNotSupported, "selector not supported by this operation" },
+         { EPathError::MissingArg,        "not enough bound arguments" },
       };
 
       // ----- Utility functions
@@ -178,6 +187,114 @@ namespace YAML
          return undefinedNode;
       }
 
+      /** \internal returns the value for \c key if \c node is a map containing that key, an undefined node otherwise. 
+
+          Scalar keys are compared in place. Unlike <code>node[std::string(key)]</code>, this does not create a string, 
+          does not convert every key of the map to a \c std::string for the comparison, 
+          and does not insert \c key into the map if it is missing.
+      */
+      Node FindKey(Node const & node, PathArg key)
+      {
+         if (node.IsMap())
+         {
+            for (auto it = node.begin(), end = node.end(); it != end; ++it)
+            {
+               auto && kv = *it;
+               if (kv.first.IsScalar() && kv.first.Scalar() == key)
+                  return kv.second;
+            }
+         }
+         return UndefinedNode();
+      }
+
+      /** \internal serializes operations that merge the memory of a new node with the memory of a document.
+
+          Reading a document only reads the shared memory holder. Creating a node that refers to document nodes
+          (a result sequence, the map created by key selection) changes the memory of the document, 
+          so concurrent \ref Select calls on one document take this lock while they do that.
+      */
+      std::mutex & MemoryLock()
+      {
+         static std::mutex lock;
+         return lock;
+      }
+
+      /** \internal creates the YAML sequence.
+
+          The nodes of a YAML document are owned by a memory object shared by all nodes of the document. 
+          <tt>result.push_back(n)</tt> merges the memory of \c n into the memory of \c result, i.e. it copies 
+          the set of all document nodes if \c result is a new node. Instead, the (single node) memory of \c result 
+          is merged into the document memory first: the const <tt>operator[](Node)</tt> merges the memory of the key 
+          into the memory of the indexed node, without modifying either node. 
+          The following \c push_back calls then don't need to merge.
+      */
+      Node NodeSet::ToNode() const
+      {
+         std::lock_guard<std::mutex> lock(MemoryLock());
+         Node result(NodeType::Sequence);
+         if (!m_nodes.empty())
+            (void)m_nodes.front()[result];
+
+         for (auto && n : m_nodes)
+            result.push_back(n);
+         return result;
+      }
+
+      inline size_t ElementCount(Node const & sequence) { return sequence.size(); }
+      inline size_t ElementCount(NodeSet const & nodes) { return nodes.Size(); }
+
+      /** \internal applies \c key to every element of \c elements (a sequence node or a \ref NodeSet), 
+          adding the values found to \c result. Elements that are not maps are skipped.
+      */
+      template <typename TElements>
+      EPathError FanOutKey(TElements const & elements, PathArg key, NodeSet & result)
+      {
+         result.Reserve(ElementCount(elements));     // upper bound: most elements of a uniform sequence have the key
+         for (auto && el : elements)
+         {
+            if (Node val = FindKey(el, key))
+               result.Add(val);
+         }
+         return result.Empty() ? EPathError::NodeNotFound : EPathError::OK;
+      }
+
+
+      /// \internal the walk of \ref VisitDescendantKeys without an index
+      bool WalkDescendantKeys(Node const & node, PathArg key, NodeVisitor const & visitor)
+      {
+         if (node.IsMap())
+         {
+            if (Node value = FindKey(node, key))
+               if (!visitor(value))
+                  return false;
+            for (auto && kv : node)
+               if (!WalkDescendantKeys(kv.second, key, visitor))
+                  return false;
+         }
+         else if (node.IsSequence())
+         {
+            for (auto && el : node)
+               if (!WalkDescendantKeys(el, key, visitor))
+                  return false;
+         }
+         return true;
+      }
+
+      /** \internal visits the values of \c key in \c node and all maps below it, in document order (the maps before their values).
+          The values are taken from a \ref DocumentIndex of \c context if there is one for the document, 
+          otherwise the nodes are walked. Returns \c false if \c visitor stopped it.
+      */
+      bool VisitDescendantKeys(Node const & node, PathArg key, PathContext const * context, NodeVisitor const & visitor)
+      {
+         if (auto lookup = LookupDocumentIndex(context, node, key))
+         {
+            for (auto it = lookup->begin; it != lookup->end; ++it)
+               if (!visitor(it->value))
+                  return false;
+            return true;
+         }
+         return WalkDescendantKeys(node, key, visitor);
+      }
 
       /** \internal splits path at offset, 
           returning everything left of [offset], assigning everything right of it to \c path. 
@@ -201,8 +318,8 @@ namespace YAML
          // Generate error when ValidTokens are specified:
          m_curToken = { id, std::move(p) };
 
-         if (id != EToken::Invalid && m_diags)
-            m_diags->m_offsTokenScan = ScanOffset();
+         if (id != EToken::Invalid)
+            m_offsToken = ScanOffset();
 
          /* skipping whitespace after token, so that if this was the last token,
             we get to the end of the string and operator bool becomes false */
@@ -215,8 +332,8 @@ namespace YAML
       {
          m_curToken = { id, {}, index };
 
-         if (id != EToken::Invalid && m_diags)
-            m_diags->m_offsTokenScan = ScanOffset();
+         if (id != EToken::Invalid)
+            m_offsToken = ScanOffset();
 
          SkipWS();
          return m_curToken;
@@ -226,13 +343,15 @@ namespace YAML
       void PathScanner::SkipWS()
       {
          // non-ascii chars are NOT considered whitespace
-         Split(m_rpath, [](char c) { return isascii(c) && isspace(c); });
+         Split(m_rpath, [](char c) { return CharClass(c).space; });
       }
 
-      inline PathScanner::PathScanner(PathArg p, PathBoundArgs args, PathException * diags) : m_rpath(p), m_args(args), m_diags(diags), m_fullPath(p)
+      PathScanner::PathScanner(PathArg p, PathBoundArgs args, PathException * diags) : PathScanner(p, args.begin(), args.size(), diags)
+      {
+      }
+
+      PathScanner::PathScanner(PathArg p, PathBoundArg const * args, size_t argCount, PathException * diags) : m_rpath(p), m_args(args), m_argCount(argCount), m_fullPath(p), m_diags(diags)
       {
-         if (m_diags)
-            *m_diags = PathException();
          SkipWS();
       }
 
@@ -248,20 +367,7 @@ namespace YAML
 
          // single-char special tokens
          char head = m_rpath[0];
-         EToken t = MapValue(head, {
-            { '.', EToken::Period },
-            { '[', EToken::OpenBracket },
-            { ']', EToken::CloseBracket },
-            { '{', EToken::OpenBrace },
-            { '}', EToken::CloseBrace },
-            { '=', EToken::Equal },
-            { '%', EToken::FetchArg },
-            { '!', EToken::Exclamation },
-            { '^', EToken::Caret },
-            { '*', EToken::Asterisk },
-            { '~', EToken::Tilde },
-            { ',', EToken::Comma },
-            }, EToken::None);
+         EToken t = CharClass(head).token;
 
          if (t != EToken::None)
          {
@@ -280,7 +386,7 @@ namespace YAML
          }
 
          // unquoted token. non-ascii characters ARE treated as part of the token.
-         auto result = Split(m_rpath, [](char c) { return !isascii(c) || !(isspace(c) || ispunct(c)); });
+         auto result = Split(m_rpath, [](char c) { return CharClass(c).identifier; });
          if (result.empty())
             return SetError(EPathError::InvalidToken), m_curToken;
 
@@ -294,9 +400,14 @@ namespace YAML
          m_error = error;
          if (m_diags)
          {
+            // diagnostics are only recorded now: the scan state up to here is kept by the scanner itself
+            *m_diags = PathException();
             m_diags->m_fullPath = m_fullPath;
             m_diags->m_error = error;
             m_diags->m_validTypes = validTypes;
+            m_diags->m_offsTokenScan = m_offsToken;
+            m_diags->m_offsSelectorScan = m_offsSelector;
+            m_diags->m_fromBoundArg = m_fromBoundArg;
 
             if (PathException::IsPathError(error))
                m_diags->m_errorType = (decltype(m_diags->m_errorType))m_curToken.id;
@@ -365,16 +476,32 @@ namespace YAML
          // Fetch argument from argument list if required
          if (m_curToken.id == EToken::FetchArg)
          {
-            auto & v = m_args.begin()[m_argIdx];
-            if (m_diags)
-               m_diags->m_fromBoundArg = m_argIdx;
-            ++m_argIdx;
+            m_fromBoundArg = m_argIdx;
 
-            switch (v.index())
+            if (m_argSlots)
             {
-               case 0:  SetToken(EToken::Index, std::get<size_t>(v)); break;
-               case 1:  SetToken(EToken::QuotedIdentifier, std::get<std::string_view>(v)); break;
-               default: SetError(EPathError::Internal); return false;      // TODO: InvalidArg error code?
+               // placeholder for a deferred argument, with the token type expected at this position
+               // (there is no position that accepts both an index and a string token)
+               EToken expected = BitsContain(validTokens, EToken::Index) ? EToken::Index : EToken::QuotedIdentifier;
+               SetToken(expected, PathArg());
+               m_curToken.arg = m_argIdx++;
+               m_argSlots->push_back({ expected, validTokens, error, m_offsSelector, ScanOffset() });
+            }
+            else
+            {
+               if (m_argIdx >= m_argCount)
+               {
+                  SetError(EPathError::MissingArg);
+                  return false;
+               }
+
+               auto & v = m_args[m_argIdx++];
+               switch (v.index())
+               {
+                  case 0:  SetToken(EToken::Index, std::get<size_t>(v)); break;
+                  case 1:  SetToken(EToken::QuotedIdentifier, std::get<std::string_view>(v)); break;
+                  default: SetError(EPathError::Internal); return false;      // TODO: InvalidArg error code?
+               }
             }
          }
 
@@ -398,9 +525,10 @@ namespace YAML
          return false;
       }
 
-      bool PathScanner::ReadKVToken(KVToken & kvtoken, uint64_t endTokens)
+      bool PathScanner::ReadKVToken(KVToken & kvtoken, uint64_t endTokens, size_t & arg)
       {
          kvtoken = KVToken();
+         arg = NoBoundArg;
 
          const auto nameTokens = BitsOf({ EToken::FetchArg, EToken::QuotedIdentifier, EToken::UnquotedIdentifier });
          auto validTokens = BitsOf({ EToken::Exclamation, EToken::Caret, EToken::Asterisk }) | nameTokens;
@@ -427,6 +555,7 @@ namespace YAML
                   validTokens &= ~(nameTokens | BitsOf({ EToken::Caret, EToken::Exclamation }));
                   validTokens |= endTokens;
                   kvtoken.token = m_curToken.value;
+                  arg = m_curToken.arg;
                   continue;
 
                case EToken::Asterisk:
@@ -444,6 +573,61 @@ namespace YAML
          }
       }
 
+      /// \internal reads the key of a recursive key selector, after its ".." or "**."
+      ESelector PathScanner::ReadRecursiveKey()
+      {
+         if (!NextSelectorToken(BitsOf({ EToken::FetchArg, EToken::QuotedIdentifier, EToken::UnquotedIdentifier })))
+            return ESelector::Invalid;
+
+         m_periodAllowed = true;
+         return SetSelector(ESelector::RecursiveKey, ArgKey{ m_curToken.value, m_curToken.arg });
+      }
+
+      /// \internal reads the remainder of a slice selector, after its "[first-"
+      ESelector PathScanner::ReadSlice(ArgIndex first, bool required)
+      {
+         ArgSlice slice;
+         slice.first = first.index;
+         slice.firstArg = first.arg;
+         slice.required = required;
+         if (!NextSelectorToken(BitsOf({ EToken::Index }), EPathError::InvalidIndex))
+            return ESelector::Invalid;
+         slice.last = m_curToken.index;
+         slice.lastArg = m_curToken.arg;
+
+         if (!NextSelectorToken(BitsOf({ EToken::Comma, EToken::CloseBracket })))
+            return ESelector::Invalid;
+         if (m_curToken.id == EToken::Comma)
+         {
+            if (!NextSelectorToken(BitsOf({ EToken::Index }), EPathError::InvalidIndex))
+               return ESelector::Invalid;
+            slice.step = m_curToken.index;
+            slice.stepArg = m_curToken.arg;
+            if (slice.step == 0 && slice.stepArg == NoBoundArg)
+               return SetError(EPathError::InvalidIndex), ESelector::Invalid;
+
+            if (!NextSelectorToken(BitsOf({ EToken::CloseBracket })))
+               return ESelector::Invalid;
+         }
+
+         // deferred arguments are checked when they are bound
+         if (slice.first > slice.last && slice.firstArg == NoBoundArg && slice.lastArg == NoBoundArg)
+            return SetError(EPathError::InvalidIndex), ESelector::Invalid;
+         return SetSelector(ESelector::Slice, slice);
+      }
+
+      /// \internal reads the name of a type predicate, after its "!" or "$"
+      bool PathScanner::ReadTypePredicate(NodeType::value & type)
+      {
+         if (!NextSelectorToken(BitsOf({ EToken::UnquotedIdentifier })))
+            return false;
+
+         type = PredicateType(m_curToken.value);
+         if (type == NodeType::Undefined)
+            return SetError(EPathError::InvalidToken), false;
+         return true;
+      }
+
       /** retrieves the next selector. */
       ESelector PathScanner::NextSelector()
       {
@@ -451,17 +635,18 @@ namespace YAML
          if (m_error != EPathError::OK)
             return ESelector::Invalid;
 
-         if (m_diags)
-            m_diags->m_offsSelectorScan = ScanOffset();
+         m_offsSelector = ScanOffset();
 
          // skip period if allowed at this point
+         bool separated = false;
          if (m_periodAllowed)
          {
-            if (!NextSelectorToken(ValidTokensAtStart | BitsOf({ EToken::Period })))
+            if (!NextSelectorToken(ValidTokensAtStart))
                return ESelector::Invalid;
             m_periodAllowed = false;
             
-            if (m_curToken.id == EToken::Period)
+            separated = m_curToken.id == EToken::Period;
+            if (separated)
                m_selectorRequired = true;    // path cannot end with period after selector
             else
                m_tokenPending = true;        // if not a token, stuff this token back
@@ -482,22 +667,62 @@ namespace YAML
             case EToken::QuotedIdentifier:
             case EToken::UnquotedIdentifier:
             {
-               SetSelector(ESelector::Key, ArgKey{ m_curToken.value });
+               SetSelector(ESelector::Key, ArgKey{ m_curToken.value, m_curToken.arg });
                m_periodAllowed = true;
                return m_selector;
             }
 
+            case EToken::Period:
+               // "..key": after a selector, the first period was the separator
+               if (!separated && !NextSelectorToken(BitsOf({ EToken::Period })))
+                  return ESelector::Invalid;
+               return ReadRecursiveKey();
+
+            case EToken::Asterisk:
+               // "**.key"
+               if (!NextSelectorToken(BitsOf({ EToken::Asterisk })) || !NextSelectorToken(BitsOf({ EToken::Period })))
+                  return ESelector::Invalid;
+               return ReadRecursiveKey();
+
+            case EToken::Exclamation:
+            {
+               // "!ismap": the node itself has the type
+               ArgNodeType arg;
+               if (!ReadTypePredicate(arg.type))
+                  return ESelector::Invalid;
+
+               m_periodAllowed = true;
+               return SetSelector(ESelector::TypeCheck, arg);
+            }
+
             case EToken::OpenBracket:
             {
-               if (!NextSelectorToken(BitsOf({ EToken::Index }), EPathError::InvalidIndex))
+               // "[index]", a slice "[first-last]", "[first-last,step]", "[!first-last,step]", or a type filter "[$ismap]"
+               if (!NextSelectorToken(BitsOf({ EToken::Index, EToken::Exclamation, EToken::Dollar }), EPathError::InvalidIndex))
+                  return ESelector::Invalid;
+
+               if (m_curToken.id == EToken::Dollar)
+               {
+                  ArgNodeType arg;
+                  if (!ReadTypePredicate(arg.type) || !NextSelectorToken(BitsOf({ EToken::CloseBracket })))
+                     return ESelector::Invalid;
+
+                  m_periodAllowed = true;
+                  return SetSelector(ESelector::TypeFilter, arg);
+               }
+
+               bool required = m_curToken.id == EToken::Exclamation;
+               if (required && !NextSelectorToken(BitsOf({ EToken::Index }), EPathError::InvalidIndex))
                   return ESelector::Invalid;
 
-               const size_t index = m_curToken.index;
-               if (!NextSelectorToken(BitsOf({ EToken::CloseBracket })))
+               const ArgIndex index = { m_curToken.index, m_curToken.arg };
+               if (!NextSelectorToken(required ? BitsOf({ EToken::Minus }) : BitsOf({ EToken::CloseBracket, EToken::Minus })))
                   return ESelector::Invalid;
 
                m_periodAllowed = true;
-               return SetSelector(ESelector::Index, ArgIndex{ index });
+               if (m_curToken.id == EToken::Minus)
+                  return ReadSlice(index, required);
+               return SetSelector(ESelector::Index, index);
             }
 
 
@@ -506,11 +731,26 @@ namespace YAML
                ArgMapFilter arg; /// \todo optimization: a std::vector replacement with a small buffer optimization of length 1 would be pretty useful here
                while (true)
                {
+                  // after "&", a condition must follow
+                  const bool joined = !arg.empty() && arg.back().joined;
+                  const auto keyEnd = joined ? BitsOf({ EToken::Tilde, EToken::Equal }) : BitsOf({ EToken::Tilde, EToken::Equal, EToken::Comma, EToken::CloseBrace });
                   ArgKVPair kvp;
-                  if (!ReadKVToken(kvp.key, BitsOf({ EToken::Tilde, EToken::Equal, EToken::Comma, EToken::CloseBrace })))
+                  if (!joined && PeekSelectorToken(BitsOf({ EToken::Dollar })))
+                  {
+                     // "$ismap": selects the keys with a value of the type
+                     if (!ReadTypePredicate(kvp.valueType) || !NextSelectorToken(BitsOf({ EToken::Comma, EToken::CloseBrace })))
+                        return ESelector::Invalid;
+                     kvp.op = EKVOp::Select;
+                     arg.push_back(kvp);
+                     if (m_curToken.id == EToken::Comma)
+                        continue;
+                     break;
+                  }
+
+                  if (!ReadKVToken(kvp.key, keyEnd, kvp.keyArg))
                      return ESelector::Invalid;
 
-                  if (!NextSelectorToken(BitsOf({ EToken::Tilde, EToken::Equal, EToken::Comma, EToken::CloseBrace})))
+                  if (!NextSelectorToken(keyEnd))
                      return ESelector::Invalid;
 
 
@@ -541,7 +781,8 @@ namespace YAML
                   if (atEnd)
                      break;
 
-                  if (PeekSelectorToken(BitsOf({ EToken::CloseBrace, EToken::Comma })))
+                  const auto conditionEnd = BitsOf({ EToken::Comma, EToken::CloseBrace, EToken::Ampersand });
+                  if (PeekSelectorToken(conditionEnd))
                   {
                      m_tokenPending = true;
                      if (kvp.op == EKVOp::Equal) kvp.op = EKVOp::Exists;
@@ -551,21 +792,22 @@ namespace YAML
                         return SetError(EPathError::Internal), ESelector::Invalid;
                   }
                   else
-                     if (!ReadKVToken(kvp.value, BitsOf({ EToken::Comma, EToken::CloseBrace })))
+                     if (!ReadKVToken(kvp.value, conditionEnd, kvp.valueArg))
                         return ESelector::Invalid;
 
-                  if (!NextSelectorToken(BitsOf({ EToken::Comma, EToken::CloseBrace })))
+                  if (!NextSelectorToken(conditionEnd))
                      return ESelector::Invalid;
 
+                  kvp.joined = m_curToken.id == EToken::Ampersand;
                   arg.push_back(kvp);
-                  if (m_curToken.id == EToken::Comma)
+                  if (m_curToken.id != EToken::CloseBrace)
                      continue;
 
                   break;
                }
 
-               // partition: move conditions to front, selectors to the back. Allows arbitrary ordering
-               std::partition(arg.begin(), arg.end(), [](ArgKVPair const & kvp) { return kvp.op != EKVOp::Select;  });
+               // conditions to the front, cheapest first, selectors to the back. Allows arbitrary ordering
+               OrderConditions(arg);
 
                m_periodAllowed = true;
                return SetSelector(ESelector::MapFilter, std::move(arg));
@@ -656,14 +898,59 @@ namespace YAML
          *valid = x.ResolvedPath();
 
       if (errorOffs)
-         *errorOffs = x.ErrorOffset();
+         *errorOffs = scan.TokenOffset();
       return scan.Error(); 
    }
 
 
    namespace YamlPathDetail
    {
-      bool StrIsMatch(KVToken const & tok, Node const & node)
+      namespace
+      {
+         inline char Lower(char c) { return unsigned(c - 'A') < 26u ? char(c | 0x20) : c; }
+
+         bool EqualNoCase(char const * a, char const * b, size_t len)
+         {
+            for (size_t i = 0; i < len; ++i)
+               if (Lower(a[i]) != Lower(b[i]))
+                  return false;
+            return true;
+         }
+      }
+
+      std::string FoldCase(PathArg s)
+      {
+         std::string result(s);
+         for (char & c : result)
+            c = Lower(c);
+         return result;
+      }
+
+      bool EqualFolded(char const * s, char const * folded, size_t len)
+      {
+         size_t i = 0;
+#ifdef YAML_PATH_SSE2
+         // 16 bytes at a time: lowercase 'A'..'Z' in s (signed compares leave bytes >= 0x80 alone), then compare
+         const __m128i beforeA = _mm_set1_epi8('A' - 1);
+         const __m128i afterZ = _mm_set1_epi8('Z' + 1);
+         const __m128i caseBit = _mm_set1_epi8(0x20);
+         for (; i + 16 <= len; i += 16)
+         {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s + i));
+            __m128i p = _mm_loadu_si128(reinterpret_cast<__m128i const *>(folded + i));
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, beforeA), _mm_cmplt_epi8(v, afterZ));
+            v = _mm_or_si128(v, _mm_and_si128(upper, caseBit));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, p)) != 0xFFFF)
+               return false;
+         }
+#endif
+         for (; i < len; ++i)
+            if (Lower(s[i]) != folded[i])
+               return false;
+         return true;
+      }
+
+      bool StrIsMatch(KVToken const & tok, PathArg folded, Node const & node)
       {
          if (!node.IsScalar())
             return false;
@@ -671,7 +958,7 @@ namespace YAML
          if (tok.IsAllStar())
             return true;
 
-         std::string snode = node.as<std::string>();
+         std::string const & snode = node.Scalar();
 
          // length checks that allow to skip comparisons
          // Unicode: the length checks would be applicable only on case sensitive comparison after normalization. 
@@ -682,16 +969,20 @@ namespace YAML
             return false;
          // --
 
-         // Unicode: some assumptions here don't hold. It's strcoll, stricoll, and I'm not sure how to implement no-case starry matches
-         size_t cmpLen = std::min(tok.token.length(), snode.length());
-         int result = tok.noCase ? strncasecmp(&tok.token[0], snode.c_str(), cmpLen) : strncmp(&tok.token[0], snode.c_str(), cmpLen);
+         // Unicode: some assumptions here don't hold. Case folding is ASCII only.
+         size_t cmpLen = tok.token.length(); // under assumption of above length-based shortcuts
+         if (!tok.noCase)
+            return memcmp(tok.token.data(), snode.data(), cmpLen) == 0;
 
-         return result == 0; // under assumption of above length-based shortcuts
+         if (folded.length() == cmpLen)
+            return EqualFolded(snode.data(), folded.data(), cmpLen);
+
+         return EqualNoCase(tok.token.data(), snode.data(), cmpLen);   // deferred argument, not folded by the compiler
       }
 
       bool KeyIsMatch(ArgKVPair const & arg, Node const & key)
       {
-         return StrIsMatch(arg.key, key);
+         return StrIsMatch(arg.key, arg.keyFolded, key);
       }
 
       bool ValueIsMatch(ArgKVPair const & arg, Node const & value)
@@ -699,7 +990,7 @@ namespace YAML
          if (arg.op == EKVOp::Exists)
             return true;      // any value, including non-scalars and null, is a match
 
-         bool eq = StrIsMatch(arg.value, value);
+         bool eq = StrIsMatch(arg.value, arg.valueFolded, value);
          if (arg.op == EKVOp::Equal)
             return eq;
 
@@ -710,44 +1001,142 @@ namespace YAML
          return false;
       }
 
-      EPathError ApplyMapFilterToMap(Node & node, ArgMapFilter const & arg)
+      /** \internal orders the conditions of a map filter for \ref ApplyMapFilterToMap, and moves the key selectors to the end. 
+
+         A group is a single condition, or conditions joined by "&". It matches if all of its conditions match, 
+         and it is required if one of them is.
+         In path order, a map is selected if a group matches, every required group matches or follows a group that does, 
+         and every required key without wildcard or case folding is present. 
+         Once the first required group is met, all later ones are, so only the groups up to the first required one 
+         are \c alternative - the other groups cannot change the result, other than by a missing required key. 
+
+         This doesn't depend on the order of evaluation, which becomes: the first required group (if it checks a plain required key),
+         the presence of the other required plain keys, the remaining alternatives with plain keys, 
+         and last the alternatives scanning all keys of a map (starry or noCase key). 
+         Within a group, the required plain keys come first, the keys scanning a map last.
+         A map is rejected by the first missing required key, or when the last alternative didn't match.
+      */
+      void OrderConditions(ArgMapFilter & filter)
       {
-         ArgMapFilter::const_iterator argit = arg.begin();
+         auto ScanKeys = [](ArgKVPair const & kvp) { return kvp.key.starry || kvp.key.noCase; };
+         auto RequiredPlain = [&](ArgKVPair const & kvp) { return kvp.key.required && !ScanKeys(kvp); };
 
-         // --- for each condition (they are in the beginning of the list):
-         bool anyMatch = false;
-         for (; argit != arg.end() && argit->op != EKVOp::Select; ++argit) // selects are already sorted to the end of the list
+         bool required = false;
+         for (auto group = filter.begin(); group != filter.end(); )
          {
-            KVToken const & key = argit->key;
-            const bool scanKeys = key.starry || key.noCase; // cannot use the index operator, need to check keys one-by-one
-
-            if (scanKeys)
+            auto end = GroupEnd(group, filter.end());
+            if (group->op != EKVOp::Select)
             {
-               for (auto keyit = node.begin(); keyit != node.end(); ++keyit)
-               {
-                  if (!KeyIsMatch(*argit, keyit->first))
-                     continue;
+               bool alternative = !required;
+               required = required || std::any_of(group, end, [](ArgKVPair const & kvp) { return kvp.key.required; });
+               for (auto it = group; it != end; ++it)
+                  it->alternative = alternative, it->lastAlternative = false;
+            }
+            group = end;
+         }
 
-                  if (ValueIsMatch(*argit, keyit->second))
-                  {
-                     anyMatch = true;
-                     break; // don't scan further keys if we have a match in this map already
-                  }
-               }
+         auto Rank = [&](ArgMapFilter::const_iterator group, ArgMapFilter::const_iterator end)
+         {
+            if (group->op == EKVOp::Select)
+               return 5;
+            if (std::any_of(group, end, RequiredPlain))
+               return group->alternative ? 0 : 1;
+            if (!group->alternative)
+               return 4;
+            return std::any_of(group, end, ScanKeys) ? 3 : 2;
+         };
+         auto MemberRank = [&](ArgKVPair const & kvp) { return RequiredPlain(kvp) ? 0 : ScanKeys(kvp) ? 2 : 1; };
+
+         // stable insertion sort of the groups, and of the conditions in a group: 
+         // filters are short, and keep the path order within a rank (e.g. of the selected keys)
+         struct Group { int rank; size_t begin; size_t end; };
+         ScratchVector<Group> groups(Scratch());
+         for (auto group = filter.begin(); group != filter.end(); )
+         {
+            auto end = GroupEnd(group, filter.end());
+            groups.push_back({ Rank(group, end), size_t(group - filter.begin()), size_t(end - filter.begin()) });
+            group = end;
+         }
+         for (size_t i = 1; i < groups.size(); ++i)
+            for (size_t j = i; j > 0 && groups[j].rank < groups[j - 1].rank; --j)
+               std::swap(groups[j], groups[j - 1]);
+
+         ArgMapFilter ordered(filter.get_allocator());
+         ordered.reserve(filter.size());
+         for (auto && group : groups)
+         {
+            size_t first = ordered.size();
+            for (size_t k = group.begin; k < group.end; ++k)
+            {
+               ordered.push_back(filter[k]);
+               ordered.back().joined = true;
+               for (size_t j = ordered.size() - 1; j > first && MemberRank(ordered[j]) < MemberRank(ordered[j - 1]); --j)
+                  std::swap(ordered[j], ordered[j - 1]);
             }
-            else
+            ordered.back().joined = false;
+         }
+         filter = std::move(ordered);
+
+         auto last = std::find_if(filter.rbegin(), filter.rend(), [](ArgKVPair const & kvp) { return kvp.op != EKVOp::Select && kvp.alternative; });
+         if (last != filter.rend())
+            last->lastAlternative = true;
+      }
+
+      /// \internal true if \c cond (not a required plain key) matches a key of \c map, counting the keys read in \c keys
+      bool ConditionIsMatch(ArgKVPair const & cond, Node const & map, uint64_t & keys)
+      {
+         if (cond.key.starry || cond.key.noCase)
+         {
+            // cannot use the index operator, need to check keys one-by-one
+            for (auto && kv : map)
             {
-               Node el = node[std::string(key.token)];
-               if (!el && key.required)
-                  return EPathError::NodeNotFound;    // required key was not present
+               ++keys;
+               if (KeyIsMatch(cond, kv.first) && ValueIsMatch(cond, kv.second))
+                  return true;      // don't scan further keys if we have a match in this map already
+            }
+            return false;
+         }
+
+         ++keys;
+         Node el = FindKey(map, cond.key.token);
+         return el && ValueIsMatch(cond, el);
+      }
+
+      /** \internal applies a map filter ordered by \ref OrderConditions to a map. 
+          Adds the number of keys read by the conditions to \c keysScanned, if not \c nullptr (see \ref PathSelectorTrace).
+      */
+      EPathError ApplyMapFilterToMap(Node & node, ArgMapFilter const & arg, uint64_t * keysScanned = nullptr)
+      {
+         Node const & map = node;      // const lookups only, the document is never modified
+         ArgMapFilter::const_iterator argit = arg.begin();
+         uint64_t uncounted = 0;
+         uint64_t & keys = keysScanned ? *keysScanned : uncounted;
 
-               if (el && ValueIsMatch(*argit, el))
-                  anyMatch = true;
-               // still have to test further conditions, since there may be other required keys
+         // --- for each group of conditions (they are in the beginning of the list):
+         bool anyMatch = false;
+         while (argit != arg.end() && argit->op != EKVOp::Select) // selects are already sorted to the end of the list
+         {
+            auto end = GroupEnd(argit, arg.end());
+            bool match = !anyMatch && argit->alternative;      // otherwise, this group cannot change the result
+            for (; argit != end; ++argit)
+            {
+               KVToken const & key = argit->key;
+               if (key.required && !(key.starry || key.noCase))
+               {
+                  ++keys;
+                  Node el = FindKey(map, key.token);
+                  if (!el)
+                     return EPathError::NodeNotFound;    // required key was not present
+                  match = match && ValueIsMatch(*argit, el);
+                  // still have to test further required keys
+               }
+               else if (match)
+                  match = ConditionIsMatch(*argit, map, keys);
             }
+            anyMatch = anyMatch || match;
 
-            if (key.required && !anyMatch)
-               return EPathError::NodeNotFound;     // required key was not present
+            if (std::prev(argit)->lastAlternative && !anyMatch)
+               return EPathError::NodeNotFound;
          } // scan all conditions
 
          if (!anyMatch && argit != arg.begin())  // no match, but there were some conditions
@@ -758,30 +1147,50 @@ namespace YAML
          if (argit == arg.end())    // no selector follows the conditions - entire node is selected
             return EPathError::OK;
 
+         if (std::any_of(argit, arg.end(), [](ArgKVPair const & kvp) { return kvp.key.IsAllStar(); }))
+            return EPathError::OK;     // entire node is selected
+
+         // the result map is created on the first selected key, sharing the document memory (see NodeSet::ToNode)
+         std::lock_guard<std::mutex> lock(MemoryLock());
          Node result;
+         auto SelectKey = [&](auto const & key, Node const & value)
+         {
+            if (!result.IsMap())
+            {
+               result.reset(Node(NodeType::Map));
+               (void)map[result];
+            }
+            result[key] = value;
+         };
+
          for (; argit != arg.end(); ++argit)
          {
             assert(argit->op == EKVOp::Select);
             KVToken const & key = argit->key;
-
-            if (key.IsAllStar())      // entire node is selected
-               return EPathError::OK;
-
             const bool scanKeys = key.starry || key.noCase;
 
-            if (scanKeys)
+            if (argit->valueType != NodeType::Undefined)
             {
-               for (auto keyit = node.begin(); keyit != node.end(); ++keyit)
+               // "$ismap": the type of the value decides, its contents are not read
+               for (auto && kv : map)
                {
-                  if (KeyIsMatch(*argit, keyit->first))
-                     result[keyit->first] = keyit->second;
+                  if (kv.second.Type() == argit->valueType)
+                     SelectKey(kv.first, kv.second);
+               }
+            }
+            else if (scanKeys)
+            {
+               for (auto && kv : map)
+               {
+                  if (KeyIsMatch(*argit, kv.first))
+                     SelectKey(kv.first, kv.second);
                }
             }
             else
             {
-               auto value = node[std::string(key.token)];
+               auto value = FindKey(map, key.token);
                if (value)
-                  result[std::string(key.token)] = value;
+                  SelectKey(std::string(key.token), value);
             }
          }
          if (!result.IsMap())
@@ -793,273 +1202,1284 @@ namespace YAML
    }
 
    
-   /** Match a YAML path as far as possible
-
-      Matches nodes as long as a valid selector can be removed from the head of \c path and nodes can be matched.
-      See \ref Select for an introduction and documentation of YAML paths and selector matching.
-
-      \param node 
-        [in] the node where to start to match \c path \n
-        [out] the last node that could be matched
-
-      \param path
-        [in]  the path to match \n
-        [out] the remainder of the path that could not be matched
-
-      \param args
-        List of bound arguments, see the respective paragraph in \ref Select
-
-      \param  px
-        If not \c nullptr: receives detailed diagnostics if an error occurs.
-
-      \returns Error code that occurred during matching. \c EPathError::None if the entire path could be matched. 
-      You can uses \ref PathException::IsNodeError and \ref PathException::IsPathError to check what kind of error occurred.
-   */
-   EPathError PathResolve(Node & node, PathArg & path, PathBoundArgs args, PathException * px)
+   namespace YamlPathDetail
    {
-      PathScanner scan(path, args, px);
+      /** \internal scans \c path, storing all selectors in \c cp.
+          
+          If the path is malformed, scanning stops at the malformed selector, and \c cp.error receives the diagnostics.
+          String tokens refer to \c path and \c args, which must outlive \c cp.
+      */
+      void PathCompiler::Compile(CompiledPathData & cp, PathArg path, PathBoundArg const * args, size_t argCount)
+      {
+         PathScanner scan(path, args, argCount, &cp.error);
+         Compile(cp, scan, path);
+      }
 
-      while (scan)
+      /** \internal like \ref Compile, but creates a template that gets the bound arguments when it is resolved */
+      void PathCompiler::CompileTemplate(CompiledPathData & cp, PathArg path)
       {
-         if (!node)      // should not trigger except on initial node being undefined (and then only if there is a path given)
-            return scan.SetError(EPathError::NodeNotFound);
+         PathScanner scan(path, {}, &cp.error);
+         scan.DeferArgs(cp.argSlots);
+         Compile(cp, scan, path);
+      }
 
-         path = scan.Right(); // path is updated only when both the selector is valid, and it selects a valid node. 
-            
-         switch (scan.NextSelector())
+      /** \internal precomputes the lowercase tokens of \c noCase conditions, stored in \c cp. 
+          Deferred arguments are folded when matching.
+      */
+      void PathCompiler::FoldTokens(CompiledPathData & cp, ArgMapFilter & filter)
+      {
+         for (auto & kvp : filter)
          {
-            case ESelector::Key:
-               if (auto err = SelectByKey(node, scan.SelectorData<ArgKey>().key); err != EPathError::OK)
-                  return scan.SetError(err);
-            continue;
+            if (kvp.key.noCase && kvp.keyArg == NoBoundArg)
+               kvp.keyFolded = cp.foldedStorage.emplace_back(FoldCase(kvp.key.token));
+            if (kvp.value.noCase && kvp.valueArg == NoBoundArg)
+               kvp.valueFolded = cp.foldedStorage.emplace_back(FoldCase(kvp.value.token));
+         }
+      }
 
-            case ESelector::Index:
-            {
-               size_t index = scan.SelectorData<ArgIndex>().index;
-               if (auto err = SelectByIndex(node, index); err != EPathError::OK)
-                  return scan.SetError(err);
-               continue;
-            }
+      void PathCompiler::Compile(CompiledPathData & cp, PathScanner & scan, PathArg path)
+      {
+         cp.path = path;
+         size_t argSlotsBefore = 0;
 
-            case ESelector::MapFilter:
+         while (scan)
+         {
+            size_t offsRight = scan.ScanOffset();
+            ESelector selector = scan.NextSelector();
+            if (selector == ESelector::Invalid)
             {
-               auto && arg = scan.SelectorData<ArgMapFilter>();
-               EPathError err = EPathError::OK;
-               if (node.IsMap())
-               {
-                  if (auto err = ApplyMapFilterToMap(node, arg); err != EPathError::OK)
-                     return scan.SetError(err);
-                  continue;
-               }
-
-               if (node.IsSequence())
-               {
-                  Node result;
-                  for (auto && el : node)
-                  {
-                     if (!el.IsMap())
-                        continue;
-                     auto err = ApplyMapFilterToMap(el, arg);
-                     if (err != EPathError::OK)
-                        continue;
-                     result.push_back(el);
-                  }
-                  if (!result.IsSequence())    // node didn't become a sequence if nothing did match
-                     return scan.SetError(EPathError::NodeNotFound);
-                  node.reset(result);
-                  continue;
-               }
-
-               return scan.SetError(EPathError::InvalidNodeType);
+               cp.errorRight = offsRight;
+               break;
             }
+            if (selector == ESelector::None)
+               break;
 
-            case ESelector::Invalid:
-               return scan.Error();
+            PathSelector & ps = cp.selectors.emplace_back();
+            ps.selector = selector;
+            ps.data = scan.SelectorDataV();
+            ps.diags = { offsRight, scan.SelectorOffset(), scan.TokenOffset(), scan.BoundArg() };
+            ps.deferredArgs = cp.argSlots.size() > argSlotsBefore;
+            argSlotsBefore = cp.argSlots.size();
 
-            default:
-               assert(false);    // no other selectors supported right now
-               return scan.Error();
+            if (selector == ESelector::MapFilter)
+               FoldTokens(cp, std::get<ArgMapFilter>(ps.data));
          }
       }
-      path = scan.Right();
-      return EPathError::OK;
-   }
-
-   /** Selects one or more sub nodes from \c node, according to the specification in \c path
 
-      \par Error Handling
+      /** \internal compiles a template that owns a copy of \c path. Used by the path cache. */
+      std::shared_ptr<CompiledPathData const> PathCompiler::CompileOwnedTemplate(PathArg path)
+      {
+         auto cp = std::make_shared<CompiledPathData>();
+         cp->pathStorage = std::string(path);
+         CompileTemplate(*cp, cp->pathStorage);
+         return cp;
+      }
 
-      if \c path is malformed, an \ref PathException exception is thrown.\n
+      /** \internal replaces the argument placeholders in \c selector by \c args, storing the result in \c bound
+
+         If an argument is missing or has the wrong type, the error is reported the same way 
+         as if the arguments were fetched by the scanner.
+      */
+      EPathError PathCompiler::BindArgs(CompiledPathData const & cp, PathSelector const & selector, PathBoundArg const * args, size_t argCount, PathScanner::tSelectorData & bound, PathException * px)
+      {
+         // (map filter conditions may have been reordered, the error is reported for the first argument in the path)
+         EPathError err = EPathError::OK;
+         size_t errArg = NoBoundArg;
+         EToken errFound = EToken::FetchArg;
+         auto Bind = [&](size_t arg, PathArg * str, size_t * index)
+         {
+            if (arg == NoBoundArg || arg > errArg)
+               return;
+
+            if (arg >= argCount)
+               err = EPathError::MissingArg, errArg = arg, errFound = EToken::FetchArg;
+            else if (auto s = std::get_if<PathArg>(&args[arg]); s && str)
+               *str = *s;
+            else if (auto i = std::get_if<size_t>(&args[arg]); i && index)
+               *index = *i;
+            else
+               err = cp.argSlots[arg].error, errArg = arg, errFound = args[arg].index() == 0 ? EToken::Index : EToken::QuotedIdentifier;
+         };
+
+         if (auto filter = std::get_if<ArgMapFilter>(&selector.data))
+            bound.emplace<ArgMapFilter>(*filter, Scratch());     // the bound copy is scratch data
+         else
+            bound = selector.data;
+         if (auto key = std::get_if<ArgKey>(&bound))
+            Bind(key->arg, &key->key, nullptr);
+         else if (auto index = std::get_if<ArgIndex>(&bound))
+            Bind(index->arg, nullptr, &index->index);
+         else if (auto filter = std::get_if<ArgMapFilter>(&bound))
+         {
+            for (auto && kvp : *filter)
+            {
+               Bind(kvp.keyArg, &kvp.key.token, nullptr);
+               Bind(kvp.valueArg, &kvp.value.token, nullptr);
+            }
+         }
+         else if (auto slice = std::get_if<ArgSlice>(&bound))
+         {
+            Bind(slice->firstArg, nullptr, &slice->first);
+            Bind(slice->lastArg, nullptr, &slice->last);
+            Bind(slice->stepArg, nullptr, &slice->step);
+            if (err == EPathError::OK && !slice->Valid())      // reported for the first bound argument of the slice
+               err = EPathError::InvalidIndex, errArg = std::min({ slice->firstArg, slice->lastArg, slice->stepArg }), errFound = EToken::Index;
+         }
+
+         if (err != EPathError::OK && px)
+         {
+            ArgSlot const & slot = cp.argSlots[errArg];
+            *px = PathException();
+            px->m_fullPath = std::string(cp.path);
+            px->m_error = err;
+            px->m_errorType = (decltype(px->m_errorType))errFound;
+            px->m_validTypes = err == EPathError::MissingArg ? 0 : slot.validTokens;
+            px->m_offsSelectorScan = slot.offsSelector;
+            px->m_offsTokenScan = slot.offsToken;
+            px->m_fromBoundArg = errArg;
+         }
+         return err;
+      }
+
+      /** \internal compiles a path into a \ref CompiledPath that owns copies of \c path and \c args */
+      CompiledPath PathCompiler::CompileOwned(PathArg path, PathBoundArgs args)
+      {
+         auto cp = std::make_shared<CompiledPathData>();
+         cp->pathStorage = std::string(path);
+         cp->args.reserve(args.size());
+         for (auto && arg : args)
+         {
+            if (auto s = std::get_if<PathArg>(&arg))
+               cp->args.push_back(PathArg(cp->argStorage.emplace_back(*s)));   // deque: growing does not invalidate earlier strings
+            else
+               cp->args.push_back(arg);
+         }
+
+         Compile(*cp, cp->pathStorage, cp->args.data(), cp->args.size());
+
+         CompiledPath result;
+         result.m_data = std::move(cp);
+         return result;
+      }
+
+      /** \internal fills \c px with the diagnostics for a node error, as \ref PathScanner would have done after scanning \c selector.
+          \c selector can be \c nullptr if the error occurs before the first selector is applied.
+      */
+      EPathError PathCompiler::SetNodeError(CompiledPathData const & cp, PathSelector const * selector, EPathError error, PathException * px)
+      {
+         if (px)
+         {
+            *px = PathException();
+            px->m_fullPath = std::string(cp.path);
+            px->m_error = error;
+            if (selector)
+            {
+               px->m_errorType = (decltype(px->m_errorType))selector->selector;
+               px->m_offsSelectorScan = selector->diags.offsSelector;
+               px->m_offsTokenScan = selector->diags.offsToken;
+               px->m_fromBoundArg = selector->diags.fromBoundArg;
+            }
+         }
+         return error;
+      }
+
+      /** \internal fills \c px with the diagnostics of the path error in \c cp */
+      EPathError PathCompiler::SetPathError(CompiledPathData const & cp, PathException * px)
+      {
+         if (px)
+            *px = cp.error;
+         return cp.error.Error();
+      }
+
+      /** \internal applies a map filter to every map in \c elements (a sequence node or a \ref NodeSet), 
+          adding the matches to \c result
+      */
+      template <typename TElements>
+      EPathError FanOutMapFilter(TElements const & elements, ArgMapFilter const & arg, NodeSet & result, uint64_t * keysScanned = nullptr)
+      {
+         for (auto && el : elements)
+         {
+            if (!el.IsMap())
+               continue;
+            Node match = el;
+            if (ApplyMapFilterToMap(match, arg, keysScanned) == EPathError::OK)
+               result.Add(match);
+         }
+         return result.Empty() ? EPathError::NodeNotFound : EPathError::OK;
+      }
+
+      size_t FanOutChunks(size_t count, PathContext const * context)
+      {
+         if (!context)
+            return 1;
+
+         auto && options = context->Options();
+         if (count < std::max<size_t>(options.parallelThreshold, 2))
+            return 1;
+
+         size_t threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+         return std::min(threads, count);
+      }
+
+      void ParallelChunks(size_t count, size_t chunks, std::function<void(size_t chunk, size_t begin, size_t end)> const & fn)
+      {
+         std::vector<std::exception_ptr> errors(chunks);
+         auto run = [&](size_t chunk)
+         {
+            try
+            {
+               fn(chunk, chunk * count / chunks, (chunk + 1) * count / chunks);
+            }
+            catch (...)
+            {
+               errors[chunk] = std::current_exception();
+            }
+         };
+
+         std::vector<std::thread> workers;
+         workers.reserve(chunks - 1);
+         for (size_t chunk = 1; chunk < chunks; ++chunk)
+            workers.emplace_back(run, chunk);
+         run(0);
+         for (auto && worker : workers)
+            worker.join();
+
+         for (auto && error : errors)
+            if (error)
+               std::rethrow_exception(error);
+      }
+
+      /** \internal runs <tt>fn(begin, end, partial)</tt> for \c chunks slices of <tt>[0, count)</tt> (see \ref ParallelChunks), 
+          and appends the partial results to \c result in order.
+      */
+      template <typename TFunc>
+      void ParallelFanOut(size_t count, size_t chunks, NodeSet & result, TFunc fn)
+      {
+         std::vector<NodeSet> partial;       // filled by the worker threads: not from the scratch memory of this thread
+         partial.reserve(chunks);
+         for (size_t chunk = 0; chunk < chunks; ++chunk)
+            partial.emplace_back(std::pmr::new_delete_resource());
+         ParallelChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) { fn(begin, end, partial[chunk]); });
+
+         size_t total = 0;
+         for (auto && p : partial)
+            total += p.Size();
+         result.Reserve(total);
+         for (auto && p : partial)
+            for (auto && n : p)
+               result.Add(n);
+      }
+
+      /// \internal like \ref FanOutKey, filtering \c chunks slices of \c elements in parallel
+      template <typename TElements>
+      EPathError ParallelFanOutKey(TElements const & elements, PathArg key, size_t chunks, NodeSet & result)
+      {
+         ParallelFanOut(ElementCount(elements), chunks, result, [&](size_t begin, size_t end, NodeSet & partial)
+         {
+            for (size_t i = begin; i < end; ++i)
+            {
+               if (Node val = FindKey(elements[i], key))
+                  partial.Add(val);
+            }
+         });
+         return result.Empty() ? EPathError::NodeNotFound : EPathError::OK;
+      }
+
+      /** \internal like \ref FanOutMapFilter, filtering \c chunks slices of \c elements in parallel.
+          
+          Only the conditions are tested in parallel: selecting keys creates a new map, which modifies the document memory.
+      */
+      template <typename TElements>
+      EPathError ParallelFanOutMapFilter(TElements const & elements, ArgMapFilter const & arg, size_t chunks, NodeSet & result, uint64_t * keysScanned = nullptr)
+      {
+         auto firstSelect = std::find_if(arg.begin(), arg.end(), [](ArgKVPair const & kvp) { return kvp.op == EKVOp::Select; });
+         ArgMapFilter conditions(arg.begin(), firstSelect, Scratch());
+
+         NodeSet matches;
+         std::atomic<uint64_t> keys{ 0 };
+         ParallelFanOut(ElementCount(elements), chunks, matches, [&](size_t begin, size_t end, NodeSet & partial)
+         {
+            uint64_t chunkKeys = 0;
+            for (size_t i = begin; i < end; ++i)
+            {
+               Node el = elements[i];
+               if (el.IsMap() && ApplyMapFilterToMap(el, conditions, keysScanned ? &chunkKeys : nullptr) == EPathError::OK)
+                  partial.Add(el);
+            }
+            keys += chunkKeys;
+         });
+         if (keysScanned)
+            *keysScanned += keys;
+
+         if (firstSelect == arg.end())
+            result = std::move(matches);
+         else
+            FanOutMapFilter(matches, arg, result, keysScanned);
+         return result.Empty() ? EPathError::NodeNotFound : EPathError::OK;
+      }
+
+      /// \internal like \ref FanOutMapFilter, applied only to the candidates found in an index
+      EPathError FanOutIndexed(Node const & sequence, IndexLookup const & lookup, ArgMapFilter const & arg, NodeSet & result, uint64_t * keysScanned = nullptr)
+      {
+         if (lookup.positions)
+         {
+            for (size_t pos : *lookup.positions)
+            {
+               Node match = sequence[pos];
+               if (match.IsMap() && ApplyMapFilterToMap(match, arg, keysScanned) == EPathError::OK)
+                  result.Add(match);
+            }
+         }
+         return result.Empty() ? EPathError::NodeNotFound : EPathError::OK;
+      }
+
+      /// \internal adds the elements of \c slice from \c elements (a sequence node or a \ref NodeSet) to \c result
+      template <typename TElements>
+      void SliceElements(TElements const & elements, ArgSlice const & slice, NodeSet & result)
+      {
+         size_t count = slice.Count(ElementCount(elements));
+         result.Reserve(count);
+         for (size_t k = 0; k < count; ++k)
+            result.Add(elements[slice.Position(k)]);
+      }
+
+      /** \internal applies a single selector to \c node.
+
+          If \c nodes is not empty, it holds the current result of a previous selector instead of \c node, 
+          and acts like a sequence node. 
+          Selectors that fan out over a sequence leave their result in \c nodes.
+          If the selector does not match, \c node and \c nodes remain unchanged.
+          Map filters applied to a sequence use an index from \c context if possible.
+          Map filters add the number of keys they read to \c keysScanned, if not \c nullptr.
+      */
+      EPathError ApplySelector(Node & node, NodeSet & nodes, ESelector selector, PathScanner::tSelectorData const & data, PathContext const * context, uint64_t * keysScanned)
+      {
+         const bool fanOut = !nodes.Empty() || node.IsSequence();
+         NodeSet result;
+
+         switch (selector)
+         {
+            case ESelector::Key:
+            {
+               if (!fanOut)
+                  return SelectByKey(node, std::get<ArgKey>(data).key);
+
+               auto && key = std::get<ArgKey>(data).key;
+               size_t chunks = FanOutChunks(nodes.Empty() ? ElementCount(node) : nodes.Size(), context);
+               EPathError err;
+               if (chunks > 1)
+                  err = nodes.Empty() ? ParallelFanOutKey(node, key, chunks, result) : ParallelFanOutKey(nodes, key, chunks, result);
+               else
+                  err = nodes.Empty() ? FanOutKey(node, key, result) : FanOutKey(nodes, key, result);
+               if (err != EPathError::OK)
+                  return err;
+               nodes = std::move(result);
+               return EPathError::OK;
+            }
+
+            case ESelector::Index:
+            {
+               if (nodes.Empty())
+                  return SelectByIndex(node, std::get<ArgIndex>(data).index);
+
+               auto index = std::get<ArgIndex>(data).index;
+               if (index >= nodes.Size())
+                  return EPathError::NodeNotFound;
+               node.reset(nodes[index]);
+               nodes.Clear();
+               return EPathError::OK;
+            }
+
+            case ESelector::MapFilter:
+            {
+               auto && arg = std::get<ArgMapFilter>(data);
+               if (!fanOut)
+                  return node.IsMap() ? ApplyMapFilterToMap(node, arg, keysScanned) : EPathError::InvalidNodeType;
+
+               EPathError err;
+               size_t chunks = FanOutChunks(nodes.Empty() ? ElementCount(node) : nodes.Size(), context);
+               if (!nodes.Empty())
+                  err = chunks > 1 ? ParallelFanOutMapFilter(nodes, arg, chunks, result, keysScanned) : FanOutMapFilter(nodes, arg, result, keysScanned);
+               else if (auto lookup = LookupIndex(context, node, arg))
+                  err = FanOutIndexed(node, *lookup, arg, result, keysScanned);
+               else
+                  err = chunks > 1 ? ParallelFanOutMapFilter(node, arg, chunks, result, keysScanned) : FanOutMapFilter(node, arg, result, keysScanned);
+               if (err != EPathError::OK)
+                  return err;
+               nodes = std::move(result);
+               return EPathError::OK;
+            }
+
+            case ESelector::RecursiveKey:
+            {
+               auto key = std::get<ArgKey>(data).key;
+               auto add = [&](Node const & value) { result.Add(value); };
+               if (nodes.Empty())
+                  VisitDescendantKeys(node, key, context, NodeVisitor(add));
+               for (auto && el : nodes)
+                  VisitDescendantKeys(el, key, context, NodeVisitor(add));
+               if (result.Empty())
+                  return EPathError::NodeNotFound;
+               nodes = std::move(result);
+               return EPathError::OK;
+            }
+
+            case ESelector::Slice:
+            {
+               // only the elements in the slice are read
+               auto && slice = std::get<ArgSlice>(data);
+               if (!nodes.Empty())
+                  SliceElements(nodes, slice, result);
+               else if (node.IsSequence())
+                  SliceElements(node, slice, result);
+               else if (node.IsMap() || node.IsScalar())
+               {
+                  if (slice.Count(1))     // like [0], a single node acts as a one-element sequence
+                     result.Add(node);
+               }
+               else
+                  return EPathError::InvalidNodeType;
+
+               if (result.Empty())
+                  return EPathError::NodeNotFound;
+               nodes = std::move(result);
+               return EPathError::OK;
+            }
+
+            case ESelector::TypeCheck:
+            case ESelector::TypeFilter:
+            {
+               // only the node types are compared, scalars are not read
+               auto type = std::get<ArgNodeType>(data).type;
+               if (nodes.Empty() && (selector == ESelector::TypeCheck || !node.IsSequence()))
+                  return node.Type() == type ? EPathError::OK : EPathError::NodeNotFound;
+
+               auto add = [&](Node const & el) { if (el.Type() == type) result.Add(el); };
+               if (!nodes.Empty())
+                  for (auto && el : nodes)
+                     add(el);
+               else
+                  for (auto && el : node)
+                     add(el);
+
+               if (result.Empty())
+                  return EPathError::NodeNotFound;
+               nodes = std::move(result);
+               return EPathError::OK;
+            }
+
+            default:
+               assert(false);    // no other selectors supported right now
+               return EPathError::Internal;
+         }
+      }
+
+      /** \internal resolves a compiled path, without materializing the result of a fan-out selector.
+
+          The result is \c nodes if it is not empty, \c node otherwise (this applies to errors, too).
+          \c args are used only if \c cp is a template.
+          \c offsRight receives the scan offset of the part of the path that could not be matched 
+      */
+      EPathError ResolveNodes(Node & node, NodeSet & nodes, CompiledPathData const & cp, PathBoundArg const * args, size_t argCount, size_t & offsRight, PathException * px, PathContext const * context)
+      {
+         PathTraceScope trace(context, cp.path);
+         PathSelector const * prev = nullptr;
+         PathScanner::tSelectorData bound;
+         for (auto && selector : cp.selectors)
+         {
+            if (!node && nodes.Empty())      // should not trigger except on initial node being undefined (and then only if there is a path given)
+               return trace.EndPath(PathCompiler::SetNodeError(cp, prev, EPathError::NodeNotFound, px), 0);
+
+            offsRight = selector.diags.offsRight;  // path is updated only when both the selector is valid, and it selects a valid node. 
+
+            trace.BeginSelector(size_t(&selector - cp.selectors.data()), selector.selector, node, nodes);
+            auto data = &selector.data;
+            if (selector.deferredArgs)
+            {
+               if (auto err = PathCompiler::BindArgs(cp, selector, args, argCount, bound, px); err != EPathError::OK)
+                  return trace.EndPath(err, 0);
+               data = &bound;
+            }
+
+            auto err = ApplySelector(node, nodes, selector.selector, *data, context, trace.KeysScanned());
+            trace.EndSelector(node, nodes, err);
+            if (err != EPathError::OK)
+               return trace.EndPath(PathCompiler::SetNodeError(cp, &selector, err, px), 0);
+            prev = &selector;
+         }
+
+         if (cp.error.Error() != EPathError::OK)
+         {
+            if (!node && nodes.Empty())
+               return trace.EndPath(PathCompiler::SetNodeError(cp, prev, EPathError::NodeNotFound, px), 0);
+
+            offsRight = cp.errorRight;
+            return trace.EndPath(PathCompiler::SetPathError(cp, px), 0);
+         }
+
+         offsRight = cp.path.length();
+         return trace.EndPath(EPathError::OK, node, nodes);
+      }
+
+      /** \internal like \ref ResolveNodes, for a path string. The compiled path is taken from the path cache if possible */
+      EPathError ResolveNodes(Node & node, NodeSet & nodes, PathArg path, PathBoundArgs args, size_t & offsRight, PathException * px, PathContext const * context)
+      {
+         if (auto cached = PathCacheGet(path))
+            return ResolveNodes(node, nodes, *cached, args.begin(), args.size(), offsRight, px, context);
+
+         CompiledPathData cp;
+         PathCompiler::Compile(cp, path, args.begin(), args.size());
+         return ResolveNodes(node, nodes, cp, nullptr, 0, offsRight, px, context);
+      }
+
+      /// \internal stores the result of \ref ResolveNodes in \c node
+      EPathError Materialize(Node & node, NodeSet const & nodes, EPathError err)
+      {
+         if (!nodes.Empty())
+            node.reset(nodes.ToNode());
+         return err;
+      }
+
+      /// \internal binds the arguments of a template. Returns false if they don't match (the path error is reported by \ref ResolveNodes)
+      bool PathStream::Bind(PathBoundArg const * args, size_t argCount)
+      {
+         if (m_cp.argSlots.empty())
+            return true;
+
+         m_bound.resize(m_cp.selectors.size());
+         for (size_t i = 0; i < m_cp.selectors.size(); ++i)
+         {
+            auto && selector = m_cp.selectors[i];
+            if (selector.deferredArgs && PathCompiler::BindArgs(m_cp, selector, args, argCount, m_bound[i], nullptr) != EPathError::OK)
+               return false;
+         }
+         return true;
+      }
+
+      /// \internal visits the nodes selected from \c node, returns the number of nodes visited
+      size_t PathStream::Run(Node const & node)
+      {
+         if (m_cp.selectors.empty())
+            Visit(node);
+         else if (node)
+            Single(0, node);
+         return m_visited;
+      }
+
+      /// \internal applies selectors <tt>[i..]</tt> to a single node. Returns false if resolution should stop.
+      bool PathStream::Single(size_t i, Node const & node)
+      {
+         if (i == m_cp.selectors.size())
+            return Visit(node);
+
+         auto && data = Data(i);
+         switch (m_cp.selectors[i].selector)
+         {
+            case ESelector::Key:
+            {
+               auto key = std::get<ArgKey>(data).key;
+               if (node.IsMap())
+               {
+                  Node value = FindKey(node, key);
+                  return !value || Single(i + 1, value);
+               }
+               if (node.IsSequence())
+               {
+                  BeginFanOut(i);
+                  size_t index = 0;
+                  for (auto && el : node)
+                  {
+                     if (Node value = FindKey(el, key))
+                        if (!Element(i + 1, value, index))
+                           return false;
+                  }
+               }
+               return true;
+            }
+
+            case ESelector::Index:
+            {
+               Node n = node;
+               return SelectByIndex(n, std::get<ArgIndex>(data).index) != EPathError::OK || Single(i + 1, n);
+            }
+
+            case ESelector::MapFilter:
+            {
+               auto && arg = std::get<ArgMapFilter>(data);
+               if (node.IsMap())
+               {
+                  Node n = node;
+                  return ApplyMapFilterToMap(n, arg) != EPathError::OK || Single(i + 1, n);
+               }
+               if (node.IsSequence())
+               {
+                  BeginFanOut(i);
+                  size_t index = 0;
+                  if (auto lookup = LookupIndex(m_context, node, arg))
+                  {
+                     if (lookup->positions)
+                     {
+                        for (size_t pos : *lookup->positions)
+                        {
+                           Node match = node[pos];
+                           if (match.IsMap() && ApplyMapFilterToMap(match, arg) == EPathError::OK)
+                              if (!Element(i + 1, match, index))
+                                 return false;
+                        }
+                     }
+                     return true;
+                  }
+
+                  for (auto && el : node)
+                  {
+                     if (!el.IsMap())
+                        continue;
+                     Node match = el;
+                     if (ApplyMapFilterToMap(match, arg) == EPathError::OK)
+                        if (!Element(i + 1, match, index))
+                           return false;
+                  }
+               }
+               return true;
+            }
+
+            case ESelector::RecursiveKey:
+            {
+               BeginFanOut(i);
+               size_t index = 0;
+               auto next = [&](Node const & value) { return Element(i + 1, value, index); };
+               return VisitDescendantKeys(node, std::get<ArgKey>(data).key, m_context, NodeVisitor(next));
+            }
+
+            case ESelector::Slice:
+            {
+               auto && slice = std::get<ArgSlice>(data);
+               if (!node.IsSequence() && !node.IsMap() && !node.IsScalar())
+                  return true;
+
+               BeginFanOut(i);
+               size_t index = 0;
+               size_t count = slice.Count(node.IsSequence() ? node.size() : 1);
+               for (size_t k = 0; k < count; ++k)
+               {
+                  if (!Element(i + 1, node.IsSequence() ? node[slice.Position(k)] : node, index))
+                     return false;
+               }
+               return true;
+            }
+
+            case ESelector::TypeCheck:
+            case ESelector::TypeFilter:
+            {
+               auto type = std::get<ArgNodeType>(data).type;
+               if (m_cp.selectors[i].selector == ESelector::TypeCheck || !node.IsSequence())
+                  return node.Type() != type || Single(i + 1, node);
+
+               BeginFanOut(i);
+               size_t index = 0;
+               for (auto && el : node)
+               {
+                  if (el.Type() == type && !Element(i + 1, el, index))
+                     return false;
+               }
+               return true;
+            }
+
+            default:
+               assert(false);    // no other selectors supported right now
+               return false;
+         }
+      }
+
+      /** \internal applies selectors <tt>[i..]</tt> to an element of a fan-out result. 
+          \c index counts the elements reaching the next index selector. Returns false if the fan-out should stop.
+      */
+      bool PathStream::Element(size_t i, Node element, size_t & index)
+      {
+         for (; i < m_cp.selectors.size(); ++i)
+         {
+            auto && data = Data(i);
+            switch (m_cp.selectors[i].selector)
+            {
+               case ESelector::Key:
+               {
+                  Node value = FindKey(element, std::get<ArgKey>(data).key);
+                  if (!value)
+                     return true;
+                  element.reset(value);
+                  break;
+               }
+
+               case ESelector::MapFilter:
+                  if (!element.IsMap() || ApplyMapFilterToMap(element, std::get<ArgMapFilter>(data)) != EPathError::OK)
+                     return true;
+                  break;
+
+               case ESelector::Index:
+                  if (index++ < std::get<ArgIndex>(data).index)
+                     return true;
+                  Single(i + 1, element);
+                  return false;        // the remaining elements cannot be selected anymore
+
+               case ESelector::RecursiveKey:
+               {
+                  auto next = [&](Node const & value) { return Element(i + 1, value, index); };
+                  return VisitDescendantKeys(element, std::get<ArgKey>(data).key, m_context, NodeVisitor(next));
+               }
+
+               case ESelector::Slice:
+               {
+                  // like the index selector, the slice counts the elements reaching it
+                  auto && slice = std::get<ArgSlice>(data);
+                  auto & state = Slice(i);
+                  size_t position = state.position++;
+                  size_t last = slice.Last();
+                  if (position > last)
+                     return false;
+                  if (position < slice.first || (position - slice.first) % slice.step)
+                     return true;
+
+                  if (slice.required)
+                  {
+                     // held back until the last position is reached
+                     state.pending.push_back(element);
+                     if (position < last)
+                        return true;
+                     for (auto && pending : state.pending)
+                        if (!Element(i + 1, pending, index))
+                           break;
+                     return false;
+                  }
+                  if (position == last)
+                  {
+                     Element(i + 1, element, index);
+                     return false;        // the remaining elements cannot be selected anymore
+                  }
+                  break;
+               }
+
+               case ESelector::TypeCheck:
+               case ESelector::TypeFilter:
+                  // like the index selector, the type filter applies to the elements of the fan-out
+                  if (element.Type() != std::get<ArgNodeType>(data).type)
+                     return true;
+                  break;
+
+               default:
+                  assert(false);    // no other selectors supported right now
+                  return false;
+            }
+         }
+         return Visit(element);
+      }
+
+      /// \internal the fan-out state of the slice selector at \c i
+      PathStream::SliceState & PathStream::Slice(size_t i)
+      {
+         if (m_slices.empty())
+            m_slices.resize(m_cp.selectors.size());
+         return m_slices[i];
+      }
+
+      /// \internal a fan-out starts at selector \c i: resets the state of the slice selectors after it
+      void PathStream::BeginFanOut(size_t i)
+      {
+         for (size_t k = i + 1; k < m_slices.size(); ++k)
+         {
+            m_slices[k].position = 0;
+            m_slices[k].pending.clear();
+         }
+      }
+
+      /// \internal implements \ref SelectEach
+      size_t VisitCompiled(Node const & node, CompiledPathData const & cp, PathBoundArg const * args, size_t argCount, NodeVisitor const & visitor, PathContext const * context)
+      {
+         ScratchScope scratch(context);
+         PathStream stream(cp, visitor, context);
+         if (cp.error.Error() == EPathError::OK && stream.Bind(args, argCount))
+         {
+            PathTraceScope trace(context, cp.path);
+            size_t visited = stream.Run(node);
+            trace.EndPath(visited ? EPathError::OK : EPathError::NodeNotFound, visited);
+            return visited;
+         }
+
+         // malformed path, or arguments not matching: like Select, report a node error found before the path error is reached
+         Node n = node;
+         NodeSet nodes;
+         PathException x;
+         size_t offsRight = 0;
+         [[maybe_unused]] auto err = ResolveNodes(n, nodes, cp, args, argCount, offsRight, &x, context);
+         assert(err != EPathError::OK);
+         if (x.IsNodeError())
+            return 0;
+         throw x;
+      }
+
+      size_t VisitPath(Node node, PathArg path, NodeVisitor const & visitor, PathBoundArgs args, PathContext const * context)
+      {
+         if (auto cached = PathCacheGet(path))
+            return VisitCompiled(node, *cached, args.begin(), args.size(), visitor, context);
+
+         CompiledPathData cp;
+         PathCompiler::Compile(cp, path, args.begin(), args.size());
+         return VisitCompiled(node, cp, nullptr, 0, visitor, context);
+      }
+
+      size_t VisitPath(Node node, CompiledPath const & path, NodeVisitor const & visitor, PathContext const * context)
+      {
+         auto cp = PathCompiler::Data(path);
+         if (!cp)
+         {
+            visitor(node);
+            return 1;
+         }
+         return VisitCompiled(node, *cp, nullptr, 0, visitor, context);
+      }
+   }
+
+   
+   /** Match a YAML path as far as possible
+
+      The parsed path is taken from the path cache, see \ref PathCacheSetCapacity.
+
+      Matches nodes as long as a valid selector can be removed from the head of \c path and nodes can be matched.
+      See \ref Select for an introduction and documentation of YAML paths and selector matching.
+
+      \param node 
+        [in] the node where to start to match \c path \n
+        [out] the last node that could be matched
+
+      \param path
+        [in]  the path to match \n
+        [out] the remainder of the path that could not be matched
+
+      \param args
+        List of bound arguments, see the respective paragraph in \ref Select
+
+      \param  px
+        If not \c nullptr: receives detailed diagnostics if an error occurs.
+
+      \param context
+        If not \c nullptr: provides \ref PathIndex "indexes" for map filters
+
+      \returns Error code that occurred during matching. \c EPathError::None if the entire path could be matched. 
+      You can uses \ref PathException::IsNodeError and \ref PathException::IsPathError to check what kind of error occurred.
+   */
+   EPathError PathResolve(Node & node, PathArg & path, PathBoundArgs args, PathException * px, PathContext const * context)
+   {
+      YamlPathDetail::ScratchScope scratch(context);
+      if (px)
+         *px = PathException();
+
+      size_t offsRight = 0;
+      NodeSet nodes;
+      auto err = ResolveNodes(node, nodes, path, args, offsRight, px, context);
+      path = path.substr(offsRight);
+      return Materialize(node, nodes, err);
+   }
+
+   /** Like \ref PathResolve, for a path compiled by \ref CompilePath. 
+       Instead of returning the remainder of the path, \ref PathException::ResolvedPath can be used.
+   */
+   EPathError PathResolve(Node & node, CompiledPath const & path, PathException * px, PathContext const * context)
+   {
+      YamlPathDetail::ScratchScope scratch(context);
+      if (px)
+         *px = PathException();
+
+      auto cp = PathCompiler::Data(path);
+      if (!cp)
+         return EPathError::OK;
+
+      size_t offsRight = 0;
+      NodeSet nodes;
+      return Materialize(node, nodes, ResolveNodes(node, nodes, *cp, nullptr, 0, offsRight, px, context));
+   }
+
+   /** Selects one or more sub nodes from \c node, according to the specification in \c path
+
+      \par Error Handling
+
+      if \c path is malformed, an \ref PathException exception is thrown.\n
 
       if no node can be selected (e.g. the index is out of range, or the node type can not be matched), an <i>invalid node</i> is returned.
       Invalid nodes evaluate to false in a boolean context. Note that in yaml-cpp, there is a distinction between null nodes and invalid nodes.
 
       \c Select may throw exceptions from yaml-cpp if \c node is malformed. It is intended to not throw such exceptions otherwise.
 
-      \sa Require, PathResolve, PathValidate
+      \par Indexes
+
+      If \c context is not \c nullptr, map filters applied to a sequence use the \ref PathIndex "indexes" it provides.
+
+      \sa Require, PathResolve, PathValidate, CompilePath
    */
-   Node Select(Node node, PathArg path, PathBoundArgs args)
+   Node Select(Node node, PathArg path, PathBoundArgs args, PathContext const * context)
    {
-      PathException x;
-      auto err = PathResolve(node, path, args, &x);
+      // resolves without diagnostics: they are collected by resolving again only if an exception is thrown
+      Node result = node;
+      PathArg rpath = path;
+      auto err = PathResolve(result, rpath, args, nullptr, context);
       if (err == EPathError::OK)
-         return node;
+         return result;
 
-      if (x.IsNodeError())
+      if (PathException::IsNodeError(err))
          return UndefinedNode();
 
+      PathException x;
+      PathResolve(node, path, args, &x, context);
       throw x;
    }
 
    /** Like \ref Select, except that it throws a \c PathException if no node can be matched */
-   Node Require(Node node, PathArg path, PathBoundArgs args)
+   Node Require(Node node, PathArg path, PathBoundArgs args, PathContext const * context)
    {
+      Node result = node;
+      PathArg rpath = path;
+      auto err = PathResolve(result, rpath, args, nullptr, context);
+      if (err == EPathError::OK)
+         return result;
+
       PathException x;
-      auto err = PathResolve(node, path, args, &x);
+      PathResolve(node, path, args, &x, context);
+      throw x;
+   }
+
+   /** Like \ref Select, for a path compiled by \ref CompilePath. Applying a compiled path does not parse the path again. */
+   Node Select(Node node, CompiledPath const & path, PathContext const * context)
+   {
+      Node result = node;
+      auto err = PathResolve(result, path, nullptr, context);
+      if (err == EPathError::OK)
+         return result;
+
+      if (PathException::IsNodeError(err))
+         return UndefinedNode();
+
+      PathException x;
+      PathResolve(node, path, &x, context);
+      throw x;
+   }
+
+   /** Like \ref Require, for a path compiled by \ref CompilePath. */
+   Node Require(Node node, CompiledPath const & path, PathContext const * context)
+   {
+      Node result = node;
+      auto err = PathResolve(result, path, nullptr, context);
       if (err == EPathError::OK)
-         return node;
+         return result;
 
+      PathException x;
+      PathResolve(node, path, &x, context);
       throw x;
    }
 
+   /** Returns the first node selected by \c path, i.e. the first node \ref SelectEach would visit.
+      
+      Resolution stops at the first match: for a path that fans out over a sequence, only the elements 
+      up to the first match are inspected.\n
+      If no node can be matched, an <i>invalid node</i> is returned. If \c path is malformed, an \ref PathException exception is thrown.
+   */
+   Node SelectFirst(Node node, PathArg path, PathBoundArgs args, PathContext const * context)
+   {
+      Node result;
+      if (!SelectEach(node, path, [&](Node const & n) { result.reset(n); return false; }, args, context))
+         return UndefinedNode();
+      return result;
+   }
+
+   /** Like \ref SelectFirst, for a path compiled by \ref CompilePath. */
+   Node SelectFirst(Node node, CompiledPath const & path, PathContext const * context)
+   {
+      Node result;
+      if (!SelectEach(node, path, [&](Node const & n) { result.reset(n); return false; }, context))
+         return UndefinedNode();
+      return result;
+   }
+
+   /** Returns true if \c path selects a node, i.e. if <code>Select(node, path)</code> would return a valid node.
+      
+      Resolution stops at the first match, see \ref SelectFirst.
+   */
+   bool SelectExists(Node node, PathArg path, PathBoundArgs args, PathContext const * context)
+   {
+      return SelectEach(node, path, [](Node const &) { return false; }, args, context) != 0;
+   }
+
+   /** Like \ref SelectExists, for a path compiled by \ref CompilePath. */
+   bool SelectExists(Node node, CompiledPath const & path, PathContext const * context)
+   {
+      return SelectEach(node, path, [](Node const &) { return false; }, context) != 0;
+   }
+
+   /** Returns the number of nodes selected by \c path, without creating a result sequence. 
+
+      For a path that fans out over a sequence, this is the number of elements in the sequence \ref Select would return,
+      otherwise it is 1 if a node could be matched, and 0 if not.
+   */
+   size_t SelectCount(Node node, PathArg path, PathBoundArgs args, PathContext const * context)
+   {
+      return SelectEach(node, path, [](Node const &) {}, args, context);
+   }
+
+   /** Like \ref SelectCount, for a path compiled by \ref CompilePath. */
+   size_t SelectCount(Node node, CompiledPath const & path, PathContext const * context)
+   {
+      return SelectEach(node, path, [](Node const &) {}, context);
+   }
+
+   /** Parses \c path once, to apply it to many nodes with the \ref CompiledPath overloads of \ref Select, \ref Require and \ref PathResolve. 
+
+      The compiled path stores copies of \c path and \c args.\n
+      A malformed path does not throw, see \ref CompiledPath.
+   */
+   CompiledPath CompilePath(PathArg path, PathBoundArgs args)
+   {
+      return PathCompiler::CompileOwned(path, args);
+   }
+
+   PathArg CompiledPath::Path() const
+   {
+      return m_data ? m_data->path : PathArg();
+   }
+
+   EPathError CompiledPath::Error() const
+   {
+      return m_data ? m_data->error.Error() : EPathError::OK;
+   }
+
+   PathException const & CompiledPath::Diagnostics() const
+   {
+      static const PathException noError;
+      return m_data ? m_data->error : noError;
+   }
 
 
    namespace YamlPathDetail
    {
-      Node EnsureNodeApplyKeyToMapOrNothing(const Node & start, std::string key)
+      /// \internal returns the value for \c key, if \c start is a null node or a map. A missing key is added with a null value.
+      Node EnsureNodeApplyKeyToMapOrNothing(const Node & start, PathArg key, DocumentChanges & changes)
       {
-         Node n = start[key];
-         if (n)
+         if (Node n = FindKey(start, key))
             return n;
-         return Node(NodeType::Null);
+
+         // the key is missing: insert it without a second lookup, which would read every key of the map
+         changes.Modified(start);
+         Node map = start;
+         Node n(NodeType::Null);
+         map.force_insert(std::string(key), n);   // turns a null node into a map, n now shares the memory of map
+         return n;
       }
 
-      void EnsureNodeApplyKey(std::vector<Node> & result, const Node & start, std::string key, bool recurse)
+      void EnsureNodeApplyKey(ScratchVector<Node> & result, const Node & start, PathArg key, bool recurse, DocumentChanges & changes)
       {
          if (!start || start.IsNull() || start.IsMap())
-            result.push_back(EnsureNodeApplyKeyToMapOrNothing(start, key));
+            result.push_back(EnsureNodeApplyKeyToMapOrNothing(start, key, changes));
          else if (start.IsSequence() && recurse)
          {
             for (auto& el : start)
                if (el.IsNull() || el.IsMap())
-                  EnsureNodeApplyKey(result, el, key, false);
+                  EnsureNodeApplyKey(result, el, key, false, changes);
          }
       }
 
-      void EnsureNodeApplyKey(std::vector<Node> & result, std::vector<Node> & start, std::string key)
+      void EnsureNodeApplyKey(ScratchVector<Node> & result, ScratchVector<Node> & start, PathArg key, DocumentChanges & changes)
       {
          for (auto& el : start)
             if (el.IsNull() || el.IsMap())
-               EnsureNodeApplyKey(result, el, key, true);
+               EnsureNodeApplyKey(result, el, key, true, changes);
       }
-   }
 
-   Node Create(PathArg path, PathBoundArgs args)
-   {
-      Node root(YAML::NodeType::Null);
-      Ensure(root, path, args);
-      return root;
-   }
+      /// \internal true if \ref Ensure can create the nodes for a map filter token pair
+      bool EnsureSupports(ArgKVPair const & kvp)
+      {
+         return kvp.op != EKVOp::NotEqual &&
+            !kvp.key.starry && !kvp.key.noCase && !kvp.key.required &&
+            !kvp.value.starry && !kvp.value.noCase && !kvp.value.required &&
+            kvp.valueType == NodeType::Undefined;
+      }
 
-   Node Ensure(Node & node, PathArg path, PathBoundArgs args)
-   {
-      PathException x;
-      PathScanner scan(path, args, &x);
+      /** \internal gives a default-constructed \c node a null node of its own.
 
-      std::vector<Node> next;
-      next.push_back(node);
+          A default-constructed node is created on first use, separately for each copy of the handle: 
+          without this, the nodes ensured below a copy would not be visible through \c node.
+      */
+      void EnsureNodeExists(Node & node)
+      {
+         if (node && !node.is(node))
+            node = Node(NodeType::Null);
+      }
 
-      while (scan)
+      /// \internal appends null elements to \c el (a null node or a sequence) until it has at least \c size elements
+      void EnsureSequenceSize(Node & el, size_t size, DocumentChanges & changes)
       {
-         switch (scan.NextSelector())
-         {
-            case YamlPathDetail::ESelector::None:
-               break;
+         size_t i = el.IsSequence() ? el.size() : 0;
+         if (i < size)
+            changes.Modified(el);
+         for (; i < size; ++i)
+            el.push_back(Node());
+      }
+
+      /** \internal applies one selector to all nodes in \c next for \ref Ensure, creating the missing nodes.
 
-            case YamlPathDetail::ESelector::Key:
+          On success, \c next contains the nodes selected. It is empty if the selector is a map filter that only assigned values.
+      */
+      EPathError EnsureSelector(ScratchVector<Node> & next, ESelector selector, PathScanner::tSelectorData const & data, DocumentChanges & changes)
+      {
+         switch (selector)
+         {
+            case ESelector::Key:
             {
-               std::string key = std::string(scan.SelectorData<ArgKey>().key);
-               std::vector<Node> result;
-               EnsureNodeApplyKey(result, next, key);
+               ScratchVector<Node> result(Scratch());
+               EnsureNodeApplyKey(result, next, std::get<ArgKey>(data).key, changes);
 
                if (!result.size()) // nothing was added
-               {
-                  scan.SetError(EPathError::Internal);  // TODO: appropriate error msg
-                  throw x;
-               }
+                  return EPathError::Internal;  // TODO: appropriate error msg
                next.swap(result);
-               continue;
+               return EPathError::OK;
             }
 
-            case YamlPathDetail::ESelector::MapFilter:
+            case ESelector::MapFilter:
             {
                bool haveAssignment = false;
-               std::vector<Node> result;
-               for (auto && kvp : scan.SelectorData<ArgMapFilter>())
+               ScratchVector<Node> result(Scratch());
+               for (auto && kvp : std::get<ArgMapFilter>(data))
                {
-                  if (kvp.op == EKVOp::NotEqual ||
-                     kvp.key.starry || kvp.key.noCase || kvp.key.required ||
-                     kvp.value.starry || kvp.value.noCase || kvp.value.required)
-                  {
-                     scan.SetError(EPathError::SelectorNotSupported);
-                     throw x;
-                  }
+                  if (!EnsureSupports(kvp))
+                     return EPathError::SelectorNotSupported;
                   if (kvp.op == EKVOp::Select)
-                     EnsureNodeApplyKey(result, next, std::string(kvp.key.token));
+                     EnsureNodeApplyKey(result, next, kvp.key.token, changes);
                   else // has assignment
                   {
-                     std::vector<Node> assignTo;
-                     EnsureNodeApplyKey(assignTo, next, std::string(kvp.key.token));
+                     ScratchVector<Node> assignTo(Scratch());
+                     EnsureNodeApplyKey(assignTo, next, kvp.key.token, changes);
                      haveAssignment = !assignTo.empty();
                      for (size_t idx = 0; idx < assignTo.size(); ++idx)
+                     {
                         if (kvp.op != EKVOp::Exists && (!assignTo[idx] || assignTo[idx].IsNull()))
+                        {
+                           changes.Modified(assignTo[idx]);
                            assignTo[idx] = Node(std::string(kvp.value.token));
+                        }
+                     }
                   }
                }
-               if (result.empty())
+               if (result.empty() && !haveAssignment)
+                  return EPathError::InvalidNodeType;
+               next.swap(result);
+               return EPathError::OK;
+            }
+
+            case ESelector::Index:
+            {
+               ScratchVector<Node> result(Scratch());
+               size_t idx = std::get<ArgIndex>(data).index;
+               for (auto el : next)
                {
-                  if (haveAssignment)
-                     return Node();
-                  else
+                  if (!el || el.IsNull() || el.IsSequence())
                   {
-                     scan.SetError(EPathError::InvalidNodeType);
-                     throw x;
+                     EnsureSequenceSize(el, idx + 1, changes);
+                     result.push_back(el[idx]);
                   }
                }
-               else
-                  next.swap(result);
+               if (!result.size())
+                  return EPathError::Internal;   // TODO: appropriate error
+               next.swap(result);
+               return EPathError::OK;
             }
-            continue;
 
-            case YamlPathDetail::ESelector::Index:
+            case ESelector::Slice:
             {
-               std::vector<Node> result;
+               // the sequence grows to the end of the slice once, then all positions of the slice exist
+               ScratchVector<Node> result(Scratch());
+               auto && slice = std::get<ArgSlice>(data);
+               size_t count = (slice.Last() - slice.first) / slice.step + 1;
                for (auto el : next)
                {
                   if (!el || el.IsNull() || el.IsSequence())
                   {
-                     size_t seqSize = el.IsSequence() ? el.size() : 0;
-                     size_t idx = scan.SelectorData<ArgIndex>().index;
-                     if (idx >= seqSize)
-                        for (size_t i = 0; i < idx - seqSize + 1; ++i)
-                           el.push_back(Node());
-                     result.push_back(el[idx]);
+                     EnsureSequenceSize(el, slice.Last() + 1, changes);
+                     for (size_t k = 0; k < count; ++k)
+                        result.push_back(el[slice.Position(k)]);
                   }
                }
                if (!result.size())
-               {
-                  scan.SetError(EPathError::Internal);   // TODO: appropriate error
-                  throw x;
-               }
+                  return EPathError::InvalidNodeType;    // only maps and scalars
                next.swap(result);
+               return EPathError::OK;
             }
-            continue;
 
             default:
-               scan.SetError(EPathError::SelectorNotSupported);
-               throw x;
+               return EPathError::SelectorNotSupported;
          }
       }
+   }
+
+   namespace YamlPathDetail
+   {
+      /** \internal scans \c path again with diagnostics up to its selector number \c selectorCount, and records \c error for it.
+          This allows the first scan to skip recording diagnostics.
+      */
+      PathException RescanDiagnostics(PathArg path, PathBoundArgs args, size_t selectorCount, EPathError error)
+      {
+         PathException x;
+         PathScanner scan(path, args, &x);
+         for (size_t i = 0; i < selectorCount; ++i)
+            scan.NextSelector();
+         scan.SetError(error);
+         return x;
+      }
+   }
+
+   namespace YamlPathDetail
+   {
+      /** \internal ensures the nodes of \c path exist in \c node, and returns them in \c next. The nodes modified are recorded in \c changes.
+          Throws a \ref PathException for the first selector that cannot be ensured.
+          \returns \c false if the path ends with a map filter that only assigned values.
+      */
+      bool EnsureNodes(Node & node, PathArg path, PathBoundArgs args, ScratchVector<Node> & next, DocumentChanges & changes)
+      {
+         EnsureNodeExists(node);
+         PathScanner scan(path, args);
+
+         next.clear();
+         next.push_back(node);
+
+         size_t selectorCount = 0;
+         while (scan)
+         {
+            auto selector = scan.NextSelector();
+            ++selectorCount;
+            if (selector == ESelector::None)
+               continue;
+
+            EPathError err = EnsureSelector(next, selector, scan.SelectorDataV(), changes);
+            if (err != EPathError::OK)
+               throw RescanDiagnostics(path, args, selectorCount, err);
+            if (next.empty())
+               return false;
+         }
+         return true;
+      }
+   }
+
+   Node Create(PathArg path, PathBoundArgs args)
+   {
+      Node root(YAML::NodeType::Null);
+      YamlPathDetail::ScratchScope scratch(nullptr);
+      YamlPathDetail::ScratchVector<Node> next(YamlPathDetail::Scratch());
+      YamlPathDetail::DocumentChanges changes(false);    // a new document, no index or cache watches it
+      YamlPathDetail::EnsureNodes(root, path, args, next, changes);
+      return root;
+   }
+
+   Node Ensure(Node & node, PathArg path, PathBoundArgs args)
+   {
+      YamlPathDetail::ScratchScope scratch(nullptr);
+      YamlPathDetail::ScratchVector<Node> next(YamlPathDetail::Scratch());
+      YamlPathDetail::DocumentChanges changes;
+      if (!YamlPathDetail::EnsureNodes(node, path, args, next, changes))
+         return Node();    // a map filter only assigned values
 
       if (!next.size())
          return Node(NodeType::Null);
@@ -1070,4 +2490,44 @@ namespace YAML
       return final;
    }
 
+   namespace YamlPathDetail
+   {
+      /// \internal ensures the nodes of \c path exist in \c node, and calls \c assign for each of them, see \ref Assign
+      size_t AssignEach(Node & node, PathArg path, NodeVisitor const & assign, PathBoundArgs args)
+      {
+         ScratchScope scratch(nullptr);
+         ScratchVector<Node> next(Scratch());
+         DocumentChanges changes;
+         if (!EnsureNodes(node, path, args, next, changes))
+            return 0;
+
+         for (auto && target : next)
+         {
+            changes.Modified(target);
+            assign(target);
+         }
+         return next.size();
+      }
+   }
+
+   /** Ensures the nodes of \c path exist in \c node, like \ref Ensure, and assigns \c value to each of them.
+
+      Unlike assigning to the nodes returned by \c Ensure, no result sequence is created.
+      The first node receives \c value, the others a copy of it (see \c YAML::Clone): modifying one of them does not modify the others.\n
+      The overload for other types converts \c value to a new node for each node, and copies a \c Node lvalue.
+
+      \returns the number of nodes \c value was assigned to. 0 if the path ends with a map filter, which only assigned its own values.\n
+      Errors are handled as for \ref Ensure: a \ref PathException is thrown, and \c node may be partially modified.
+   */
+   size_t Assign(Node & node, PathArg path, Node && value, PathBoundArgs args)
+   {
+      size_t assigned = 0;
+      auto assign = [&](Node const & target)
+      {
+         Node n = target;
+         n = assigned++ ? Clone(value) : value;    // the node now shares the memory of the document
+      };
+      return YamlPathDetail::AssignEach(node, path, YamlPathDetail::NodeVisitor(assign), args);
+   }
+
 } // namespace YAML
@@ -24,15 +24,25 @@ SOFTWARE.
 
 #pragma once
 
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <memory_resource>
+#include <string>
 #include <string_view>
 #include <variant>
 #include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <yaml-cpp/node/node.h>
 
 namespace YAML
 {
    class Node;
    class PathException;
+   class CompiledPath;
+   class PathContext;
 
    /** \c PathArg is used by yaml-path as parameter and return value representing a slice of a \c std::string.\n
 
@@ -65,13 +75,52 @@ namespace YAML
    EPathError SelectByKey(Node & node, PathArg key);
    EPathError SelectByIndex(Node & node, size_t index);
 
-   Node Select(Node node, PathArg path, PathBoundArgs args = {}); ///< Select a node
-   Node Require(Node node, PathArg path, PathBoundArgs args = {});
+   Node Select(Node node, PathArg path, PathBoundArgs args = {}, PathContext const * context = nullptr); ///< Select a node
+   Node Require(Node node, PathArg path, PathBoundArgs args = {}, PathContext const * context = nullptr);
    Node Create(PathArg path, PathBoundArgs args = {});
    Node Ensure(Node & node, PathArg path, PathBoundArgs args = {}); ///< ensure one or more nodes exist. 
+   size_t Assign(Node & node, PathArg path, Node && value, PathBoundArgs args = {});   ///< ensure one or more nodes exist, and assign them \c value
+   template <typename T> size_t Assign(Node & node, PathArg path, T && value, PathBoundArgs args = {});
+   void EnsureMany(Node & node, std::pair<PathArg, Node> const * items, size_t count);   ///< ensure many paths exist and assign their values, building common prefixes once
+   void EnsureMany(Node & node, std::initializer_list<std::pair<PathArg, Node>> items);
    EPathError PathValidate(PathArg p, std::string * valid = 0, size_t * errorOffs = 0);
-   EPathError PathResolve(Node & node, PathArg & path, PathBoundArgs args = {}, PathException * px = 0);
+   EPathError PathResolve(Node & node, PathArg & path, PathBoundArgs args = {}, PathException * px = 0, PathContext const * context = nullptr);
 
+   CompiledPath CompilePath(PathArg path, PathBoundArgs args = {});  ///< parse a path once, to apply it to many nodes
+   Node Select(Node node, CompiledPath const & path, PathContext const * context = nullptr);
+   Node Require(Node node, CompiledPath const & path, PathContext const * context = nullptr);
+   EPathError PathResolve(Node & node, CompiledPath const & path, PathException * px = 0, PathContext const * context = nullptr);
+
+   template <typename TFunc> size_t SelectEach(Node node, PathArg path, TFunc && fn, PathBoundArgs args = {}, PathContext const * context = nullptr);  ///< visit the selected nodes without creating a result sequence
+   template <typename TFunc> size_t SelectEach(Node node, CompiledPath const & path, TFunc && fn, PathContext const * context = nullptr);
+   template <typename TContainer> size_t SelectInto(Node node, PathArg path, TContainer & result, PathBoundArgs args = {}, PathContext const * context = nullptr);  ///< append the selected nodes to a container
+   template <typename TContainer> size_t SelectInto(Node node, CompiledPath const & path, TContainer & result, PathContext const * context = nullptr);
+   Node SelectFirst(Node node, PathArg path, PathBoundArgs args = {}, PathContext const * context = nullptr);     ///< the first selected node, stops at the first match
+   Node SelectFirst(Node node, CompiledPath const & path, PathContext const * context = nullptr);
+   bool SelectExists(Node node, PathArg path, PathBoundArgs args = {}, PathContext const * context = nullptr);    ///< true if the path selects a node, stops at the first match
+   bool SelectExists(Node node, CompiledPath const & path, PathContext const * context = nullptr);
+   size_t SelectCount(Node node, PathArg path, PathBoundArgs args = {}, PathContext const * context = nullptr);   ///< the number of selected nodes
+   size_t SelectCount(Node node, CompiledPath const & path, PathContext const * context = nullptr);
+   std::vector<Node> SelectMany(Node node, PathArg const * paths, size_t count, PathContext const * context = nullptr);  ///< select many paths in one traversal, sharing common prefixes
+   std::vector<Node> SelectMany(Node node, std::initializer_list<PathArg> paths, PathContext const * context = nullptr);
+   template <typename TFunc> size_t SelectStream(std::istream & input, PathArg path, TFunc && fn, PathBoundArgs args = {}, PathContext const * context = nullptr);  ///< select from a YAML stream as it is parsed, without loading the document
+   template <typename TFunc> size_t SelectStream(std::istream & input, CompiledPath const & path, TFunc && fn, PathContext const * context = nullptr);
+   template <typename TFunc> size_t SelectAll(std::string_view yaml, CompiledPath const & path, TFunc && fn, PathContext const * context = nullptr);  ///< select from each document of a multi-document stream, in parallel
+   template <typename TFunc> size_t SelectAllFromFile(std::string const & fileName, CompiledPath const & path, TFunc && fn, PathContext const * context = nullptr);
+
+   /** statistics of the path cache used by the string-based API, see \ref PathCacheSetCapacity */
+   struct PathCacheStats
+   {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0;
+      size_t size = 0;        ///< number of paths currently cached
+      size_t capacity = 0;
+   };
+
+   void PathCacheSetCapacity(size_t capacity);  ///< set the maximum number of paths in the path cache. 0 disables the cache.
+   PathCacheStats PathCacheGetStats();
+   void PathCacheClear();                       ///< removes all paths from the path cache, and resets the statistics
 
   
    EPathError SelectByKey(Node & node, PathArg key);
@@ -87,6 +136,7 @@ namespace YAML
       InvalidIndex,
       UnexpectedEnd,
       SelectorNotSupported,
+      MissingArg,                ///< the path contains more "%" tokens than bound arguments were given
 
       // node navigation errors
       FirstNodeError_ = 100,     ///< all error codes after this indicate the selector was valid, but a matching node could not be found
@@ -95,7 +145,7 @@ namespace YAML
       /* to add a new error code, also add: a formatter to PathException::What */
    };
 
-   namespace YamlPathDetail { class PathScanner; }
+   namespace YamlPathDetail { class PathScanner; class PathCompiler; struct CompiledPathData; struct PathIndexData; struct DocumentIndexData; struct SelectCacheData; struct PathStatsData; class ScratchScope; enum class ESelector; }
 
    /** Exception and diagnostics for yaml-path */
    class PathException : public std::exception
@@ -121,6 +171,7 @@ namespace YAML
 
    private:
       friend class YamlPathDetail::PathScanner; // if scanner has a non-null diags member, it will feed it scan state information
+      friend class YamlPathDetail::PathCompiler; // feeds scan state recorded in a compiled path
 
       EPathError m_error = EPathError::OK;
       std::string m_fullPath;
@@ -138,4 +189,547 @@ namespace YAML
       mutable std::string m_detailed;
       mutable std::string m_errorItem;
    };
+
+   /** A path parsed by \ref CompilePath, which can be applied to many nodes without parsing it again.
+
+      \c CompiledPath is cheap to copy, copies share the (immutable) parse result.
+      It owns a copy of the path and of the bound arguments, so those do not need to outlive the call to \ref CompilePath.
+
+      A malformed path can be compiled. The valid selectors at the start of the path are still applied, 
+      and the path error is reported when resolution reaches it - i.e. \c Select(node, CompilePath(path)) behaves 
+      exactly like \c Select(node, path).
+   */
+   class CompiledPath
+   {
+   public:
+      CompiledPath() = default;     ///< an empty path, selecting the node it is applied to
+
+      PathArg Path() const;                        ///< the full path
+      EPathError Error() const;                    ///< the path error, \c EPathError::OK if the entire path is valid
+      PathException const & Diagnostics() const;  ///< diagnostics for the path error
+      explicit operator bool() const { return Error() == EPathError::OK; }  ///< true if the entire path is valid
+
+   private:
+      friend class YamlPathDetail::PathCompiler;
+      std::shared_ptr<YamlPathDetail::CompiledPathData const> m_data;
+   };
+
+   /** An index of the maps in a sequence, by the (scalar) value of one key.
+
+      A map filter <tt>{key=value}</tt> applied to a sequence inspects every element. If the sequence is indexed for \c key,
+      and the filter has only this condition, or it is the first condition and required (<tt>{!key=value,...}</tt>), 
+      \ref Select and the other functions taking a \ref PathContext look up the candidates in the index instead.
+      Elements that do not match the value are then rejected by the hash lookup, without comparing any of their keys.
+
+      Example:
+      \code
+      PathContext context;
+      context.AddIndex(Select(root, "users"), "id");
+      for (auto && id : ids)
+         Node user = Select(root, "users{id=%}", { PathArg(id) }, &context);     // hash lookup instead of a linear scan
+      \endcode
+
+      The index is built when it is created. It is rebuilt when it is used after \ref Ensure, \ref Assign or \ref EnsureMany 
+      modified the sequence, its elements or their values of \c key. Modifications of other nodes do not rebuild it.
+      Modifications made through yaml-cpp directly are not detected, call \ref Rebuild after them.\n
+      Copies of a \c PathIndex share the same index. It is safe to use an index from multiple threads, 
+      as long as the document is not modified at the same time.
+   */
+   class PathIndex
+   {
+   public:
+      PathIndex(Node sequence, PathArg key);
+
+      Node Sequence() const;                          ///< the indexed sequence
+      PathArg Key() const;                            ///< the indexed key
+      std::vector<size_t> Find(PathArg value) const;  ///< positions of the maps in which \c key has the scalar value \c value
+      void Rebuild();                                 ///< rebuilds the index, e.g. after the sequence was modified through yaml-cpp
+
+   private:
+      friend class PathContext;
+      friend struct YamlPathDetail::PathIndexData;
+      std::shared_ptr<YamlPathDetail::PathIndexData> m_data;
+   };
+
+   /** An index of all keys of a document, for the recursive key selector <tt>..key</tt>.
+
+      Without an index, <tt>..key</tt> walks all nodes below the node it is applied to. If the document is indexed,
+      \ref Select and the other functions taking a \ref PathContext take the values of \c key from the index instead,
+      for the root and for any map or sequence of the document. The result is the same, in the same order.
+
+      Example:
+      \code
+      PathContext context;
+      context.AddDocumentIndex(root);
+      Node timeouts = Select(root, "..timeout", {}, &context);             // hash lookup instead of a tree walk
+      Node dbTimeouts = Select(root, "services.db..timeout", {}, &context);
+      \endcode
+
+      Building the index walks the document once. With \c threads > 1, the children of the root are split 
+      into chunks that are walked in parallel (0 for \c std::thread::hardware_concurrency()). 
+      The index is rebuilt like a \ref PathIndex: when it is used after \ref Ensure modified a node of the document,
+      or by calling \ref Rebuild. Copies of a \c DocumentIndex share the same index.
+      Finding the node a recursive key is applied to in the index is a hash lookup, which does not read the document.
+   */
+   class DocumentIndex
+   {
+   public:
+      explicit DocumentIndex(Node root, size_t threads = 1);
+
+      Node Root() const;                              ///< the indexed document
+      std::vector<Node> Find(PathArg key) const;      ///< the values of \c key in all maps of the document, as selected by <tt>..key</tt>
+      void Rebuild();                                 ///< rebuilds the index, e.g. after the document was modified through yaml-cpp
+
+   private:
+      friend class PathContext;
+      friend struct YamlPathDetail::DocumentIndexData;
+      std::shared_ptr<YamlPathDetail::DocumentIndexData> m_data;
+   };
+
+   /** statistics of a \ref SelectCache */
+   struct SelectCacheStats
+   {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0;
+      uint64_t invalidations = 0;   ///< the number of times the results were discarded because the document was modified
+      size_t size = 0;              ///< number of results currently cached
+      size_t capacity = 0;
+      size_t memory = 0;            ///< approximate bytes used by the cache entries. Result sequences are counted at one node per element.
+
+      double HitRatio() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+   };
+
+   /** Memoizes the results of \ref Select on one document.
+
+      An application evaluating the same paths against the same document many times can select through a cache
+      bound to the document root. The results are kept by path and bound arguments, a string path and a \ref CompiledPath 
+      with the same path and arguments share an entry. When more than \c capacity results are cached, 
+      the least recently used are removed.
+
+      Example:
+      \code
+      SelectCache cache(root);
+      for (auto && rule : rules)
+         if (cache.Select("limits{name=%}.value", { PathArg(rule.limit) }))    // resolved once per limit name
+            ...
+      \endcode
+
+      The cached results are discarded when they are used after a node of the document was modified by \ref Ensure, 
+      \ref Assign or \ref EnsureMany (like a \ref PathIndex, changes of other documents are not affected). 
+      Modifications made through yaml-cpp directly are not detected, call \ref Invalidate after them.\n
+      A result that is not found (an undefined node) is cached, too. A malformed path throws on each call, and is not cached.\n
+      As with \c Select, each call returns a new result sequence for a fan-out selector, whose elements are the nodes of the document: 
+      modifying the result sequence does not modify the cached result.\n
+      Copies of a \c SelectCache share the same cache. It is safe to use a cache from multiple threads, 
+      as long as the document is not modified at the same time.
+   */
+   class SelectCache
+   {
+   public:
+      static const size_t DefaultCapacity = 1024;
+
+      explicit SelectCache(Node root, size_t capacity = DefaultCapacity);
+
+      Node Root() const;           ///< the document the results are selected from
+      Node Select(PathArg path, PathBoundArgs args = {}, PathContext const * context = nullptr);   ///< like <tt>YAML::Select(Root(), path, args, context)</tt>
+      Node Select(CompiledPath const & path, PathContext const * context = nullptr);
+      void Invalidate();           ///< discards all results, e.g. after the document was modified through yaml-cpp
+      void SetCapacity(size_t capacity);   ///< the maximum number of results, 0 disables the cache
+      SelectCacheStats Stats() const;
+
+   private:
+      std::shared_ptr<YamlPathDetail::SelectCacheData> m_data;
+   };
+
+   /** Options for resolving paths, set on a \ref PathContext.
+
+       Key and map filter selectors applied to a sequence of at least \c parallelThreshold elements 
+       split the sequence into chunks that are filtered on up to \c threads threads. 
+       The results are merged in the order of the sequence, so the result is the same as when filtering serially.
+       See \ref PathContext for the thread safety requirements.
+   */
+   struct SelectOptions
+   {
+      size_t threads = 1;                 ///< maximum number of threads filtering a sequence, 0 for \c std::thread::hardware_concurrency()
+      size_t parallelThreshold = 10000;   ///< sequences with fewer elements are filtered on the calling thread
+   };
+
+   /** Scratch memory for resolving paths, reused across calls.
+
+       Resolving a path needs short-lived buffers, e.g. for the nodes selected from a sequence before the next selector 
+       is applied, or the selector data of a template with bound arguments. A \c PathArena supplies them from blocks 
+       that are kept between calls (a bump allocator), so a warmed-up call does not allocate them from the heap.
+       Memory used by a call is reused when the call returns, also for calls nested in a \ref SelectEach callback.
+       Buffers larger than \c LargeAllocation are allocated from the heap.
+
+       Each thread uses an arena of its own by default, which keeps at most 256 KiB between calls. An arena set with 
+       \ref PathContext::SetArena is used instead, e.g. to reserve memory in advance; it keeps its blocks until \ref Trim is called. 
+       An arena must not be used by two threads at the same time.
+
+       yaml-cpp allocates the nodes it creates (e.g. the result sequence of \ref Select) from the heap.
+   */
+   class PathArena : public std::pmr::memory_resource
+   {
+   public:
+      static constexpr size_t LargeAllocation = 256 * 1024;
+
+      explicit PathArena(size_t reserve = 0);
+      ~PathArena() override;
+      PathArena(PathArena const &) = delete;
+      PathArena & operator=(PathArena const &) = delete;
+
+      size_t Capacity() const;         ///< bytes in the blocks kept for reuse
+      size_t Used() const;             ///< bytes used by running calls
+      void Trim();                     ///< releases the blocks not used by running calls
+
+   private:
+      friend class YamlPathDetail::ScratchScope;
+      struct Block
+      {
+         std::unique_ptr<std::byte[]> data;
+         size_t size = 0;
+      };
+      struct Mark
+      {
+         size_t block = 0;
+         size_t offset = 0;
+      };
+
+      std::vector<Block> m_blocks;
+      Mark m_top;                      ///< the next free byte
+
+      void AddBlock(size_t minSize);
+      void TrimTo(size_t capacity);
+      void * do_allocate(size_t bytes, size_t alignment) override;
+      void do_deallocate(void * p, size_t bytes, size_t alignment) override;
+      bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override { return this == &other; }
+   };
+
+   /** a selector applied while resolving a path, see \ref PathTracer::OnSelector */
+   struct PathSelectorTrace
+   {
+      YamlPathDetail::ESelector selector{};  ///< the type of the selector, see \ref PathSelectorName
+      size_t position = 0;             ///< the index of the selector in the path
+      size_t input = 0;                ///< the number of nodes the selector was applied to. A sequence it fans out over counts as one node.
+      size_t output = 0;               ///< the number of nodes selected, 0 if the selector did not match
+      uint64_t keysScanned = 0;        ///< map keys read by a map filter: one for each key lookup, and each key compared by a starry or case insensitive condition
+      uint64_t nanoseconds = 0;
+   };
+
+   /** a path resolved, see \ref PathTracer::OnPath */
+   struct PathTrace
+   {
+      PathArg path;                    ///< the path as written, bound arguments are not substituted
+      EPathError error{};
+      size_t selectors = 0;            ///< the number of selectors reported to \ref PathTracer::OnSelector before
+      size_t output = 0;               ///< the number of nodes selected
+      uint64_t keysScanned = 0;        ///< the sum of the \ref PathSelectorTrace::keysScanned of the selectors
+      uint64_t nanoseconds = 0;
+   };
+
+   /** Receives profiling events of the paths resolved with a \ref PathContext, see \ref PathContext::SetTracer.
+
+      \ref Select, \ref Require and \ref PathResolve report each selector applied, then the path.
+      \ref SelectEach (and the functions built on it) apply all selectors of a path node by node, and report the path only.
+      The events are reported on the calling thread, also when \ref SelectOptions allow filtering in parallel;
+      a tracer used by a context shared between threads must be thread safe.\n
+      A call that throws, or \ref Select for a malformed path, reports the path twice: it is resolved again to collect the diagnostics.\n
+      Without a tracer, resolving a path only tests the context for it.
+   */
+   class PathTracer
+   {
+   public:
+      virtual ~PathTracer() = default;
+      virtual void OnSelector(PathArg path, PathSelectorTrace const & trace) { (void)path; (void)trace; }
+      virtual void OnPath(PathTrace const & trace) { (void)trace; }
+   };
+
+   char const * PathSelectorName(YamlPathDetail::ESelector selector);   ///< e.g. "key" or "map filter"
+
+   /** statistics of one path, see \ref PathStats */
+   struct PathStatsEntry
+   {
+      /// the totals of the selector at one position of the path
+      struct Selector
+      {
+         YamlPathDetail::ESelector selector{};
+         uint64_t input = 0;
+         uint64_t output = 0;
+         uint64_t keysScanned = 0;
+         uint64_t nanoseconds = 0;
+      };
+
+      std::string path;
+      uint64_t calls = 0;
+      uint64_t errors = 0;             ///< calls that did not select a node, or failed
+      uint64_t output = 0;             ///< total number of nodes selected
+      uint64_t keysScanned = 0;
+      uint64_t nanoseconds = 0;        ///< total time of all calls
+      uint64_t maxNanoseconds = 0;     ///< the slowest call
+      std::vector<Selector> selectors; ///< by position, if reported
+
+      double MeanNanoseconds() const { return calls ? double(nanoseconds) / double(calls) : 0.0; }
+   };
+
+   /** A \ref PathTracer collecting statistics by path, to find the paths an application spends its time in.
+
+      Example:
+      \code
+      PathStats stats;
+      context.SetTracer(&stats);
+      ...                                 // Select(root, path, args, &context) etc.
+      stats.Dump(std::cerr, 10);          // the 10 paths with the most total time, and their selectors
+      \endcode
+
+      Paths compiled with bound arguments are collected by their text, e.g. all calls of <tt>"users{id=%}"</tt> share one entry. 
+      A \c PathStats can be used by multiple threads.
+   */
+   class PathStats : public PathTracer
+   {
+   public:
+      PathStats();
+      ~PathStats() override;
+      PathStats(PathStats const &) = delete;
+      PathStats & operator=(PathStats const &) = delete;
+
+      void OnSelector(PathArg path, PathSelectorTrace const & trace) override;
+      void OnPath(PathTrace const & trace) override;
+
+      std::vector<PathStatsEntry> Slowest(size_t count) const;    ///< the \c count paths with the largest total time, slowest first
+      void Dump(std::ostream & out, size_t count = 10) const;     ///< writes a table of <tt>Slowest(count)</tt>
+      void Clear();
+
+   private:
+      std::unique_ptr<YamlPathDetail::PathStatsData> m_data;
+   };
+
+   /** Additional data used to resolve paths: the \ref PathIndex "indexes" available to map filters, the \ref DocumentIndex "key indexes" of documents, \ref SelectOptions, the \ref PathArena for scratch memory, and a \ref PathTracer. 
+       Passed to \ref Select (and others) as optional last argument.
+
+       \par Thread Safety
+
+       yaml-cpp nodes are not thread safe: besides modifying a document, some reading operations modify 
+       the memory holders shared by all nodes of a document (e.g. creating a sequence that refers to document nodes). 
+       When \ref SelectOptions::threads allows parallel filtering, the worker threads only read the document 
+       (node types, iteration, scalars); building the result, and key selection in map filters, happen on the calling thread.
+       See the "Thread Safety" section of the main page for sharing a document between threads.\n
+       \ref SelectEach and the functions built on it visit nodes in order on the calling thread, and ignore \c threads.\n
+       A context with a \ref PathArena can be used by only one thread at a time.
+   */
+   class PathContext
+   {
+   public:
+      PathIndex AddIndex(Node sequence, PathArg key);          ///< creates an index for \c sequence, or returns the existing one
+      void AddIndex(PathIndex const & index);
+      PathIndex const * FindIndex(Node const & sequence, PathArg key) const;   ///< returns the index for \c sequence and \c key, \c nullptr if there is none
+      DocumentIndex AddDocumentIndex(Node root, size_t threads = 1);     ///< creates a key index for the document \c root, or returns the existing one
+      void AddIndex(DocumentIndex const & index);
+      DocumentIndex const * FindDocumentIndex(Node const & root) const;  ///< returns the key index for \c root, \c nullptr if there is none
+      std::vector<DocumentIndex> const & DocumentIndexes() const { return m_documentIndexes; }
+      void Clear() { m_indexes.clear(); m_documentIndexes.clear(); }
+
+      void SetOptions(SelectOptions const & options) { m_options = options; }
+      SelectOptions const & Options() const { return m_options; }
+
+      void SetArena(PathArena * arena) { m_arena = arena; }      ///< scratch memory for calls using this context, \c nullptr for the default arena of the calling thread. Not owned.
+      PathArena * Arena() const { return m_arena; }
+
+      void SetTracer(PathTracer * tracer) { m_tracer = tracer; } ///< receives profiling events of the calls using this context, \c nullptr for none. Not owned.
+      PathTracer * Tracer() const { return m_tracer; }
+
+   private:
+      std::vector<PathIndex> m_indexes;
+      std::vector<DocumentIndex> m_documentIndexes;
+      SelectOptions m_options;
+      PathArena * m_arena = nullptr;
+      PathTracer * m_tracer = nullptr;
+   };
+
+   namespace YamlPathDetail
+   {
+      /** \internal non-owning reference to the callable passed to \ref SelectEach. 
+          A callable returning \c void visits all nodes, one returning \c bool stops when it returns \c false.
+      */
+      class NodeVisitor
+      {
+      public:
+         template <typename TFunc>
+         explicit NodeVisitor(TFunc & fn) : m_context(const_cast<void *>(static_cast<void const *>(&fn))), m_visit(&Visit<TFunc>) {}
+
+         bool operator()(Node const & node) const { return m_visit(m_context, node); }
+
+      private:
+         void * m_context;
+         bool (*m_visit)(void *, Node const &);
+
+         template <typename TFunc>
+         static bool Visit(void * context, Node const & node)
+         {
+            auto & fn = *static_cast<TFunc *>(context);
+            if constexpr (std::is_void_v<decltype(fn(node))>)
+            {
+               fn(node);
+               return true;
+            }
+            else
+               return static_cast<bool>(fn(node));
+         }
+      };
+
+      /// \internal the number of chunks a fan-out over \c count elements is split into, according to the \ref SelectOptions of \c context. 1 to run serially.
+      size_t FanOutChunks(size_t count, PathContext const * context);
+
+      /** \internal runs <tt>fn(chunk, begin, end)</tt> for \c chunks slices of <tt>[0, count)</tt>.
+
+          The first chunk runs on the calling thread, the others on one thread each. \c fn must only read the document, 
+          see \ref PathContext. An exception thrown by \c fn is rethrown after all threads finished.
+      */
+      void ParallelChunks(size_t count, size_t chunks, std::function<void(size_t chunk, size_t begin, size_t end)> const & fn);
+
+      size_t VisitPath(Node node, PathArg path, NodeVisitor const & visitor, PathBoundArgs args, PathContext const * context);
+      size_t AssignEach(Node & node, PathArg path, NodeVisitor const & assign, PathBoundArgs args);
+      size_t VisitPath(Node node, CompiledPath const & path, NodeVisitor const & visitor, PathContext const * context);
+      size_t VisitStream(std::istream & input, CompiledPath const & path, NodeVisitor const & visitor, PathContext const * context);
+      size_t VisitAll(std::string_view yaml, CompiledPath const & path, NodeVisitor const & visitor, size_t & document, PathContext const * context);
+      size_t VisitAllFromFile(std::string const & fileName, CompiledPath const & path, NodeVisitor const & visitor, size_t & document, PathContext const * context);
+
+      /// \internal adapts a callback <tt>fn(Node const &, size_t document)</tt> of \ref SelectAll to a \ref NodeVisitor
+      template <typename TFunc>
+      auto DocumentCallback(TFunc & fn, size_t const & document)
+      {
+         return [&fn, &document](Node const & node)
+         {
+            if constexpr (std::is_void_v<decltype(fn(node, document))>)
+            {
+               fn(node, document);
+               return true;
+            }
+            else
+               return static_cast<bool>(fn(node, document));
+         };
+      }
+   }
+
+   /** Calls \c fn for each node selected by \c path, as the nodes are found, without creating a result sequence.
+
+      If the path fans out over a sequence (e.g. a key or a map filter applied to a sequence), \c fn is called 
+      for each element of the sequence \ref Select would return. Otherwise, it is called once for the selected node.\n
+      \c fn receives a <code>Node const &</code>. If it returns \c bool, returning \c false stops the selection.
+
+      The path is resolved depth-first: each match of a fan-out selector runs through the rest of the path, and is passed
+      to \c fn before the next element is inspected. So e.g. <code>SelectEach(root, "items.price", ...)</code>
+      requires constant extra memory. yaml-cpp merges the memory of the entire source document into each new result node,
+      which \ref Select has to do for a fan-out selector, and \c SelectEach avoids.
+
+      \returns the number of calls to \c fn. If no node can be matched, \c fn is not called, and 0 is returned.\n
+      Error handling is the same as for \ref Select: if \c path is malformed, a \ref PathException is thrown, before \c fn is called.
+
+      \sa SelectInto, SelectFirst, SelectExists, SelectCount, SelectAccumulate
+   */
+   template <typename TFunc> 
+   size_t SelectEach(Node node, PathArg path, TFunc && fn, PathBoundArgs args, PathContext const * context)
+   {
+      return YamlPathDetail::VisitPath(node, path, YamlPathDetail::NodeVisitor(fn), args, context);
+   }
+
+   /** Like \ref SelectEach, for a path compiled by \ref CompilePath. */
+   template <typename TFunc> 
+   size_t SelectEach(Node node, CompiledPath const & path, TFunc && fn, PathContext const * context)
+   {
+      return YamlPathDetail::VisitPath(node, path, YamlPathDetail::NodeVisitor(fn), context);
+   }
+
+   /** Calls \c fn for each node selected by \c path from the first document in \c input, while the document is parsed.
+
+      The result is the same as for <code>SelectEach(Load(input), path, fn)</code>, but the document is never loaded completely:
+      the selectors run on the events of yaml-cpp's \c Parser, and only the nodes passed to \c fn are built. 
+      Parts of the document that cannot be selected are skipped as they are read, and parsing stops as soon as nothing 
+      else can be selected (e.g. after the value of <tt>config.port</tt> was read), or \c fn returns \c false.
+
+      A map filter applied to a map, or to the elements of a sequence, needs the complete map: 
+      the element is built and tested, and dropped if it does not match. So a filter holds one sequence element at a time.\n
+      Anchored nodes are built and kept until parsing ends, to resolve aliases. Nodes built from events have no \c Mark.\n
+      \ref PathIndex "Indexes" of \c context are not used.
+
+      \returns the number of calls to \c fn\n
+      A malformed \c path throws a \ref PathException before \c input is read, a malformed document throws \c YAML::ParserException.
+   */
+   template <typename TFunc> 
+   size_t SelectStream(std::istream & input, CompiledPath const & path, TFunc && fn, PathContext const * context)
+   {
+      return YamlPathDetail::VisitStream(input, path, YamlPathDetail::NodeVisitor(fn), context);
+   }
+
+   /** Like \ref SelectStream, for a path string */
+   template <typename TFunc> 
+   size_t SelectStream(std::istream & input, PathArg path, TFunc && fn, PathBoundArgs args, PathContext const * context)
+   {
+      return YamlPathDetail::VisitStream(input, CompilePath(path, args), YamlPathDetail::NodeVisitor(fn), context);
+   }
+
+   /** Calls <tt>fn(Node const & node, size_t document)</tt> for each node selected by \c path from each document in \c yaml, 
+       a multi-document stream. \c document is the index of the document, counted like \c YAML::LoadAll does.
+
+      The stream is split into documents at the lines starting with <tt>---</tt> or <tt>...</tt> (the text must be UTF-8), 
+      and each document is resolved like \ref SelectStream does, without loading it completely.
+      If the \ref SelectOptions of \c context allow more than one thread, the documents are parsed on up to 
+      \c threads worker threads, while \c fn is called on the calling thread, in document order. 
+      A window of twice as many documents as threads is in progress at any time, so the memory needed depends on the number of threads, 
+      not on the size of \c yaml.\n
+      If \c fn returns \c false, no other node is visited.
+
+      \returns the number of calls to \c fn\n
+      A malformed \c path throws a \ref PathException before \c yaml is read. A malformed document throws \c YAML::ParserException, 
+      after the nodes selected from the documents before it were visited.
+   */
+   template <typename TFunc> 
+   size_t SelectAll(std::string_view yaml, CompiledPath const & path, TFunc && fn, PathContext const * context)
+   {
+      size_t document = 0;
+      auto visit = YamlPathDetail::DocumentCallback(fn, document);
+      return YamlPathDetail::VisitAll(yaml, path, YamlPathDetail::NodeVisitor(visit), document, context);
+   }
+
+   /** Like \ref SelectAll, for the contents of a file, which is mapped into memory. 
+       Throws \c std::system_error if the file cannot be read.
+   */
+   template <typename TFunc> 
+   size_t SelectAllFromFile(std::string const & fileName, CompiledPath const & path, TFunc && fn, PathContext const * context)
+   {
+      size_t document = 0;
+      auto visit = YamlPathDetail::DocumentCallback(fn, document);
+      return YamlPathDetail::VisitAllFromFile(fileName, path, YamlPathDetail::NodeVisitor(visit), document, context);
+   }
+
+   /** Appends the nodes selected by \c path to \c result (using \c result.push_back), see \ref SelectEach. 
+       \returns the number of nodes appended
+   */
+   template <typename TContainer> 
+   size_t SelectInto(Node node, PathArg path, TContainer & result, PathBoundArgs args, PathContext const * context)
+   {
+      return SelectEach(node, path, [&](Node const & n) { result.push_back(n); }, args, context);
+   }
+
+   /** Like \ref SelectInto, for a path compiled by \ref CompilePath. */
+   template <typename TContainer> 
+   size_t SelectInto(Node node, CompiledPath const & path, TContainer & result, PathContext const * context)
+   {
+      return SelectEach(node, path, [&](Node const & n) { result.push_back(n); }, context);
+   }
+
+   /** Like \ref Assign, for a value of any type yaml-cpp converts to a node. The value is converted for each node, 
+       a \c Node is copied (see \c YAML::Clone), so the nodes never share the value.
+   */
+   template <typename T> 
+   size_t Assign(Node & node, PathArg path, T && value, PathBoundArgs args)
+   {
+      if constexpr (std::is_same_v<std::decay_t<T>, Node>)
+         return Assign(node, path, Clone(value), args);
+      else
+      {
+         auto assign = [&](Node const & target) { Node n = target; n = Node(value); };
+         return YamlPathDetail::AssignEach(node, path, YamlPathDetail::NodeVisitor(assign), args);
+      }
+   }
 }